@@ -0,0 +1,28 @@
+#ifndef BENCH_TIMER_HPP
+#define BENCH_TIMER_HPP
+#include <time.h>      // clock_gettime (POSIX)
+#include <stdint.h>    // uint32_t, uint64_t
+
+// clock() は CPU 時間で粒度も粗いので、ベンチは単調増加クロックで測る
+inline double nowSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+// <random> は C++11 からなので、再現性のある xorshift を使う
+class XorShift {
+public:
+    explicit XorShift(uint64_t seed = 88172645463325252ULL) : s_(seed ? seed : 1) {}
+    uint64_t next() {
+        s_ ^= s_ << 13;
+        s_ ^= s_ >> 7;
+        s_ ^= s_ << 17;
+        return s_;
+    }
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+private:
+    uint64_t s_;
+};
+
+#endif // BENCH_TIMER_HPP
@@ -0,0 +1,87 @@
+// data.csv ローダ比較ベンチ (stream vs mmap vs binary snapshot)
+// usage: ./loader_bench [rows=10000000] [path=/tmp/rate_bench.csv]
+// 1 回ごとに fork して、子プロセスの起動時間と peak RSS (ru_maxrss) を測る
+#include "RateTable.hpp"
+#include "Utils.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 1 日 3 行 (重複は後勝ち) にして 10M 行でも 0000..9999 年に収める
+static void writeCsv(const char* path, long rows) {
+    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) { std::perror(path); std::exit(1); }
+    std::fputs("date,exchange_rate\n", f);
+    XorShift rng(42);
+    int y = 0, m = 1, d = 1;
+    for (long i = 0; i < rows; ++i) {
+        std::fprintf(f, "%04d-%02d-%02d,%.2f\n", y, m, d,
+                     static_cast<double>(rng.below(6000000)) / 100.0);
+        if (i % 3 == 2) {
+            int maxd = (m == 2 && isLeapYear(y)) ? 29 : mdays[m - 1];
+            if (++d > maxd) { d = 1; if (++m > 12) { m = 1; ++y; } }
+        }
+    }
+    std::fclose(f);
+}
+
+enum Loader { STREAM, MMAP, SNAPSHOT };
+
+static void runChild(const char* path, Loader loader, RateTable::Backend backend) {
+    double t0 = nowSeconds();
+    RateTable table(backend);
+    if (loader == SNAPSHOT) {
+        table.loadSnapshot(std::string(path) + ".snap");
+    } else if (loader == MMAP) {
+        table.loadFile(path);
+    } else {
+        std::ifstream in(path);
+        table.load(in);
+    }
+    double t1 = nowSeconds();
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    static const char* names[] = {"map", "flat", "dense"};
+    static const char* loaders[] = {"stream", "mmap", "snapshot"};
+    std::printf("%-8s %-5s rows=%zu load=%.3fs peak_rss=%.1fMiB\n",
+                loaders[loader], names[backend], table.size(),
+                t1 - t0, static_cast<double>(ru.ru_maxrss) / 1024.0);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    long rows = argc > 1 ? std::atol(argv[1]) : 10000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/rate_bench.csv";
+    writeCsv(path, rows);
+    // snapshot も子プロセスで作り、親の RSS を増やさない
+    pid_t writer = fork();
+    if (writer == 0) {
+        RateTable table(RateTable::FLAT);
+        table.loadFile(path);
+        table.saveSnapshot(std::string(path) + ".snap", path);
+        std::_Exit(0);
+    }
+    waitpid(writer, 0, 0);
+
+    const RateTable::Backend backends[] = {RateTable::MAP, RateTable::FLAT, RateTable::DENSE};
+    for (int b = 0; b < 3; ++b) {
+        for (int loader = STREAM; loader <= SNAPSHOT; ++loader) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                runChild(path, static_cast<Loader>(loader), backends[b]);
+                std::_Exit(0);
+            }
+            int status;
+            waitpid(pid, &status, 0);
+        }
+    }
+    std::remove(path);
+    std::remove((std::string(path) + ".snap").c_str());
+    return 0;
+}
@@ -0,0 +1,144 @@
+// btc --serve 用の負荷生成: QPS と要求ごとのレイテンシ (p50/p99)
+// usage: ./loadgen_bench [socket|-] [connections=4] [requests_per_conn=200000] [depth=32]
+//   socket を省略するか "-" なら、同じプロセス内でサーバを立ち上げて測る
+#include "QueryServer.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static std::string makeDb() {
+    std::string csv = "date,exchange_rate\n";
+    char buf[64];
+    for (int y = 2009; y <= 2022; ++y)
+        for (int m = 1; m <= 12; ++m)
+            for (int d = 1; d <= 28; ++d) {
+                std::sprintf(buf, "%04d-%02d-%02d,%d.%02d\n", y, m, d, y - 2000, d);
+                csv += buf;
+            }
+    return csv;
+}
+
+struct ClientArgs {
+    std::string path;
+    long requests;
+    int depth;
+    uint64_t seed;
+    std::vector<double> latency; // ns
+    bool ok;
+};
+
+// depth 個の要求を 1 回の write で送り、その応答が揃ってから次を送る
+static void* client(void* arg) {
+    ClientArgs* a = static_cast<ClientArgs*>(arg);
+    a->ok = false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, a->path.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return 0;
+    }
+    XorShift rng(a->seed);
+    a->latency.reserve(static_cast<std::size_t>(a->requests));
+    std::string batch;
+    char line[64];
+    char buf[65536];
+    for (long sent = 0; sent < a->requests; ) {
+        const int n = static_cast<int>(std::min<long>(a->depth, a->requests - sent));
+        batch.clear();
+        for (int i = 0; i < n; ++i) {
+            if (rng.below(10) == 0) { // 1 割は不正な行
+                batch += "2001-42-42\n";
+                continue;
+            }
+            std::sprintf(line, "%04u-%02u-%02u | %u.%u\n", 2009 + rng.below(14),
+                         1 + rng.below(12), 1 + rng.below(28), rng.below(1000), rng.below(100));
+            batch += line;
+        }
+        const double t0 = nowSeconds();
+        if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size()))
+            break;
+        int answered = 0;
+        while (answered < n) {
+            const ssize_t got = ::read(fd, buf, sizeof(buf));
+            if (got <= 0) { ::close(fd); return 0; }
+            const double t = (nowSeconds() - t0) * 1e9;
+            for (ssize_t k = 0; k < got; ++k) {
+                if (buf[k] == '\n') {
+                    a->latency.push_back(t);
+                    ++answered;
+                }
+            }
+        }
+        sent += n;
+    }
+    ::close(fd);
+    a->ok = true;
+    return 0;
+}
+
+static void* serverThread(void* arg) {
+    static_cast<QueryServer*>(arg)->run();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : "-";
+    const int conns = argc > 2 ? std::atoi(argv[2]) : 4;
+    const long requests = argc > 3 ? std::atol(argv[3]) : 200000;
+    const int depth = argc > 4 ? std::atoi(argv[4]) : 32;
+
+    QueryServer* server = 0;
+    BitcoinExchange* app = 0;
+    pthread_t stid;
+    if (path == "-") {
+        std::istringstream db(makeDb());
+        app = new BitcoinExchange(db, RateTable::FLAT);
+        server = new QueryServer(*app);
+        path = "loadgen_bench.sock";
+        server->listenUnix(path);
+        pthread_create(&stid, 0, serverThread, server);
+    }
+
+    std::vector<ClientArgs> args(conns);
+    std::vector<pthread_t> tids(conns);
+    const double t0 = nowSeconds();
+    for (int i = 0; i < conns; ++i) {
+        args[i].path = path;
+        args[i].requests = requests;
+        args[i].depth = depth;
+        args[i].seed = 100 + i;
+        pthread_create(&tids[i], 0, client, &args[i]);
+    }
+    std::vector<double> all;
+    for (int i = 0; i < conns; ++i) {
+        pthread_join(tids[i], 0);
+        if (!args[i].ok) std::fprintf(stderr, "connection %d failed\n", i);
+        all.insert(all.end(), args[i].latency.begin(), args[i].latency.end());
+    }
+    const double wall = nowSeconds() - t0;
+    if (server) {
+        server->stop();
+        pthread_join(stid, 0);
+        delete server;
+        delete app;
+    }
+    if (all.empty()) return 1;
+    std::sort(all.begin(), all.end());
+    const std::size_t n = all.size();
+    std::printf("conns=%d depth=%d requests=%zu %.0f QPS p50=%.1fus p99=%.1fus p99.9=%.1fus\n",
+                conns, depth, n, static_cast<double>(n) / wall, all[n / 2] / 1e3,
+                all[n * 99 / 100] / 1e3, all[n * 999 / 1000] / 1e3);
+    return 0;
+}
@@ -0,0 +1,65 @@
+// runParallel のスレッド数ごとのスケーリング (1, 2, 4, 8, 16 threads)
+// usage: ./parallel_bench [lines=20000000] [path=parallel_bench_input.txt]
+#include "BitcoinExchange.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static std::string makeDb() {
+    std::string csv = "date,exchange_rate\n";
+    char buf[64];
+    for (int y = 2009; y <= 2022; ++y)
+        for (int m = 1; m <= 12; ++m)
+            for (int d = 1; d <= 28; ++d) {
+                std::sprintf(buf, "%04d-%02d-%02d,%d.%02d\n", y, m, d, y - 2000, d);
+                csv += buf;
+            }
+    return csv;
+}
+
+// 10% は不正な行にして stderr への出力も混ぜる
+static void writeInput(const char* path, long lines) {
+    static const char* bad[] = {
+        "2011-01-03 | -1\n", "2011-01-03 | 1001\n", "2001-42-42\n",
+        "2011-02-30 | 1\n", "2011-01-03 | abc\n"
+    };
+    std::ofstream f(path, std::ios::binary);
+    f << "date | value\n";
+    XorShift rng(1);
+    char buf[64];
+    for (long i = 0; i < lines; ++i) {
+        if (rng.below(100) < 10) {
+            f << bad[rng.below(5)];
+            continue;
+        }
+        std::sprintf(buf, "%04d-%02d-%02d | %u.%u\n", 2009 + static_cast<int>(rng.below(14)),
+                     1 + static_cast<int>(rng.below(12)), 1 + static_cast<int>(rng.below(28)),
+                     rng.below(1000), rng.below(100));
+        f << buf;
+    }
+}
+
+int main(int argc, char** argv) {
+    long lines = argc > 1 ? std::atol(argv[1]) : 20000000;
+    const char* path = argc > 2 ? argv[2] : "parallel_bench_input.txt";
+    writeInput(path, lines);
+    std::istringstream dbIn(makeDb());
+    BitcoinExchange app(dbIn, RateTable::FLAT);
+    std::ofstream devnull("/dev/null");
+
+    double base = 0.0;
+    const unsigned threads[] = {1, 2, 4, 8, 16};
+    for (std::size_t i = 0; i < 5; ++i) {
+        double t0 = nowSeconds();
+        app.runParallel(path, devnull, devnull, threads[i]);
+        double t = nowSeconds() - t0;
+        if (i == 0) base = t;
+        std::printf("threads=%-2u %.3fs %.2f M lines/s speedup %.2fx\n", threads[i], t,
+                    static_cast<double>(lines) / t / 1e6, base / t);
+    }
+    std::remove(path);
+    return 0;
+}
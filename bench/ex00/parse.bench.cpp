@@ -0,0 +1,88 @@
+// 日付・値のパーサ 1 回あたりの時間 (旧実装 vs parseDayNumber / parseDecimalFast)
+// usage: ./parse_bench [calls=5000000]
+#include "RateTable.hpp"
+#include "Utils.hpp"
+#include "../Timer.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// 旧 BitcoinExchange::isValidDate (checkYMD + splitYMD)
+static bool legacyIsValidDate(const std::string& date) {
+    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    if (date.size() != DATE_TOTAL_LEN) return false;
+    for (std::size_t i = 0; i < date.size(); i++) {
+        if (i == DATE_YEAR_END || i == DATE_MONTH_END) {
+            if (date[i] != '-') return false;
+        } else {
+            if (!std::isdigit(date[i])) return false;
+        }
+    }
+    int y = std::atoi(date.substr(0, DATE_YEAR_END).c_str());
+    int m = std::atoi(date.substr(DATE_YEAR_END + 1, DATE_MONTH_END - DATE_YEAR_END - 1).c_str());
+    int day = std::atoi(date.substr(DATE_MONTH_END + 1, DATE_TOTAL_LEN - DATE_MONTH_END - 1).c_str());
+    if (m < 1 || m > 12) return false;
+    int maxd = mdays[m-1];
+    if (m==2 && isLeapYear(y)) maxd = 29;
+    return day >= 1 && day <= maxd;
+}
+
+// 旧 BitcoinExchange::parseDouble
+static bool legacyParseDouble(const std::string& s, double& out) {
+    const char* c = s.c_str();
+    char* endp = 0;
+    out = std::strtod(c, &endp);
+    if (endp == c) return false;
+    while (*endp) {
+        if (!std::isspace(*endp)) return false;
+        ++endp;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    long calls = argc > 1 ? std::atol(argv[1]) : 5000000;
+    XorShift rng(3);
+    std::vector<std::string> dates, values;
+    char buf[64];
+    for (int i = 0; i < 4096; ++i) {
+        std::sprintf(buf, "%04u-%02u-%02u", 2009 + rng.below(14), 1 + rng.below(12),
+                     1 + rng.below(31));
+        dates.push_back(buf);
+        std::sprintf(buf, "%u.%u", rng.below(1000), rng.below(100));
+        values.push_back(buf);
+    }
+
+    long ok = 0;
+    double t0 = nowSeconds();
+    for (long i = 0; i < calls; ++i)
+        ok += legacyIsValidDate(dates[i & 4095]);
+    double t1 = nowSeconds();
+    for (long i = 0; i < calls; ++i) {
+        const std::string& s = dates[i & 4095];
+        uint32_t day;
+        ok += parseDayNumber(s.data(), s.size(), day);
+    }
+    double t2 = nowSeconds();
+    std::printf("date   legacy=%.1f ns/call parseDayNumber=%.1f ns/call (ok=%ld)\n",
+                (t1 - t0) * 1e9 / calls, (t2 - t1) * 1e9 / calls, ok);
+
+    double sum = 0.0;
+    t0 = nowSeconds();
+    for (long i = 0; i < calls; ++i) {
+        double v;
+        if (legacyParseDouble(values[i & 4095], v)) sum += v;
+    }
+    t1 = nowSeconds();
+    for (long i = 0; i < calls; ++i) {
+        const std::string& s = values[i & 4095];
+        double v;
+        if (parseDecimalFast(s.data(), s.data() + s.size(), v)) sum -= v;
+    }
+    t2 = nowSeconds();
+    std::printf("value  strtod=%.1f ns/call parseDecimalFast=%.1f ns/call (diff=%g)\n",
+                (t1 - t0) * 1e9 / calls, (t2 - t1) * 1e9 / calls, sum);
+    return 0;
+}
@@ -0,0 +1,126 @@
+// RateTable のバックエンド比較ベンチ (+ getRatesForDays の並び順別比較)
+// usage: ./rate_bench [rows=3000000] [lookups=5000000]
+#include "RateTable.hpp"
+#include "Utils.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static void nextDay(int& y, int& m, int& d) {
+    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    int maxd = (m == 2 && isLeapYear(y)) ? 29 : mdays[m - 1];
+    if (++d > maxd) { d = 1; if (++m > 12) { m = 1; ++y; } }
+}
+
+static std::string makeCsv(long rows) {
+    std::string csv = "date,exchange_rate\n";
+    csv.reserve(static_cast<std::size_t>(rows) * 24);
+    char buf[64];
+    int y = 1000, m = 1, d = 1;
+    XorShift rng(42);
+    for (long i = 0; i < rows; ++i) {
+        // 4 日に 1 日は欠損させて「直近過去」探索も通す
+        if (rng.below(4) != 0) {
+            std::sprintf(buf, "%04d-%02d-%02d,%.2f\n", y, m, d,
+                         static_cast<double>(rng.below(6000000)) / 100.0);
+            csv += buf;
+        }
+        nextDay(y, m, d);
+    }
+    return csv;
+}
+
+static std::vector<std::string> makeQueries(long n) {
+    std::vector<std::string> q;
+    q.reserve(static_cast<std::size_t>(n));
+    XorShift rng(7);
+    char buf[16];
+    for (long i = 0; i < n; ++i) {
+        int y = 990 + static_cast<int>(rng.below(9000));
+        int m = 1 + static_cast<int>(rng.below(12));
+        int d = 1 + static_cast<int>(rng.below(28));
+        std::sprintf(buf, "%04d-%02d-%02d", y, m, d);
+        q.push_back(buf);
+    }
+    return q;
+}
+
+static void run(const char* label, RateTable::Backend backend,
+                const std::string& csv, const std::vector<std::string>& q) {
+    RateTable table(backend);
+    std::istringstream in(csv);
+    double t0 = nowSeconds();
+    table.load(in);
+    double t1 = nowSeconds();
+    double sum = 0.0;
+    long found = 0;
+    for (std::size_t i = 0; i < q.size(); ++i) {
+        double r;
+        if (table.getRateForDate(q[i], r)) { sum += r; ++found; }
+    }
+    double t2 = nowSeconds();
+    std::printf("%-5s rows=%zu mem=%.1fMiB load=%.3fs lookup=%.1f ns/op"
+                " found=%ld checksum=%.2f\n",
+                label, table.size(),
+                static_cast<double>(table.memoryFootprint()) / (1024.0 * 1024.0), t1 - t0,
+                (t2 - t1) * 1e9 / static_cast<double>(q.size()), found, sum);
+}
+
+// getRatesForDays と getRateForDay のループを、問い合わせの並び順ごとに比較する
+static void runBatch(const std::string& csv, const std::vector<std::string>& q) {
+    RateTable table(RateTable::FLAT);
+    std::istringstream in(csv);
+    table.load(in);
+    std::vector<uint32_t> random;
+    random.reserve(q.size());
+    for (std::size_t i = 0; i < q.size(); ++i) {
+        uint32_t day;
+        if (parseDayNumber(q[i].data(), q[i].size(), day)) random.push_back(day);
+    }
+    std::vector<uint32_t> sorted(random);
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> reversed(sorted.rbegin(), sorted.rend());
+    const std::vector<uint32_t>* orders[] = {&sorted, &reversed, &random};
+    static const char* names[] = {"sorted", "reversed", "random"};
+    static const std::size_t kBatch = 256;
+    std::vector<double> out(kBatch);
+    bool found[kBatch];
+    for (int o = 0; o < 3; ++o) {
+        const std::vector<uint32_t>& days = *orders[o];
+        double sum = 0.0;
+        double t0 = nowSeconds();
+        for (std::size_t i = 0; i < days.size(); ++i) {
+            double r;
+            if (table.getRateForDay(days[i], r)) sum += r;
+        }
+        double t1 = nowSeconds();
+        double bsum = 0.0;
+        for (std::size_t i = 0; i < days.size(); i += kBatch) {
+            const std::size_t n = std::min(kBatch, days.size() - i);
+            table.getRatesForDays(&days[i], n, &out[0], found);
+            for (std::size_t k = 0; k < n; ++k)
+                if (found[k]) bsum += out[k];
+        }
+        double t2 = nowSeconds();
+        std::printf("flat  %-8s single=%.1f ns/op batch=%.1f ns/op checksum=%.2f/%.2f\n",
+                    names[o], (t1 - t0) * 1e9 / static_cast<double>(days.size()),
+                    (t2 - t1) * 1e9 / static_cast<double>(days.size()), sum, bsum);
+    }
+}
+
+int main(int argc, char** argv) {
+    long rows = argc > 1 ? std::atol(argv[1]) : 3000000;
+    long lookups = argc > 2 ? std::atol(argv[2]) : 5000000;
+    std::string csv = makeCsv(rows);
+    std::vector<std::string> q = makeQueries(lookups);
+    run("map", RateTable::MAP, csv, q);
+    run("flat", RateTable::FLAT, csv, q);
+    run("dense", RateTable::DENSE, csv, q);
+    runBatch(csv, q);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// LiveRateTable: reader のレイテンシ分布 (reload なし / 並行 reload あり)
+// usage: ./reload_bench [readers=4] [rows=1000000] [lookups_per_reader=2000000]
+#include "LiveRateTable.hpp"
+#include "Utils.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+static std::string makeCsv(long rows, unsigned generation) {
+    std::string csv = "date,exchange_rate\n";
+    csv.reserve(static_cast<std::size_t>(rows) * 20);
+    char buf[64];
+    const uint32_t first = daysFromCivil(1000, 1, 1);
+    for (long i = 0; i < rows; ++i) {
+        char date[DATE_TOTAL_LEN];
+        formatDayNumber(first + static_cast<uint32_t>(i), date);
+        std::sprintf(buf, "%.10s,%u\n", date, generation);
+        csv += buf;
+    }
+    return csv;
+}
+
+struct ReaderArgs {
+    const LiveRateTable* table;
+    long lookups;
+    long rows;
+    uint64_t seed;
+    std::vector<double> latency; // ns
+};
+
+static void* reader(void* arg) {
+    ReaderArgs* a = static_cast<ReaderArgs*>(arg);
+    LiveRateTable::Reader r(*a->table);
+    XorShift rng(a->seed);
+    const uint32_t first = daysFromCivil(1000, 1, 1);
+    a->latency.resize(static_cast<std::size_t>(a->lookups));
+    double sink = 0.0;
+    for (long i = 0; i < a->lookups; ++i) {
+        const uint32_t day = first + rng.below(static_cast<uint32_t>(a->rows));
+        double rate = 0.0;
+        const double t0 = nowSeconds();
+        r.getRateForDay(day, rate);
+        a->latency[static_cast<std::size_t>(i)] = (nowSeconds() - t0) * 1e9;
+        sink += rate;
+    }
+    if (sink < 0) std::printf("%g\n", sink);
+    return 0;
+}
+
+struct ReloaderArgs {
+    LiveRateTable* table;
+    const std::vector<std::string>* csvs;
+    bool* stop;
+    unsigned reloads;
+};
+
+static void* reloader(void* arg) {
+    ReloaderArgs* a = static_cast<ReloaderArgs*>(arg);
+    while (!__atomic_load_n(a->stop, __ATOMIC_ACQUIRE)) {
+        std::istringstream in((*a->csvs)[a->reloads % a->csvs->size()]);
+        a->table->reload(in);
+        ++a->reloads;
+    }
+    return 0;
+}
+
+static void run(const char* label, unsigned readers, long rows, long lookups, bool withReload) {
+    LiveRateTable table(RateTable::FLAT);
+    std::vector<std::string> csvs;
+    csvs.push_back(makeCsv(rows, 1));
+    csvs.push_back(makeCsv(rows, 2));
+    {
+        std::istringstream in(csvs[0]);
+        table.reload(in);
+    }
+    bool stop = false;
+    ReloaderArgs ra;
+    ra.table = &table;
+    ra.csvs = &csvs;
+    ra.stop = &stop;
+    ra.reloads = 0;
+    pthread_t rtid;
+    if (withReload)
+        pthread_create(&rtid, 0, reloader, &ra);
+    std::vector<ReaderArgs> args(readers);
+    std::vector<pthread_t> tids(readers);
+    for (unsigned i = 0; i < readers; ++i) {
+        args[i].table = &table;
+        args[i].lookups = lookups;
+        args[i].rows = rows;
+        args[i].seed = 1000 + i;
+        pthread_create(&tids[i], 0, reader, &args[i]);
+    }
+    std::vector<double> all;
+    for (unsigned i = 0; i < readers; ++i) {
+        pthread_join(tids[i], 0);
+        all.insert(all.end(), args[i].latency.begin(), args[i].latency.end());
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    if (withReload)
+        pthread_join(rtid, 0);
+    std::sort(all.begin(), all.end());
+    const std::size_t n = all.size();
+    std::printf("%-9s readers=%u reloads=%u p50=%.0fns p90=%.0fns p99=%.0fns"
+                " p99.9=%.0fns max=%.0fns\n", label, readers, ra.reloads,
+                all[n / 2], all[n * 9 / 10], all[n * 99 / 100], all[n * 999 / 1000], all[n - 1]);
+}
+
+int main(int argc, char** argv) {
+    unsigned readers = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 4;
+    long rows = argc > 2 ? std::atol(argv[2]) : 1000000;
+    long lookups = argc > 3 ? std::atol(argv[3]) : 2000000;
+    run("static", readers, rows, lookups, false);
+    run("reloading", readers, rows, lookups, true);
+    return 0;
+}
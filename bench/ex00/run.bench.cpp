@@ -0,0 +1,71 @@
+// BitcoinExchange::run と runStream のスループット比較 (lines/s)
+// usage: ./run_bench [lines=5000000] [bad_percent=10]
+#include "BitcoinExchange.hpp"
+#include "Utils.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static std::string makeDb() {
+    std::string csv = "date,exchange_rate\n";
+    char buf[64];
+    for (int y = 2009; y <= 2022; ++y)
+        for (int m = 1; m <= 12; ++m)
+            for (int d = 1; d <= 28; ++d) {
+                std::sprintf(buf, "%04d-%02d-%02d,%d.%02d\n", y, m, d, y - 2000, d);
+                csv += buf;
+            }
+    return csv;
+}
+
+static std::string makeInput(long lines, unsigned badPercent) {
+    static const char* bad[] = {
+        "2011-01-03 | -1\n", "2011-01-03 | 1001\n", "2001-42-42\n",
+        "2011-02-30 | 1\n", "2011-01-03 | abc\n"
+    };
+    std::string in = "date | value\n";
+    in.reserve(static_cast<std::size_t>(lines) * 24);
+    XorShift rng(1);
+    char buf[64];
+    for (long i = 0; i < lines; ++i) {
+        if (rng.below(100) < badPercent) {
+            in += bad[rng.below(5)];
+            continue;
+        }
+        std::sprintf(buf, "%04d-%02d-%02d | %u.%u\n", 2009 + static_cast<int>(rng.below(14)),
+                     1 + static_cast<int>(rng.below(12)), 1 + static_cast<int>(rng.below(28)),
+                     rng.below(1000), rng.below(100));
+        in += buf;
+    }
+    return in;
+}
+
+int main(int argc, char** argv) {
+    long lines = argc > 1 ? std::atol(argv[1]) : 5000000;
+    unsigned badPercent = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 10;
+    std::string db = makeDb();
+    std::string input = makeInput(lines, badPercent);
+    std::ofstream devnull("/dev/null");
+
+    static const char* names[] = {"map", "flat", "dense"};
+    for (int b = RateTable::MAP; b <= RateTable::DENSE; ++b) {
+        std::istringstream dbIn(db);
+        BitcoinExchange app(dbIn, static_cast<RateTable::Backend>(b));
+        for (int mode = 0; mode < 2; ++mode) {
+            std::istringstream in(input);
+            double t0 = nowSeconds();
+            if (mode == 0)
+                app.run(in, devnull, devnull);
+            else
+                app.runStream(in, devnull, devnull);
+            double t = nowSeconds() - t0;
+            std::printf("%-5s %-9s bad=%u%% %.2f M lines/s\n", names[b],
+                        mode == 0 ? "run" : "runStream", badPercent,
+                        static_cast<double>(lines) / t / 1e6);
+        }
+    }
+    return 0;
+}
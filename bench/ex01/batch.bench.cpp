@@ -0,0 +1,57 @@
+// 1 行ずつ evaluateWith する場合と evaluateBatch (列ごと) の比較
+// usage: ./batch_bench [rows=4000000]
+#include "RPNProgram.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+int main(int argc, char** argv) {
+    const std::size_t rows = argc > 1 ? std::strtoul(argv[1], 0, 10) : 4000000;
+    static const char* exprs[] = {
+        "x y + a0 - a1 + a2 -",
+        "x y * a0 +",
+        "x 3 * y - a0 /"
+    };
+    XorShift rng;
+    std::vector<std::vector<long long> > cols(RPNProgram::kNumVariables,
+                                              std::vector<long long>(rows));
+    for (std::size_t v = 0; v < cols.size(); ++v)
+        for (std::size_t i = 0; i < rows; ++i)
+            cols[v][i] = static_cast<long long>(rng.next() % 2000001) - 1000000;
+    const long long* columns[RPNProgram::kNumVariables];
+    for (std::size_t v = 0; v < cols.size(); ++v) columns[v] = &cols[v][0];
+    std::vector<long long> out(rows);
+    std::vector<unsigned char> errors(rows);
+
+    for (std::size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        RPNProgram prog = RPNProgram::compile(exprs[e]);
+        long long sum = 0;
+        std::size_t failed = 0;
+        double t0 = nowSeconds();
+        for (std::size_t i = 0; i < rows; ++i) {
+            long long vars[RPNProgram::kNumVariables];
+            for (std::size_t v = 0; v < cols.size(); ++v) vars[v] = cols[v][i];
+            try {
+                sum += prog.evaluateWith(vars);
+            } catch (const std::exception&) {
+                ++failed;
+            }
+        }
+        double t1 = nowSeconds();
+        prog.evaluateBatch(columns, rows, &out[0], &errors[0]);
+        double t2 = nowSeconds();
+        long long batchSum = 0;
+        std::size_t batchFailed = 0;
+        for (std::size_t i = 0; i < rows; ++i) {
+            batchSum += out[i];
+            batchFailed += errors[i] != RPNProgram::LANE_OK;
+        }
+        const double scalar = (t1 - t0) * 1e9 / static_cast<double>(rows);
+        const double batch = (t2 - t1) * 1e9 / static_cast<double>(rows);
+        std::fprintf(stderr, "%-22s scalar=%6.2f ns/row batch=%6.2f ns/row (%.1fx) errors=%zu/%zu %s\n",
+                     exprs[e], scalar, batch, scalar / batch, failed, batchFailed,
+                     sum == batchSum && failed == batchFailed ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+// 1) 旧 processOperator (+/- は wrap、* は __int128 で判定) と CheckedMath.hpp の比較
+// 2) bigint モード: 階乗のような掛け算の連続と、あふれない式での余分なコスト
+// usage: ./checked_bench [ops=20000000]
+#include "RPN.hpp"
+#include "CheckedMath.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static bool willMulOverflow(long long a, long long b) {
+    if (a == 0 || b == 0) return false;
+    __int128 t = static_cast<__int128>(a) * static_cast<__int128>(b);
+    return (t > std::numeric_limits<long long>::max() ||
+            t < std::numeric_limits<long long>::min());
+}
+
+__attribute__((noinline))
+static long long legacyOperator(char op, long long a, long long b) {
+    switch (op) {
+        case '+': return b + a;
+        case '-': return b - a;
+        case '*':
+            if (willMulOverflow(b, a))
+                throw std::overflow_error("multiplication overflow");
+            return b * a;
+        default:
+            if (a == 0)
+                throw std::runtime_error("division by zero.");
+            if (b == std::numeric_limits<long long>::min() && a == -1)
+                throw std::overflow_error("division overflow: LLONG_MIN / -1");
+            return b / a;
+    }
+}
+
+__attribute__((noinline))
+static long long checkedOperator(char op, long long a, long long b) {
+    switch (op) {
+        case '+': return checkedAdd(b, a);
+        case '-': return checkedSub(b, a);
+        case '*': return checkedMul(b, a);
+        default:  return checkedDiv(b, a);
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::size_t n = argc > 1 ? std::strtoul(argv[1], 0, 10) : 20000000;
+    static const char opChars[4] = {'+', '-', '*', '/'};
+    XorShift rng;
+    std::vector<long long> as(n), bs(n);
+    std::vector<char> ops(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        as[i] = static_cast<long long>(rng.below(2000000)) - 1000000;
+        bs[i] = static_cast<long long>(rng.below(2000000)) - 1000000;
+        if (as[i] == 0) as[i] = 1;
+        ops[i] = opChars[rng.below(4)];
+    }
+    // 演算子ごとの列 (分岐予測が当たる場合) と混ぜた列の両方
+    const char* labels[] = {"+ only", "- only", "* only", "/ only", "mixed"};
+    for (int mode = 0; mode < 5; ++mode) {
+        long long s1 = 0, s2 = 0;
+        double t0 = nowSeconds();
+        for (std::size_t i = 0; i < n; ++i)
+            s1 += legacyOperator(mode < 4 ? opChars[mode] : ops[i], as[i], bs[i]);
+        double t1 = nowSeconds();
+        for (std::size_t i = 0; i < n; ++i)
+            s2 += checkedOperator(mode < 4 ? opChars[mode] : ops[i], as[i], bs[i]);
+        double t2 = nowSeconds();
+        std::fprintf(stderr, "%-7s legacy=%5.2f ns/op  checked=%5.2f ns/op %s\n", labels[mode],
+                     (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, s1 == s2 ? "ok" : "(sums differ)");
+    }
+
+    // bigint: (9!)^k
+    const std::string fact = "1 2 * 3 * 4 * 5 * 6 * 7 * 8 * 9 *";
+    const int powers[] = {2, 10, 100, 1000};
+    for (int p = 0; p < 4; ++p) {
+        std::string expr = fact;
+        for (int i = 1; i < powers[p]; ++i) expr += " " + fact + " *";
+        const int reps = powers[p] >= 1000 ? 3 : 200;
+        std::size_t digits = 0;
+        double t0 = nowSeconds();
+        for (int r = 0; r < reps; ++r)
+            digits = RPN::evaluateBigInt(expr).size();
+        double t1 = nowSeconds();
+        std::fprintf(stderr, "bigint (9!)^%-4d %6zu digits  %10.1f us/eval\n", powers[p], digits,
+                     (t1 - t0) * 1e6 / reps);
+    }
+
+    // あふれない式: bigint モードの余分なコスト
+    std::ofstream devnull("/dev/null");
+    std::streambuf* saved = std::cout.rdbuf(devnull.rdbuf());
+    const std::string small = "8 9 * 9 - 9 - 9 - 4 - 1 +";
+    const long evals = 200000;
+    double t0 = nowSeconds();
+    for (long i = 0; i < evals; ++i)
+        RPN::parseAndPushToken(small);
+    double t1 = nowSeconds();
+    for (long i = 0; i < evals; ++i)
+        RPN::evaluateBigInt(small);
+    double t2 = nowSeconds();
+    std::cout.rdbuf(saved);
+    std::fprintf(stderr, "no overflow: parseAndPushToken=%6.1f ns/eval  evaluateBigInt=%6.1f ns/eval\n",
+                 (t1 - t0) * 1e9 / evals, (t2 - t1) * 1e9 / evals);
+    return 0;
+}
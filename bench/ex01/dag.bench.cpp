@@ -0,0 +1,55 @@
+// RPNProgram (そのまま) と RPNDag (定数畳み込み + 共通部分式の共有) の比較
+// usage: ./dag_bench [evaluations=2000000]
+#include "RPNProgram.hpp"
+#include "RPNDag.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// (x y - a0 *) の 2 乗を n 個、+ で足す: 生成された式にありがちな重複
+static std::string repeated(int n) {
+    std::string e;
+    for (int i = 0; i < n; ++i) {
+        e += "x y - a0 * x y - a0 * * ";
+        if (i > 0) e += "+ ";
+    }
+    return e;
+}
+
+int main(int argc, char** argv) {
+    const long evals = argc > 1 ? std::atol(argv[1]) : 2000000;
+    const std::string exprs[] = {
+        "x 3 4 * 2 + * y 9 9 * 1 - * + 7 7 * 7 - /",
+        "x y + x y + * y x + y x + * + x y + -",
+        "a0 a1 * a2 + a0 a1 * a2 + * a0 a1 * a2 + 2 * + 1 +",
+        repeated(8)
+    };
+    XorShift rng;
+    long long vars[RPNProgram::kNumVariables];
+    for (std::size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        RPNProgram prog = RPNProgram::compile(exprs[e]);
+        RPNDag dag = RPNDag::optimize(exprs[e]);
+        long long sum1 = 0, sum2 = 0;
+        double tp = 0, td = 0;
+        const long rounds = 16;
+        for (long r = 0; r < rounds; ++r) { // 変数の値を変えながら交互に測る
+            for (std::size_t v = 0; v < RPNProgram::kNumVariables; ++v)
+                vars[v] = static_cast<long long>(rng.below(2001)) - 1000;
+            double t0 = nowSeconds();
+            for (long i = 0; i < evals / rounds; ++i)
+                sum1 += prog.evaluateWith(vars);
+            double t1 = nowSeconds();
+            for (long i = 0; i < evals / rounds; ++i)
+                sum2 += dag.evaluateWith(vars);
+            double t2 = nowSeconds();
+            tp += t1 - t0;
+            td += t2 - t1;
+        }
+        const double n = static_cast<double>(evals / rounds * rounds);
+        std::fprintf(stderr, "nodes %3zu -> %3zu (ops %3zu)  program=%6.1f ns/eval  dag=%6.1f ns/eval"
+                     " (%.1fx) %s\n", dag.nodesBefore(), dag.nodesAfter(), dag.operations(),
+                     tp * 1e9 / n, td * 1e9 / n, tp / td, sum1 == sum2 ? "ok" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+// 1 行 1 式のファイルを、逐次 (flush あり/なし) と runParallel (スレッド数別) で評価する
+// usage: ./parallel_bench [lines=2000000] [tmpfile=/tmp/rpn_parallel_bench.txt]
+#include "RPN.hpp"
+#include "RPNStream.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    const unsigned long lines = argc > 1 ? std::strtoul(argv[1], 0, 10) : 2000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/rpn_parallel_bench.txt";
+    static const char* exprs[] = {
+        "3 4 + 2 *", "8 9 * 9 - 9 - 9 - 4 - 1 +", "1 2 * 2 / 2 * 2 4 - +"
+    };
+    {
+        std::ofstream f(path);
+        for (unsigned long i = 0; i < lines; ++i)
+            f << (i % 64 == 63 ? "1 0 /" : exprs[i % 3]) << '\n'; // 64 行に 1 行はエラー
+    }
+    std::ofstream devnull("/dev/null");
+    std::streambuf* savedOut = std::cout.rdbuf(devnull.rdbuf()); // 解釈器は cout に出力する
+    std::streambuf* savedErr = std::cerr.rdbuf(devnull.rdbuf());
+
+    double t0 = nowSeconds();
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            try {
+                RPN::parseAndPushToken(line); // 1 結果ごとに std::endl で flush
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+    }
+    double t1 = nowSeconds();
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        RPNStream stream(devnull, devnull);
+        stream.run(in);
+    }
+    double t2 = nowSeconds();
+    std::cout.rdbuf(savedOut);
+    std::cerr.rdbuf(savedErr);
+    const double n = static_cast<double>(lines);
+    std::fprintf(stderr, "serial, endl per result : %8.1f ns/line\n", (t1 - t0) * 1e9 / n);
+    std::fprintf(stderr, "serial, RPNStream       : %8.1f ns/line (%.1fx)\n",
+                 (t2 - t1) * 1e9 / n, (t1 - t0) / (t2 - t1));
+
+    const unsigned threads[] = {1, 2, 4, 8};
+    double base = 0;
+    for (std::size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t) {
+        double s0 = nowSeconds();
+        RPNStream::Stats stats = RPNStream::runParallel(path, devnull, devnull, threads[t]);
+        double s1 = nowSeconds();
+        if (t == 0) base = s1 - s0;
+        std::fprintf(stderr, "runParallel threads=%u   : %8.1f ns/line (%.2fx vs 1 thread)"
+                     " errors=%lu\n", threads[t], (s1 - s0) * 1e9 / n, base / (s1 - s0),
+                     stats.errors);
+    }
+    std::remove(path);
+    return 0;
+}
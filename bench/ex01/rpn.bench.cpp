@@ -0,0 +1,42 @@
+// RPN::parseAndPushToken (毎回パースして評価) と RPNProgram (1 回 compile して評価) の比較
+// usage: ./rpn_bench [evaluations=1000000]
+#include "RPN.hpp"
+#include "RPNProgram.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    long evals = argc > 1 ? std::atol(argv[1]) : 1000000;
+    static const char* exprs[] = {
+        "8 9 * 9 - 9 - 9 - 4 - 1 +",
+        "7 7 * 7 -",
+        "1 2 * 2 / 2 * 2 4 - +",
+        "9 8 7 6 5 4 3 2 1 + + + + + + + + 3 * 2 / 7 - 5 * 1 +"
+    };
+    std::ofstream devnull("/dev/null");
+    std::streambuf* saved = std::cout.rdbuf(devnull.rdbuf()); // 解釈器は cout に出力する
+    for (std::size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        const std::string expr = exprs[e];
+        const long interpEvals = evals / 10;
+        double t0 = nowSeconds();
+        for (long i = 0; i < interpEvals; ++i)
+            RPN::parseAndPushToken(expr);
+        double t1 = nowSeconds();
+        RPNProgram prog = RPNProgram::compile(expr);
+        long long sum = 0;
+        double t2 = nowSeconds();
+        for (long i = 0; i < evals; ++i)
+            sum += prog.evaluate();
+        double t3 = nowSeconds();
+        const double interp = (t1 - t0) * 1e9 / static_cast<double>(interpEvals);
+        const double byteCode = (t3 - t2) * 1e9 / static_cast<double>(evals);
+        std::fprintf(stderr, "tokens=%-3zu interpreter=%8.1f ns/eval bytecode=%6.1f ns/eval"
+                     " (%.0fx) sum=%lld\n", prog.size(), interp, byteCode, interp / byteCode, sum);
+    }
+    std::cout.rdbuf(saved);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// std::stack<long long, std::list<long long> > (旧実装) と RPNStack の比較
+// 同じトークンループで、allocation 数と ns/token を測る
+// usage: ./stack_bench [tokens=1000000]
+#include "RPN.hpp"
+#include "RPNStack.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stack>
+#include <list>
+#include <string>
+
+static unsigned long g_allocs = 0;
+
+void* operator new(std::size_t n) throw(std::bad_alloc) {
+    ++g_allocs;
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void operator delete(void* p) throw() { std::free(p); }
+void* operator new[](std::size_t n) throw(std::bad_alloc) { return operator new(n); }
+void operator delete[](void* p) throw() { std::free(p); }
+
+static long long add(long long a, long long b) { return b + a; }
+
+static long long runList(const std::string& expr) {
+    std::stringstream ss(expr);
+    std::string token;
+    std::stack<long long, std::list<long long> > st;
+    while (ss >> token) {
+        if (std::isdigit(token[0])) {
+            st.push(token[0] - '0');
+        } else {
+            if (st.size() < 2)
+                throw std::runtime_error("insufficient values in expression.");
+            long long a = st.top();
+            st.pop();
+            long long b = st.top();
+            st.pop();
+            st.push(add(a, b));
+        }
+    }
+    if (st.size() != 1)
+        throw std::runtime_error("the input has too many values.");
+    return st.top();
+}
+
+static long long runArray(const std::string& expr) {
+    std::stringstream ss(expr);
+    std::string token;
+    RPNStack st;
+    while (ss >> token) {
+        if (std::isdigit(token[0])) {
+            st.push(token[0] - '0');
+        } else {
+            long long a, b;
+            st.pop2(a, b);
+            st.push(add(a, b));
+        }
+    }
+    return st.result();
+}
+
+static void measure(const char* label, const std::string& expr, std::size_t tokens) {
+    long long r1, r2;
+    unsigned long a0 = g_allocs;
+    double t0 = nowSeconds();
+    r1 = runList(expr);
+    double t1 = nowSeconds();
+    unsigned long a1 = g_allocs;
+    r2 = runArray(expr);
+    double t2 = nowSeconds();
+    unsigned long a2 = g_allocs;
+    const double n = static_cast<double>(tokens);
+    std::fprintf(stderr, "%-8s list: %.3f allocs/token %6.1f ns/token | array: %.6f allocs/token"
+                 " %6.1f ns/token %s\n", label,
+                 static_cast<double>(a1 - a0) / n, (t1 - t0) * 1e9 / n,
+                 static_cast<double>(a2 - a1) / n, (t2 - t1) * 1e9 / n,
+                 r1 == r2 ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char** argv) {
+    const std::size_t tokens = argc > 1 ? std::strtoul(argv[1], 0, 10) : 1000000;
+    const std::size_t half = tokens / 2;
+    // 浅い: 1 1 + 1 + 1 + ...  (深さ 2)
+    std::string shallow = "1";
+    for (std::size_t i = 1; i < half; ++i) shallow += " 1 +";
+    // 深い: 1 1 1 ... + + + ...  (深さ = tokens / 2)
+    std::string deep;
+    for (std::size_t i = 0; i < half; ++i) deep += "1 ";
+    for (std::size_t i = 1; i < half; ++i) deep += "+ ";
+    measure("shallow", shallow, 2 * half - 1);
+    measure("deep", deep, 2 * half - 1);
+    return 0;
+}
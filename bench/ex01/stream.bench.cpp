@@ -0,0 +1,87 @@
+// RPNStream (ブロック読み) と、行/全体を文字列にしてから parseAndPushToken する方法の比較
+// usage: ./stream_bench [tokens=20000000] [tmpfile=/tmp/rpn_stream_bench.txt]
+#include "RPN.hpp"
+#include "RPNStream.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h> // getrusage
+
+static long maxRssMiB() {
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss / 1024;
+}
+
+static void writeLines(const char* path, unsigned long tokens) {
+    std::ofstream f(path);
+    static const char* exprs[] = {"3 4 + 2 *\n", "8 9 * 9 - 9 - 9 - 4 - 1 +\n", "1 2 * 2 / 2 * 2 4 - +\n"};
+    static const unsigned long counts[] = {5, 11, 11};
+    for (unsigned long t = 0, i = 0; t < tokens; ++i) {
+        f << exprs[i % 3];
+        t += counts[i % 3];
+    }
+}
+
+static void writeSingle(const char* path, unsigned long tokens) {
+    std::ofstream f(path);
+    f << '1';
+    for (unsigned long t = 1; t + 2 <= tokens; t += 2)
+        f << (t % 4 == 1 ? " 1 +" : " 1 -");
+    f << '\n';
+}
+
+static void runStream(const char* label, const char* path, std::ostream& sink) {
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    RPNStream stream(sink, std::cerr);
+    double t0 = nowSeconds();
+    stream.run(in);
+    double t1 = nowSeconds();
+    const RPNStream::Stats& s = stream.stats();
+    std::fprintf(stderr, "%-7s stream:   %7.1f Mtokens/s %7.1f MB/s  lines=%lu  maxrss=%ld MiB\n",
+                 label, s.tokens / (t1 - t0) * 1e-6, s.bytes / (t1 - t0) * 1e-6, s.lines,
+                 maxRssMiB());
+}
+
+static void runLineByLine(const char* label, const char* path, unsigned long tokens) {
+    std::ifstream in(path);
+    std::string line;
+    double t0 = nowSeconds();
+    while (std::getline(in, line))
+        RPN::parseAndPushToken(line);
+    double t1 = nowSeconds();
+    std::fprintf(stderr, "%-7s getline:  %7.1f Mtokens/s\n", label, tokens / (t1 - t0) * 1e-6);
+}
+
+static void runWhole(const char* label, const char* path, unsigned long tokens) {
+    std::ifstream in(path);
+    std::stringstream whole;
+    double t0 = nowSeconds();
+    whole << in.rdbuf();
+    RPN::parseAndPushToken(whole.str());
+    double t1 = nowSeconds();
+    std::fprintf(stderr, "%-7s in-memory:%7.1f Mtokens/s                maxrss=%ld MiB\n",
+                 label, tokens / (t1 - t0) * 1e-6, maxRssMiB());
+}
+
+int main(int argc, char** argv) {
+    const unsigned long tokens = argc > 1 ? std::strtoul(argv[1], 0, 10) : 20000000;
+    const char* path = argc > 2 ? argv[2] : "/tmp/rpn_stream_bench.txt";
+    std::ofstream devnull("/dev/null");
+    std::streambuf* saved = std::cout.rdbuf(devnull.rdbuf()); // 解釈器は cout に出力する
+
+    writeLines(path, tokens);
+    runStream("lines", path, devnull);
+    runLineByLine("lines", path, tokens);
+    writeSingle(path, tokens);
+    runStream("single", path, devnull);
+    runWhole("single", path, tokens); // 最後に測る (maxrss は増える一方なので)
+
+    std::cout.rdbuf(saved);
+    std::remove(path);
+    return 0;
+}
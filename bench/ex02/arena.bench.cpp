@@ -0,0 +1,60 @@
+// mergeInsertionSort (段ごとにコンテナを作る) と mergeInsertionSortArena (作業領域を 1 回だけ確保) の比較
+// usage: ./arena_bench [sizes...]   (default: 3000 30000 100000)
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <vector>
+
+static unsigned long g_allocs = 0;
+
+// noinline: インライン展開されると GCC が malloc/free と new/delete の組み合わせを誤検出する
+__attribute__((noinline))
+void* operator new(std::size_t n) throw(std::bad_alloc) {
+    ++g_allocs;
+    void* p = std::malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline))
+void operator delete(void* p) throw() { std::free(p); }
+void* operator new[](std::size_t n) throw(std::bad_alloc) { return operator new(n); }
+void operator delete[](void* p) throw() { std::free(p); }
+
+template <typename Container>
+static void run(const char* label, const std::vector<int>& data) {
+    Container input(data.begin(), data.end());
+    PmergeMe<Container> sorter;
+    unsigned long a0 = g_allocs;
+    double t0 = nowSeconds();
+    typedef typename PmergeMe<Container>::index_container Indices;
+    Indices plain = sorter.mergeInsertionSort(input.begin(), input.end());
+    double t1 = nowSeconds();
+    unsigned long a1 = g_allocs;
+    Indices arena = sorter.mergeInsertionSortArena(input.begin(), input.end());
+    double t2 = nowSeconds();
+    unsigned long a2 = g_allocs;
+    std::fprintf(stderr, "%-6s N=%-9zu plain: %9lu allocs %10.2f ms | arena: %3lu allocs %10.2f ms"
+                 " (%.2fx) %s\n", label, data.size(), a1 - a0, (t1 - t0) * 1e3, a2 - a1,
+                 (t2 - t1) * 1e3, (t1 - t0) / (t2 - t1), plain == arena ? "same" : "DIFFERENT");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(3000);
+        sizes.push_back(30000);
+        sizes.push_back(100000);
+    }
+    XorShift rng;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> data(sizes[s]);
+        for (std::size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        run<std::vector<int> >("vector", data);
+        run<std::deque<int> >("deque", data);
+    }
+    return 0;
+}
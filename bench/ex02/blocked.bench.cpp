@@ -0,0 +1,40 @@
+// mergeInsertionSortArena (配列の main chain) と mergeInsertionSortBlocked (BlockedChain) の比較
+// usage: ./blocked_bench [sizes...]   (default: 100000 1000000)
+// 配列版は挿入 1 回で O(N) 要素を動かすので、arenaMax を超える大きさでは blocked だけ測る
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const std::size_t arenaMax = 300000;
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+    XorShift rng;
+    PmergeMe<std::vector<int> > sorter;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> input(sizes[s]);
+        for (std::size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        double t0 = nowSeconds();
+        std::vector<uint32_t> blocked = sorter.mergeInsertionSortBlocked(input.begin(), input.end());
+        double t1 = nowSeconds();
+        if (sizes[s] > arenaMax) {
+            std::fprintf(stderr, "N=%-9zu blocked: %10.2f ms | arena: skipped\n",
+                         input.size(), (t1 - t0) * 1e3);
+            continue;
+        }
+        std::vector<uint32_t> arena = sorter.mergeInsertionSortArena(input.begin(), input.end());
+        double t2 = nowSeconds();
+        std::fprintf(stderr, "N=%-9zu blocked: %10.2f ms | arena: %10.2f ms (%.2fx) %s\n",
+                     input.size(), (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t2 - t1) / (t1 - t0),
+                     arena == blocked ? "same" : "DIFFERENT");
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+// 挿入位置の探索: binaryInsertion と同じ分岐あり二分探索 と lowerBoundInt (分岐なし + SIMD) の比較
+// usage: ./branchless_bench [sizes...]   (default: 3000 30000 1000000)
+// AVX2 で測るなら make bench BENCH_ARCH=-mavx2
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// PmergeMe::searchInsertPos と同じ探索 (一致したら打ち切る)
+static int branchySearch(const int* a, int m, int val) {
+    int left = 0;
+    int right = m - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        if (a[mid] == val) {
+            left = mid;
+            break;
+        } else if (a[mid] < val) {
+            left = mid + 1;
+        } else {
+            right = mid - 1;
+        }
+    }
+    return left;
+}
+
+// 長さ m の昇順配列で、ランダムな値の位置を queries 回探す
+// (配列は偶数、探す値は奇数にして、一致で打ち切る分岐ありの方とも同じ位置になるようにする)
+static void searchOnly(XorShift& rng, int m, int queries) {
+    std::vector<int> a(m);
+    for (int i = 0; i < m; ++i) a[i] = 2 * static_cast<int>(rng.below(500000000));
+    std::sort(a.begin(), a.end());
+    std::vector<int> q(queries);
+    for (int i = 0; i < queries; ++i) q[i] = 2 * static_cast<int>(rng.below(500000000)) + 1;
+    long sum = 0;
+    double t0 = nowSeconds();
+    for (int i = 0; i < queries; ++i) sum += branchySearch(&a[0], m, q[i]);
+    double t1 = nowSeconds();
+    long machine = 0;
+    for (int i = 0; i < queries; ++i) sum -= lowerBoundInt(&a[0], m, q[i], machine);
+    double t2 = nowSeconds();
+    std::fprintf(stderr, "search m=%-8d branchy %6.1f ns | branchless %6.1f ns (%.2fx) %s\n", m,
+                 (t1 - t0) * 1e9 / queries, (t2 - t1) * 1e9 / queries, (t1 - t0) / (t2 - t1),
+                 sum == 0 ? "same" : "DIFFERENT");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(3000);
+        sizes.push_back(30000);
+        sizes.push_back(1000000);
+    }
+    XorShift rng;
+    const int lengths[] = {64, 1024, 16384, 1 << 20};
+    for (std::size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+        searchOnly(rng, lengths[i], 2000000);
+
+    PmergeMe<std::vector<int> > sorter;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> input(sizes[s]);
+        for (std::size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        const int reps = sizes[s] < 100000 ? 20 : 1;
+        std::vector<int> a, b;
+        double t0 = nowSeconds();
+        for (int r = 0; r < reps; ++r) {
+            a = input;
+            sorter.sortValues(a.begin(), a.end());
+        }
+        double t1 = nowSeconds();
+        for (int r = 0; r < reps; ++r) {
+            b = input;
+            sorter.sortValues(b.begin(), b.end(), PmergeMe<std::vector<int> >::SEARCH_BRANCHLESS);
+        }
+        double t2 = nowSeconds();
+        std::fprintf(stderr, "sortValues N=%-8zu branchy %9.3f ms | branchless %9.3f ms (%.2fx) %s\n",
+                     input.size(), (t1 - t0) * 1e3 / reps, (t2 - t1) * 1e3 / reps,
+                     (t1 - t0) / (t2 - t1), a == b ? "same" : "DIFFERENT");
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+// 比較が高いとき、Ford-Johnson の少ない比較回数が std::sort に時間で勝つかを見る
+// usage: ./compare_bench [N]   (default: 100000)
+//   lookup: uint32_t の ID を、rounds 回のハッシュで引いた値で比べる (遠くのキーを引く代わり)
+//   prefix: 共通の接頭辞 P バイトを持つ文字列 (比べるたびに P バイト読む)
+// 比較 1 回の時間は同じ比較を続けて呼んで測る
+// 計算で高い比較 (lookup) なら比較回数の差がそのまま効くが、文字列のように
+// キャッシュミスで高い比較では、chain 全体を二分探索する Ford-Johnson の方が不利
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static uint32_t derive(uint32_t x, int rounds) {
+    for (int r = 0; r < rounds; ++r) { // 1 段ずつは全単射なので、違う ID は違う値になる
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+    }
+    return x;
+}
+
+struct LookupLess {
+    explicit LookupLess(int r = 0) : rounds(r) {}
+    bool operator()(uint32_t a, uint32_t b) const { return derive(a, rounds) < derive(b, rounds); }
+    int rounds;
+};
+
+// std::sort に渡す側で比較回数を数える
+template <typename Less>
+struct Counted {
+    Counted(const Less& l, long& n) : less(l), calls(&n) {}
+    template <typename T>
+    bool operator()(const T& a, const T& b) const {
+        ++*calls;
+        return less(a, b);
+    }
+    Less less;
+    long* calls;
+};
+
+// インデックスを文字列の順で比べる (std::sort でもコピーせずに並べる)
+struct IndexLess {
+    explicit IndexLess(const std::vector<std::string>& v) : keys(&v) {}
+    bool operator()(uint32_t a, uint32_t b) const { return (*keys)[a] < (*keys)[b]; }
+    const std::vector<std::string>* keys;
+};
+
+template <typename Less, typename T>
+static double nsPerCompare(const Less& less, const std::vector<T>& v) {
+    const std::size_t n = v.size() < 100000 ? v.size() : 100000;
+    volatile long sink = 0;
+    double t0 = nowSeconds();
+    for (std::size_t i = 1; i < n; ++i) sink = sink + less(v[i - 1], v[i]);
+    return (nowSeconds() - t0) * 1e9 / static_cast<double>(n - 1);
+}
+
+static void report(const char* what, const char* algo, double seconds, long comparisons,
+                   std::size_t n, double baseline, bool ok) {
+    std::fprintf(stderr, "  %-7s %-27s %10.2f ms  %6.2f cmp/elem", what, algo, seconds * 1e3,
+                 static_cast<double>(comparisons) / static_cast<double>(n));
+    if (baseline > 0) std::fprintf(stderr, "  vs std::sort %.2fx", baseline / seconds);
+    std::fprintf(stderr, " %s\n", ok ? "" : "WRONG");
+}
+
+static void lookup(std::size_t n, int rounds) {
+    XorShift rng(7);
+    std::vector<uint32_t> input(n);
+    for (std::size_t i = 0; i < n; ++i) input[i] = static_cast<uint32_t>(rng.next());
+    const LookupLess less(rounds);
+    std::fprintf(stderr, "lookup rounds=%-3d (%.1f ns/compare)\n", rounds, nsPerCompare(less, input));
+
+    std::vector<uint32_t> want(input);
+    long stdCalls = 0;
+    double t0 = nowSeconds();
+    std::sort(want.begin(), want.end(), Counted<LookupLess>(less, stdCalls));
+    const double stdTime = nowSeconds() - t0;
+    report("lookup", "std::sort", stdTime, stdCalls, n, 0, true);
+
+    std::vector<uint32_t> work(input);
+    long stableCalls = 0;
+    t0 = nowSeconds();
+    std::stable_sort(work.begin(), work.end(), Counted<LookupLess>(less, stableCalls));
+    report("lookup", "std::stable_sort", nowSeconds() - t0, stableCalls, n, stdTime, work == want);
+
+    typedef PmergeMe<std::vector<uint32_t>, LookupLess> Sorter;
+    Sorter sorter(less);
+    work = input;
+    t0 = nowSeconds();
+    sorter.sortValues(work.begin(), work.end());
+    report("lookup", "sortValues", nowSeconds() - t0, sorter.comparisons(), n, stdTime,
+           work == want);
+
+    Sorter::Options options;
+    options.smallKernels = true;
+    options.mergeAbove = 256;
+    sorter.resetCounters();
+    work = input;
+    t0 = nowSeconds();
+    sorter.sortValues(work.begin(), work.end(), options);
+    report("lookup", "sortValues merge>256", nowSeconds() - t0, sorter.comparisons(), n, stdTime,
+           work == want);
+}
+
+static void prefix(std::size_t n, std::size_t length) {
+    XorShift rng(11);
+    const std::string common(length, 'k');
+    std::vector<std::string> input(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        char tail[16];
+        std::snprintf(tail, sizeof(tail), "%010u", static_cast<unsigned>(rng.below(1000000000)));
+        input[i] = common + tail;
+    }
+    std::vector<uint32_t> order(n);
+    for (std::size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    const IndexLess less(input);
+    std::fprintf(stderr, "prefix P=%-5zu (%.1f ns/compare)\n", length, nsPerCompare(less, order));
+
+    std::vector<uint32_t> want(order);
+    long stdCalls = 0;
+    double t0 = nowSeconds();
+    std::sort(want.begin(), want.end(), Counted<IndexLess>(less, stdCalls));
+    const double stdTime = nowSeconds() - t0;
+    report("prefix", "std::sort (indices)", stdTime, stdCalls, n, 0, true);
+
+    std::vector<std::string> strings(input);
+    long copyCalls = 0;
+    t0 = nowSeconds();
+    std::sort(strings.begin(), strings.end(), Counted<std::less<std::string> >(
+                                                  std::less<std::string>(), copyCalls));
+    report("prefix", "std::sort (strings)", nowSeconds() - t0, copyCalls, n, stdTime, true);
+
+    PmergeMe<std::vector<std::string> > sorter;
+    t0 = nowSeconds();
+    std::vector<uint32_t> idx = sorter.mergeInsertionSortIndirect(input.begin(), input.end());
+    const double fjTime = nowSeconds() - t0;
+    bool ok = true; // 同じ文字列もあるので、インデックスではなく文字列で比べる
+    for (std::size_t i = 0; i < n && ok; ++i) ok = input[idx[i]] == strings[i];
+    report("prefix", "mergeInsertionSortIndirect", fjTime, sorter.comparisons(), n, stdTime, ok);
+}
+
+int main(int argc, char** argv) {
+    const std::size_t n = argc > 1 ? std::strtoul(argv[1], 0, 10) : 100000;
+    const int rounds[] = {0, 4, 16, 64, 256};
+    for (std::size_t r = 0; r < sizeof(rounds) / sizeof(rounds[0]); ++r) lookup(n, rounds[r]);
+    const std::size_t lengths[] = {0, 64, 512, 4096};
+    for (std::size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l) prefix(n, lengths[l]);
+    return 0;
+}
@@ -0,0 +1,51 @@
+// インデックス列を返して集める (mergeInsertionSortBlocked + gather) と、値を直接並べる
+// sortValues / ID を一緒に動かす sortWithPayload の比較
+// usage: ./direct_bench [sizes...]   (default: 100000 1000000)
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+template <typename Container>
+static void run(const char* label, const std::vector<int>& data) {
+    PmergeMe<Container> sorter;
+    Container input(data.begin(), data.end());
+    double t0 = nowSeconds();
+    typename PmergeMe<Container>::index_container idx = sorter.mergeInsertionSortBlocked(input.begin(), input.end());
+    Container gathered;
+    for (std::size_t i = 0; i < idx.size(); ++i) gathered.push_back(input[idx[i]]);
+    double t1 = nowSeconds();
+    Container values = input;
+    double t2 = nowSeconds();
+    sorter.sortValues(values.begin(), values.end());
+    double t3 = nowSeconds();
+    Container keys = input;
+    std::vector<uint64_t> ids(data.size());
+    for (std::size_t i = 0; i < ids.size(); ++i) ids[i] = i;
+    double t4 = nowSeconds();
+    sorter.sortWithPayload(keys.begin(), keys.end(), &ids[0]);
+    double t5 = nowSeconds();
+    std::fprintf(stderr, "%-6s N=%-8zu index+gather %8.2f ms | values %8.2f ms (%.2fx)"
+                 " | key+id %8.2f ms (%.2fx) %s\n", label, data.size(), (t1 - t0) * 1e3,
+                 (t3 - t2) * 1e3, (t1 - t0) / (t3 - t2), (t5 - t4) * 1e3, (t1 - t0) / (t5 - t4),
+                 gathered == values && gathered == keys ? "same" : "DIFFERENT");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+    XorShift rng;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> data(sizes[s]);
+        for (std::size_t i = 0; i < data.size(); ++i) data[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        run<std::vector<int> >("vector", data);
+        run<std::deque<int> >("deque", data);
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+// sortValues の方針ごとの比較回数と時間
+// usage: ./hybrid_bench [sizes...]   (default: 3000 30000 300000 3000000)
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static long g_stdComparisons = 0;
+
+struct CountingLess {
+    bool operator()(int x, int y) const {
+        ++g_stdComparisons;
+        return x < y;
+    }
+};
+
+typedef PmergeMe<std::vector<int> > Sorter;
+
+// 情報理論的下限 log2(N!)
+static double log2Factorial(std::size_t n) {
+    double s = 0;
+    for (std::size_t k = 2; k <= n; ++k) s += std::log(static_cast<double>(k));
+    return s / std::log(2.0);
+}
+
+struct Policy {
+    const char* name;
+    bool smallKernels;
+    bool branchless;
+    int mergeAbove;
+    int std; // 1: std::sort, 2: std::stable_sort
+};
+
+static void run(const Policy& p, const std::vector<int>& input, const std::vector<int>& want) {
+    const int reps = input.size() <= 300000 ? 5 : 1;
+    std::vector<double> samples;
+    long comparisons = 0;
+    bool ok = true;
+    for (int r = 0; r < reps; ++r) {
+        std::vector<int> work(input);
+        g_stdComparisons = 0;
+        Sorter sorter;
+        double t0 = nowSeconds();
+        if (p.std == 1) {
+            std::sort(work.begin(), work.end(), CountingLess());
+        } else if (p.std == 2) {
+            std::stable_sort(work.begin(), work.end(), CountingLess());
+        } else {
+            Sorter::Options options;
+            options.smallKernels = p.smallKernels;
+            options.search = p.branchless ? Sorter::SEARCH_BRANCHLESS : Sorter::SEARCH_BRANCHY;
+            options.mergeAbove = p.mergeAbove;
+            sorter.sortValues(work.begin(), work.end(), options);
+        }
+        samples.push_back(nowSeconds() - t0);
+        comparisons = p.std ? g_stdComparisons : sorter.comparisons();
+        ok = ok && work == want;
+    }
+    std::sort(samples.begin(), samples.end());
+    const double n = static_cast<double>(input.size());
+    std::fprintf(stderr, "N=%-8zu %-24s %9.3f ms  %7.3f comparisons/elem  (%.4f of log2 N!) %s\n",
+                 input.size(), p.name, samples[samples.size() / 2] * 1e3, comparisons / n,
+                 comparisons / log2Factorial(input.size()), ok ? "" : "WRONG");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(3000);
+        sizes.push_back(30000);
+        sizes.push_back(300000);
+        sizes.push_back(3000000);
+    }
+    const Policy policies[] = {
+        {"ford-johnson", false, false, 0, 0},
+        {"+small", true, false, 0, 0},
+        {"+small +branchless", true, true, 0, 0},
+        {"+small merge>4096", true, false, 4096, 0},
+        {"+small merge>256", true, false, 256, 0},
+        {"std::sort", false, false, 0, 1},
+        {"std::stable_sort", false, false, 0, 2},
+    };
+    XorShift rng;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> input(sizes[s]);
+        for (std::size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        std::vector<int> want(input);
+        std::sort(want.begin(), want.end());
+        for (std::size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p)
+            run(policies[p], input, want);
+    }
+    return 0;
+}
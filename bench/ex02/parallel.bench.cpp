@@ -0,0 +1,54 @@
+// mergeInsertionSortBlocked (逐次) と mergeInsertionSortParallel (グループごとの一括挿入) の比較
+// usage: ./parallel_bench [sizes...]   (default: 1000000 10000000)
+// PMERGE_THREADS="1 2 4 8 16" でスレッド数の一覧を変えられる
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+static const std::size_t blockedMax = 10000000; // これより大きいと逐次版は遅すぎるので測らない
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], 0, 10));
+    if (sizes.empty()) {
+        sizes.push_back(1000000);
+        sizes.push_back(10000000);
+    }
+    std::vector<unsigned> threads;
+    std::istringstream list(std::getenv("PMERGE_THREADS") ? std::getenv("PMERGE_THREADS")
+                                                          : "1 2 4 8 16");
+    for (unsigned t; list >> t;) threads.push_back(t);
+
+    XorShift rng;
+    PmergeMe<std::vector<int> > sorter;
+    for (std::size_t s = 0; s < sizes.size(); ++s) {
+        std::vector<int> input(sizes[s]);
+        for (std::size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<int>(rng.below(1000000000)) + 1;
+        double base = 0;
+        if (sizes[s] <= blockedMax) {
+            double t0 = nowSeconds();
+            sorter.mergeInsertionSortBlocked(input.begin(), input.end());
+            base = nowSeconds() - t0;
+            std::fprintf(stderr, "N=%-10zu blocked (sequential) %10.2f ms\n", input.size(), base * 1e3);
+        }
+        double one = 0;
+        for (std::size_t t = 0; t < threads.size(); ++t) {
+            double t0 = nowSeconds();
+            std::vector<uint32_t> idx = sorter.mergeInsertionSortParallel(input.begin(), input.end(),
+                                                                          threads[t]);
+            double elapsed = nowSeconds() - t0;
+            if (t == 0) one = elapsed;
+            bool ok = true;
+            for (std::size_t i = 1; i < idx.size() && ok; ++i) ok = input[idx[i - 1]] <= input[idx[i]];
+            std::fprintf(stderr, "N=%-10zu parallel threads=%-2u %10.2f ms  vs %u thread %.2fx",
+                         input.size(), threads[t], elapsed * 1e3, threads[0], one / elapsed);
+            if (base > 0) std::fprintf(stderr, "  vs blocked %.2fx", base / elapsed);
+            std::fprintf(stderr, " %s\n", ok ? "sorted" : "NOT SORTED");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,295 @@
+// ex02 の回帰追跡用ベンチ: 分布 x 大きさ x 実装 ごとに warmup のあと reps 回測り、
+// min / median / p90 / max を CSV (既定) か JSON で stdout に出す。進み具合は stderr
+// usage: ./suite_bench [--json] [--reps N] [--warmup N] [--threads N]
+//                      [--sizes 3000,30000,...] [--dists random,sorted,...] [--algos a,b,...]
+//   dists: random sorted reversed dups organ
+//   algos: plain_vector plain_deque values_vector values_deque parallel_vector
+//          std_sort std_stable_sort
+// 実装ごとに測る上限の大きさがある (plain は O(N^2) の移動、values は O(N * block))
+#include "PmergeMe.hpp"
+#include "../Timer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>     // sysconf
+
+namespace {
+
+struct Options {
+    bool json;
+    int reps;            // 0: 大きさから決める
+    int warmup;
+    unsigned threads;
+    std::vector<std::size_t> sizes;
+    std::vector<std::string> dists;
+    std::vector<std::string> algos;
+};
+
+struct Result {
+    std::string algo;
+    std::string dist;
+    std::size_t n;
+    int reps;
+    double minMs, medianMs, p90Ms, maxMs;
+};
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> out;
+    std::istringstream in(s);
+    for (std::string item; std::getline(in, item, ',');)
+        if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+// 値は 1 以上 (PmergeMe の入力は正の整数)
+bool makeInput(const std::string& dist, std::size_t n, std::vector<int>& out) {
+    XorShift rng(12345 + n);
+    out.resize(n);
+    if (dist == "random") {
+        for (std::size_t i = 0; i < n; ++i) out[i] = static_cast<int>(rng.below(1000000000)) + 1;
+    } else if (dist == "sorted") {
+        for (std::size_t i = 0; i < n; ++i) out[i] = static_cast<int>(i) + 1;
+    } else if (dist == "reversed") {
+        for (std::size_t i = 0; i < n; ++i) out[i] = static_cast<int>(n - i);
+    } else if (dist == "dups") { // 16 種類の値だけ
+        for (std::size_t i = 0; i < n; ++i) out[i] = static_cast<int>(rng.below(16)) + 1;
+    } else if (dist == "organ") { // 昇順のあと降順
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = static_cast<int>(i < n / 2 ? i : n - i) + 1;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::size_t maxSize(const std::string& algo) {
+    if (algo == "plain_vector" || algo == "plain_deque") return 100000;
+    if (algo == "values_vector" || algo == "values_deque") return 10000000;
+    return 100000000;
+}
+
+template <typename Container>
+bool sameAs(const Container& c, const std::vector<int>& want) {
+    return c.size() == want.size() && std::equal(want.begin(), want.end(), c.begin());
+}
+
+template <typename Container, typename Indices>
+Container gather(const Container& input, const Indices& idx) {
+    Container out;
+    for (std::size_t i = 0; i < idx.size(); ++i) out.push_back(input[idx[i]]);
+    return out;
+}
+
+// 時間を測るのは並べ替えの呼び出しだけ (入力のコピーと検証は外)
+class Runner {
+public:
+    Runner(const std::string& algo, const std::vector<int>& input, unsigned threads)
+        : algo_(algo), input_(input), threads_(threads) {}
+
+    // @return 秒。ok には結果が正しかったかを入れる
+    double once(const std::vector<int>& want, bool& ok) {
+        if (algo_ == "plain_vector") return plain<std::vector<int> >(want, ok);
+        if (algo_ == "plain_deque") return plain<std::deque<int> >(want, ok);
+        if (algo_ == "values_vector") return values<std::vector<int> >(want, ok);
+        if (algo_ == "values_deque") return values<std::deque<int> >(want, ok);
+        if (algo_ == "parallel_vector") {
+            std::vector<int> in(input_);
+            PmergeMe<std::vector<int> > sorter;
+            double t0 = nowSeconds();
+            std::vector<uint32_t> idx = sorter.mergeInsertionSortParallel(in.begin(), in.end(), threads_);
+            double t1 = nowSeconds();
+            ok = sameAs(gather(in, idx), want);
+            return t1 - t0;
+        }
+        std::vector<int> work(input_);
+        double t0 = nowSeconds();
+        if (algo_ == "std_sort")
+            std::sort(work.begin(), work.end());
+        else
+            std::stable_sort(work.begin(), work.end());
+        double t1 = nowSeconds();
+        ok = sameAs(work, want);
+        return t1 - t0;
+    }
+
+private:
+    template <typename Container>
+    double plain(const std::vector<int>& want, bool& ok) {
+        Container in(input_.begin(), input_.end());
+        PmergeMe<Container> sorter;
+        double t0 = nowSeconds();
+        typename PmergeMe<Container>::index_container idx =
+            sorter.mergeInsertionSort(in.begin(), in.end());
+        double t1 = nowSeconds();
+        ok = sameAs(gather(in, idx), want);
+        return t1 - t0;
+    }
+    template <typename Container>
+    double values(const std::vector<int>& want, bool& ok) {
+        Container work(input_.begin(), input_.end());
+        PmergeMe<Container> sorter;
+        double t0 = nowSeconds();
+        sorter.sortValues(work.begin(), work.end());
+        double t1 = nowSeconds();
+        ok = sameAs(work, want);
+        return t1 - t0;
+    }
+
+    std::string algo_;
+    const std::vector<int>& input_;
+    unsigned threads_;
+};
+
+bool isAlgo(const std::string& a) {
+    return a == "plain_vector" || a == "plain_deque" || a == "values_vector"
+        || a == "values_deque" || a == "parallel_vector" || a == "std_sort"
+        || a == "std_stable_sort";
+}
+
+int defaultReps(std::size_t n) {
+    if (n <= 100000) return 11;
+    if (n <= 1000000) return 5;
+    return 3;
+}
+
+// 並べた samples の q 分位 (最近傍順位)
+double quantile(const std::vector<double>& sorted, double q) {
+    std::size_t i = static_cast<std::size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+void printCsv(const std::vector<Result>& rs) {
+    std::printf("algo,dist,n,reps,min_ms,median_ms,p90_ms,max_ms,median_ns_per_elem\n");
+    for (std::size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        std::printf("%s,%s,%zu,%d,%.4f,%.4f,%.4f,%.4f,%.2f\n", r.algo.c_str(), r.dist.c_str(),
+                    r.n, r.reps, r.minMs, r.medianMs, r.p90Ms, r.maxMs,
+                    r.medianMs * 1e6 / static_cast<double>(r.n));
+    }
+}
+
+void printJson(const std::vector<Result>& rs) {
+    std::printf("[\n");
+    for (std::size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        std::printf("  {\"algo\": \"%s\", \"dist\": \"%s\", \"n\": %zu, \"reps\": %d, "
+                    "\"min_ms\": %.4f, \"median_ms\": %.4f, \"p90_ms\": %.4f, \"max_ms\": %.4f}%s\n",
+                    r.algo.c_str(), r.dist.c_str(), r.n, r.reps, r.minMs, r.medianMs, r.p90Ms,
+                    r.maxMs, i + 1 < rs.size() ? "," : "");
+    }
+    std::printf("]\n");
+}
+
+bool parseOptions(int argc, char** argv, Options& opt) {
+    opt.json = false;
+    opt.reps = 0;
+    opt.warmup = 1;
+    long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    opt.threads = cpus > 0 ? static_cast<unsigned>(cpus) : 1;
+    opt.sizes.push_back(3000);
+    opt.sizes.push_back(30000);
+    opt.sizes.push_back(300000);
+    opt.sizes.push_back(3000000);
+    opt.dists = splitList("random,sorted,reversed,dups,organ");
+    opt.algos = splitList("plain_vector,plain_deque,values_vector,values_deque,"
+                          "parallel_vector,std_sort,std_stable_sort");
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--json") {
+            opt.json = true;
+        } else if (arg == "--reps" && hasValue) {
+            opt.reps = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            opt.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (arg == "--sizes" && hasValue) {
+            std::vector<std::string> list = splitList(argv[++i]);
+            opt.sizes.clear();
+            for (std::size_t k = 0; k < list.size(); ++k)
+                opt.sizes.push_back(std::strtoul(list[k].c_str(), 0, 10));
+        } else if (arg == "--dists" && hasValue) {
+            opt.dists = splitList(argv[++i]);
+        } else if (arg == "--algos" && hasValue) {
+            opt.algos = splitList(argv[++i]);
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    for (std::size_t k = 0; k < opt.algos.size(); ++k) {
+        if (!isAlgo(opt.algos[k])) {
+            std::fprintf(stderr, "unknown algo: %s\n", opt.algos[k].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) return 2;
+    std::vector<Result> results;
+    bool allOk = true;
+    for (std::size_t d = 0; d < opt.dists.size(); ++d) {
+        for (std::size_t s = 0; s < opt.sizes.size(); ++s) {
+            std::vector<int> input;
+            if (!makeInput(opt.dists[d], opt.sizes[s], input)) {
+                std::fprintf(stderr, "unknown dist: %s\n", opt.dists[d].c_str());
+                return 2;
+            }
+            std::vector<int> want(input);
+            std::sort(want.begin(), want.end());
+            for (std::size_t a = 0; a < opt.algos.size(); ++a) {
+                const std::string& algo = opt.algos[a];
+                if (opt.sizes[s] > maxSize(algo)) {
+                    std::fprintf(stderr, "skip %s %s n=%zu (above %zu)\n", algo.c_str(),
+                                 opt.dists[d].c_str(), opt.sizes[s], maxSize(algo));
+                    continue;
+                }
+                Runner runner(algo, input, opt.threads);
+                const int reps = opt.reps > 0 ? opt.reps : defaultReps(opt.sizes[s]);
+                bool ok = true;
+                for (int w = 0; w < opt.warmup; ++w) {
+                    bool good = false;
+                    runner.once(want, good);
+                    ok = ok && good;
+                }
+                std::vector<double> samples;
+                for (int r = 0; r < reps; ++r) {
+                    bool good = false;
+                    samples.push_back(runner.once(want, good) * 1e3);
+                    ok = ok && good;
+                }
+                std::sort(samples.begin(), samples.end());
+                Result res;
+                res.algo = algo;
+                res.dist = opt.dists[d];
+                res.n = opt.sizes[s];
+                res.reps = reps;
+                res.minMs = samples.front();
+                res.medianMs = quantile(samples, 0.5);
+                res.p90Ms = quantile(samples, 0.9);
+                res.maxMs = samples.back();
+                results.push_back(res);
+                std::fprintf(stderr, "%-16s %-8s n=%-9zu median %10.3f ms %s\n", algo.c_str(),
+                             opt.dists[d].c_str(), opt.sizes[s], res.medianMs,
+                             ok ? "" : "WRONG RESULT");
+                allOk = allOk && ok;
+            }
+        }
+    }
+    if (opt.json)
+        printJson(results);
+    else
+        printCsv(results);
+    return allOk ? 0 : 1;
+}
@@ -1,15 +1,30 @@
 #include "BitcoinExchange.hpp"
 #include "Utils.hpp"
+#include <cstring>  // memchr, memcmp, memcpy, memmove
+#include <fstream>
+#include <vector>
+#include <fcntl.h>    // open
+#include <pthread.h>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close, sysconf
 
-BitcoinExchange::BitcoinExchange(std::istream& dbCsv) {
+const std::size_t BitcoinExchange::kDefaultChunkBytes;
+
+BitcoinExchange::BitcoinExchange(std::istream& dbCsv, RateTable::Backend backend)
+    : table_(backend) {
     table_.load(dbCsv);
 }
 
+BitcoinExchange::BitcoinExchange(const std::string& dbPath, RateTable::Backend backend)
+    : table_(backend) {
+    table_.loadCached(dbPath);
+}
+
 BitcoinExchange::~BitcoinExchange() {}
 
-BitcoinExchange::BitcoinExchange(const BitcoinExchange& src) {
-    this->table_ = src.table_;
-}
+BitcoinExchange::BitcoinExchange(const BitcoinExchange& src)
+    : table_(src.table_) {}
 
 BitcoinExchange& BitcoinExchange::operator=(const BitcoinExchange& src){
     if (this != &src) {
@@ -19,7 +34,10 @@ BitcoinExchange& BitcoinExchange::operator=(const BitcoinExchange& src){
 }
 
 bool BitcoinExchange::parseDouble(const std::string& sval, double& out) {
-    const char* c = sval.c_str();
+    return parseDouble(sval.data(), sval.data() + sval.size(), out);
+}
+
+bool BitcoinExchange::parseDouble(const char* c, double& out) {
     char* endp = 0;
     out = std::strtod(c, &endp);
     if (endp == c) return false; // 1文字も読めていない
@@ -35,20 +53,10 @@ bool BitcoinExchange::isHeaderLine(std::string s) {
     return trim(s) == "date | value";
 }
 
-static bool isLeap(int y){ return (y%4==0 && y%100!=0) || (y%400==0); }
-
 // YYYY-MM-DD format check
 bool BitcoinExchange::isValidDate(const std::string& date) {
-    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
-    int y, m, day;  // y -> year, m -> month, day -> day
-
-    if (!BitcoinExchange::checkYMD(date)) return false;
-    BitcoinExchange::splitYMD(date, y, m, day);
-    if (m < 1 || m > 12) return false;
-    int maxd = mdays[m-1];
-    if (m==2 && isLeap(y)) maxd = 29;
-    if (day < 1 || day > maxd) return false;
-    return true;
+    uint32_t day;
+    return parseDayNumber(date.data(), date.size(), day);
 }
 
 bool BitcoinExchange::isValidValue(double value) {
@@ -58,30 +66,6 @@ bool BitcoinExchange::isValidValue(double value) {
     return true;
 }
 
-bool BitcoinExchange::checkYMD(const std::string& date) {
-    if (date.size() != DATE_TOTAL_LEN) return false;
-
-    for (std::size_t i = 0; i < date.size(); i++) {
-        if (i == DATE_YEAR_END || i == DATE_MONTH_END) {
-            if (date[i] != '-') return false;
-        } else {
-            if (!std::isdigit(date[i])) return false;
-        }
-    }
-    return true;
-}
-
-bool BitcoinExchange::splitYMD(
-      const std::string& date,
-      int& y,
-      int& m,
-      int& day) {
-    y = std::atoi(date.substr(0, DATE_YEAR_END).c_str());
-    m = std::atoi(date.substr(DATE_YEAR_END + 1, DATE_MONTH_END - DATE_YEAR_END - 1).c_str());
-    day = std::atoi(date.substr(DATE_MONTH_END + 1, DATE_TOTAL_LEN - DATE_MONTH_END - 1).c_str());
-    return true;
-}
-
 void BitcoinExchange::run(std::istream& input, std::ostream& out, std::ostream& err)
 {
     std::string line;
@@ -116,4 +100,271 @@ void BitcoinExchange::run(std::istream& input, std::ostream& out, std::ostream&
             printError(err, e.what());
         }
     }
-}
\ No newline at end of file
+}
+// ========= runStream =========
+
+// parseDouble の範囲版。普通の 10 進数は parseDecimalFast で読み、それ以外は
+// strtod 用に NUL 終端のコピーを作る (通常はスタック上)
+bool BitcoinExchange::parseDouble(const char* b, const char* e, double& out) {
+    if (parseDecimalFast(b, e, out)) return true;
+    char buf[64];
+    const std::size_t len = e - b;
+    if (len < sizeof(buf)) {
+        std::memcpy(buf, b, len);
+        buf[len] = '\0';
+        return parseDouble(buf, out);
+    }
+    const std::string big(b, len);
+    return parseDouble(big.c_str(), out);
+}
+
+BitcoinExchange::LineStatus BitcoinExchange::parseLine(
+        const char* b, const char* e, bool& header_checked, ParsedLine& pl) const {
+    static const char header[] = "date | value";
+    if (b == e) return LINE_SKIP;
+    if (!header_checked) {
+        header_checked = true;
+        const char* tb = b;
+        const char* te = e;
+        trimRange(tb, te);
+        if (static_cast<std::size_t>(te - tb) == sizeof(header) - 1
+            && std::memcmp(tb, header, sizeof(header) - 1) == 0)
+            return LINE_SKIP;
+    }
+    pl.lineB = b;
+    pl.lineE = e;
+    const char* bar = static_cast<const char*>(std::memchr(b, '|', e - b));
+    if (bar == 0) return LINE_NO_BAR;
+    pl.dateB = b;
+    pl.dateE = bar;
+    trimRange(pl.dateB, pl.dateE);
+    pl.valB = bar + 1;
+    pl.valE = e;
+    trimRange(pl.valB, pl.valE);
+
+    if (!parseDayNumber(pl.dateB, pl.dateE - pl.dateB, pl.day)) return LINE_BAD_DATE;
+    if (!parseDouble(pl.valB, pl.valE, pl.value)) return LINE_BAD_VALUE;
+    if (pl.value < 0.0) return LINE_NEGATIVE;
+    if (pl.value > 1000.0) return LINE_TOO_LARGE;
+    return LINE_OK; // rate は flushBatch で引く (見つからなければ LINE_NO_RATE)
+}
+
+// ostream の既定 (precision 6, %g 相当) と同じ書式
+static void appendDouble(OrderedOutput& sink, bool toErr, double v) {
+    char buf[32];
+    int n = formatDoubleG(v, buf);
+    sink.append(toErr, buf, n);
+}
+
+void BitcoinExchange::formatLine(const ParsedLine& pl, OrderedOutput& sink) {
+    static const char badInput[] = "Error: bad input => ";
+    switch (pl.status) {
+        case LINE_SKIP:
+            return;
+        case LINE_OK:
+            sink.append(false, pl.dateB, pl.dateE - pl.dateB);
+            sink.append(false, " => ", 4);
+            appendDouble(sink, false, pl.value);
+            sink.append(false, " = ", 3);
+            appendDouble(sink, false, pl.value * pl.rate);
+            sink.append(false, "\n", 1);
+            return;
+        case LINE_NEGATIVE:
+            sink.append(true, "Error: not a positive number.\n", 30);
+            return;
+        case LINE_TOO_LARGE:
+            sink.append(true, "Error: too large a number.\n", 27);
+            return;
+        case LINE_BAD_DATE:
+            sink.append(true, badInput, sizeof(badInput) - 1);
+            sink.append(true, pl.dateB, pl.dateE - pl.dateB);
+            break;
+        case LINE_BAD_VALUE:
+            sink.append(true, badInput, sizeof(badInput) - 1);
+            sink.append(true, pl.valB, pl.valE - pl.valB);
+            break;
+        case LINE_NO_BAR:
+        case LINE_NO_RATE:
+            sink.append(true, badInput, sizeof(badInput) - 1);
+            sink.append(true, pl.lineB, pl.lineE - pl.lineB);
+            break;
+    }
+    sink.append(true, "\n", 1);
+}
+
+// 1 行を解析して batch に積む。行のポインタは flushBatch まで有効であること
+void BitcoinExchange::addLine(LineBatch& batch, const char* b, const char* e,
+                              bool& header_checked, OrderedOutput& sink) const {
+    ParsedLine& pl = batch.lines[batch.n];
+    pl.status = parseLine(b, e, header_checked, pl);
+    if (pl.status == LINE_SKIP) return;
+    if (++batch.n == kBatchLines)
+        flushBatch(batch, sink);
+}
+
+// batch 内の LINE_OK の行のレートを 1 回の getRatesForDays で引いてから書式化する
+void BitcoinExchange::flushBatch(LineBatch& batch, OrderedOutput& sink) const {
+    std::size_t nq = 0;
+    for (std::size_t i = 0; i < batch.n; ++i) {
+        if (batch.lines[i].status == LINE_OK)
+            batch.days[nq++] = batch.lines[i].day;
+    }
+    table_.getRatesForDays(batch.days, nq, batch.rates, batch.found);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < batch.n; ++i) {
+        ParsedLine& pl = batch.lines[i];
+        if (pl.status == LINE_OK) {
+            if (batch.found[k]) pl.rate = batch.rates[k];
+            else pl.status = LINE_NO_RATE;
+            ++k;
+        }
+        formatLine(pl, sink);
+    }
+    batch.n = 0;
+}
+
+// [p, end) の行を順に処理して sink に書く。最後の行は '\n' がなくてもよい
+void BitcoinExchange::processRange(const char* p, const char* end, bool& header_checked,
+                                   OrderedOutput& sink) const {
+    LineBatch batch;
+    batch.n = 0;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        addLine(batch, p, eol, header_checked, sink);
+        p = nl ? nl + 1 : end;
+    }
+    flushBatch(batch, sink);
+}
+
+void BitcoinExchange::runStream(std::istream& input, std::ostream& out,
+                                std::ostream& err) const {
+    static const std::size_t kBlock = 1u << 20;
+    static const std::size_t kFlushAt = 1u << 16;
+    std::vector<char> buf(kBlock);
+    std::size_t have = 0; // buf[0, have) は前ブロックからの途中の行
+    bool header_checked = false;
+    bool eof = false;
+    OrderedOutput sink;
+    LineBatch batch;
+    batch.n = 0;
+
+    while (!eof) {
+        if (have == buf.size()) // 1 行がブロックより長い
+            buf.resize(buf.size() * 2);
+        input.read(&buf[have], buf.size() - have);
+        const std::size_t got = static_cast<std::size_t>(input.gcount());
+        eof = got == 0 || !input;
+        const char* p = &buf[0];
+        const char* end = p + have + got;
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (nl == 0 && !eof) break; // 行の続きは次のブロックで
+            const char* eol = nl ? nl : end;
+            addLine(batch, p, eol, header_checked, sink);
+            p = nl ? nl + 1 : end;
+            if (sink.size() >= kFlushAt)
+                sink.flushTo(out, err);
+        }
+        flushBatch(batch, sink); // 次の memmove で行のポインタが無効になる
+        have = end - p;
+        if (have > 0)
+            std::memmove(&buf[0], p, have);
+    }
+    sink.flushTo(out, err);
+}
+
+// ========= runParallel =========
+
+void* BitcoinExchange::chunkWorker(void* arg) {
+    ChunkJob* job = static_cast<ChunkJob*>(arg);
+    job->self->processRange(job->begin, job->end, job->header_checked, job->sink);
+    return 0;
+}
+
+// from + want 以降で最初の行末の直後 (なければ end) を返す
+static const char* chunkEnd(const char* from, const char* end, std::size_t want) {
+    if (static_cast<std::size_t>(end - from) <= want) return end;
+    const char* target = from + want - 1;
+    const char* nl = static_cast<const char*>(std::memchr(target, '\n', end - target));
+    return nl ? nl + 1 : end;
+}
+
+void BitcoinExchange::runParallel(const std::string& inputPath, std::ostream& out,
+                                  std::ostream& err, unsigned threads,
+                                  std::size_t chunkBytes) const {
+    int fd = ::open(inputPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + inputPath);
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        throw std::runtime_error("could not open " + inputPath);
+    }
+    if (!S_ISREG(st.st_mode)) { // pipe などは mmap できないので逐次処理
+        ::close(fd);
+        std::ifstream in(inputPath.c_str());
+        runStream(in, out, err);
+        return;
+    }
+    const std::size_t len = static_cast<std::size_t>(st.st_size);
+    if (len == 0) {
+        ::close(fd);
+        return;
+    }
+    void* map = ::mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // mapping stays valid
+    if (map == MAP_FAILED)
+        throw std::runtime_error("could not map " + inputPath);
+    ::madvise(map, len, MADV_SEQUENTIAL);
+
+    if (threads == 0) threads = 1;
+    if (chunkBytes == 0) chunkBytes = 1;
+    const char* base = static_cast<const char*>(map);
+    const char* end = base + len;
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    // ヘッダ判定は最初の空でない行だけなので、そこまでは必ず最初のチャンクに入れる
+    const char* firstLine = base;
+    while (firstLine < end && *firstLine == '\n') ++firstLine;
+    const std::size_t headerSpan = chunkEnd(firstLine, end, 1) - base;
+
+    // threads 個のチャンクを 1 ウィンドウとして並列に処理し、順番通りに書き出す
+    std::vector<ChunkJob> jobs(threads);
+    std::vector<pthread_t> tids(threads);
+    const char* p = base;
+    std::size_t released = 0;
+    bool first = true;
+    while (p < end) {
+        std::size_t n = 0;
+        for (; n < threads && p < end; ++n) {
+            ChunkJob& job = jobs[n];
+            job.self = this;
+            job.begin = p;
+            job.end = chunkEnd(p, end, first && headerSpan > chunkBytes ? headerSpan : chunkBytes);
+            job.header_checked = !first;
+            first = false;
+            p = job.end;
+        }
+        std::size_t started = 1;
+        for (; started < n; ++started) {
+            if (::pthread_create(&tids[started], 0, chunkWorker, &jobs[started]) != 0)
+                break;
+        }
+        chunkWorker(&jobs[0]);
+        for (std::size_t i = started; i < n; ++i) // スレッドを作れなかった分はここで処理
+            chunkWorker(&jobs[i]);
+        for (std::size_t i = 1; i < started; ++i)
+            ::pthread_join(tids[i], 0);
+        for (std::size_t i = 0; i < n; ++i)
+            jobs[i].sink.flushTo(out, err);
+
+        // 処理済みのページは手放し、peak RSS を入力サイズに比例させない
+        const std::size_t done = (static_cast<std::size_t>(p - base) / page) * page;
+        if (done > released) {
+            ::madvise(const_cast<char*>(base) + released, done - released, MADV_DONTNEED);
+            released = done;
+        }
+    }
+    ::munmap(map, len);
+}
@@ -10,15 +10,52 @@
 #include <cstdlib>    // strtod
 #include <iomanip>
 #include "RateTable.hpp"
+#include "OrderedOutput.hpp"
 
 // input.txtの解析と検証も含む
 class BitcoinExchange {
 public:
-    explicit BitcoinExchange(std::istream& dbCsv);
+    explicit BitcoinExchange(std::istream& dbCsv,
+                             RateTable::Backend backend = RateTable::MAP);
+    // data.csv を mmap で読み込む版 (新しい data.csv.snap があればそちらを使う)。
+    // snapshot を使っても結果が変わらないよう既定は FLAT
+    explicit BitcoinExchange(const std::string& dbPath,
+                             RateTable::Backend backend = RateTable::FLAT);
     BitcoinExchange(const BitcoinExchange&);
     BitcoinExchange& operator=(const BitcoinExchange& src);
     ~BitcoinExchange();
     void run(std::istream& input, std::ostream& out, std::ostream& err);
+    /**
+      * Streaming version of run() with byte-identical output.
+      * Reads input in large blocks, scans lines with pointers, reports
+      * errors through LineStatus instead of exceptions and formats into a
+      * reused buffer, so the steady state does no per-line allocation.
+      * Target: >= 2.5M lines/s with the FLAT backend and 10% bad lines,
+      * about 4x run() (measured with run_bench, see make bench).
+    */
+    void runStream(std::istream& input, std::ostream& out, std::ostream& err) const;
+    /**
+      * Parallel version of runStream() for large input files.
+      * Maps the file, splits it into newline-aligned chunks and lets
+      * `threads` workers format them against the shared read-only table.
+      * Chunk outputs are written back in input order with the same
+      * stdout/stderr interleaving as run(). The header line is only
+      * recognised at the start of the file, as in run().
+      * Non-regular files (pipes, ttys) fall back to runStream().
+      * @throws std::runtime_error if the file cannot be opened or mapped.
+    */
+    void runParallel(const std::string& inputPath, std::ostream& out, std::ostream& err,
+                     unsigned threads, std::size_t chunkBytes = kDefaultChunkBytes) const;
+
+    static const std::size_t kDefaultChunkBytes = 4u << 20;
+    /**
+      * Formats the lines in [p, end) into sink exactly like runStream()
+      * (the last line needs no '\n'). Used by runParallel and QueryServer.
+      * @param header_checked false while the header line may still appear;
+      *        updated for the next call on the same stream
+    */
+    void processRange(const char* p, const char* end, bool& header_checked,
+                      OrderedOutput& sink) const;
 
     static bool isValidDate(const std::string& date);
     static bool isValidValue(double v);
@@ -26,19 +63,64 @@ public:
 
 private:
     /**
-      * C++98 には std::stod がないので、strtodを使ってパース
+      * C++98 には std::stod がないので、parseDecimalFast か strtod でパース
       * @param s 入力文字列
       * @param out 変換結果の出力先
       * @return 変換成功なら true、失敗なら false
     */
     static bool parseDouble(const std::string& sval, double& out);
 
-    static bool checkYMD(const std::string& date);
-    static bool splitYMD(
-      const std::string& date,
-      int& y,
-      int& m,
-      int& day);
+    // runStream 用: 1 行の解析結果 (例外の代わりに戻り値で返す)
+    enum LineStatus {
+        LINE_SKIP,       // empty line or header
+        LINE_OK,
+        LINE_NO_BAR,     // "bad input => <line>"
+        LINE_BAD_DATE,   // "bad input => <date>"
+        LINE_BAD_VALUE,  // "bad input => <value>"
+        LINE_NEGATIVE,   // "not a positive number."
+        LINE_TOO_LARGE,  // "too large a number."
+        LINE_NO_RATE     // "bad input => <line>"
+    };
+    struct ParsedLine {
+        const char* lineB;
+        const char* lineE;
+        const char* dateB;
+        const char* dateE;
+        const char* valB;
+        const char* valE;
+        LineStatus status;
+        uint32_t day;
+        double value;
+        double rate;
+    };
+    // レートの検索は RateTable::getRatesForDays でまとめて行う
+    static const std::size_t kBatchLines = 256;
+    struct LineBatch {
+        std::size_t n;
+        ParsedLine lines[kBatchLines];
+        uint32_t days[kBatchLines];
+        double rates[kBatchLines];
+        bool found[kBatchLines];
+    };
+    LineStatus parseLine(const char* b, const char* e, bool& header_checked,
+                         ParsedLine& pl) const;
+    static void formatLine(const ParsedLine& pl, OrderedOutput& sink);
+    void addLine(LineBatch& batch, const char* b, const char* e, bool& header_checked,
+                 OrderedOutput& sink) const;
+    void flushBatch(LineBatch& batch, OrderedOutput& sink) const;
+    static bool parseDouble(const char* c, double& out);
+
+    // runParallel 用: 1 チャンク分の仕事と出力先 (ワーカーごとに 1 つ)
+    struct ChunkJob {
+        const BitcoinExchange* self;
+        const char* begin;
+        const char* end;
+        bool header_checked;
+        OrderedOutput sink;
+    };
+    static void* chunkWorker(void* arg);
+    static bool parseDouble(const char* b, const char* e, double& out);
+
 private:
     RateTable table_;
 };
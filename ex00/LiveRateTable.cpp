@@ -0,0 +1,256 @@
+#include "LiveRateTable.hpp"
+#include <cstring>    // memchr, memset
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>    // open
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // pread, close
+
+const std::size_t LiveRateTable::kMaxReaders;
+
+namespace {
+// 例外で抜けても writeLock_ を必ず解放する
+class WriteGuard {
+public:
+    explicit WriteGuard(pthread_mutex_t& m) : m_(m) { ::pthread_mutex_lock(&m_); }
+    ~WriteGuard() { ::pthread_mutex_unlock(&m_); }
+private:
+    WriteGuard(const WriteGuard&);
+    WriteGuard& operator=(const WriteGuard&);
+    pthread_mutex_t& m_;
+};
+
+// 例外で抜けても fd を必ず閉じる
+class FdCloser {
+public:
+    explicit FdCloser(int fd) : fd_(fd) {}
+    ~FdCloser() { ::close(fd_); }
+private:
+    FdCloser(const FdCloser&);
+    FdCloser& operator=(const FdCloser&);
+    int fd_;
+};
+}
+
+LiveRateTable::LiveRateTable(RateTable::Backend backend)
+    : backend_(backend), current_(0), generation_(0), consumed_(0) {
+    std::memset(slots_, 0, sizeof(slots_));
+    std::memset(&seen_, 0, sizeof(seen_));
+    ::pthread_mutex_init(&writeLock_, 0);
+}
+
+LiveRateTable::~LiveRateTable() {
+    delete current_;
+    for (std::size_t i = 0; i < retired_.size(); ++i)
+        delete retired_[i];
+    ::pthread_mutex_destroy(&writeLock_);
+}
+
+unsigned long LiveRateTable::generation() const {
+    return __atomic_load_n(&generation_, __ATOMIC_ACQUIRE);
+}
+
+// ---- writers ----
+
+// next を公開し、古い snapshot は retired_ に回す (writeLock_ を持って呼ぶこと)
+void LiveRateTable::publish(RateTable* next) {
+    RateTable* old = __atomic_exchange_n(&current_, next, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&generation_, 1, __ATOMIC_RELEASE);
+    if (old)
+        retired_.push_back(old);
+    reclaim();
+}
+
+// どの Reader の hazard slot にも載っていない retired snapshot を解放する
+void LiveRateTable::reclaim() {
+    std::size_t keep = 0;
+    for (std::size_t i = 0; i < retired_.size(); ++i) {
+        bool inUse = false;
+        for (std::size_t s = 0; s < kMaxReaders && !inUse; ++s)
+            inUse = __atomic_load_n(&slots_[s].hazard, __ATOMIC_SEQ_CST) == retired_[i];
+        if (inUse)
+            retired_[keep++] = retired_[i];
+        else
+            delete retired_[i];
+    }
+    retired_.resize(keep);
+}
+
+void LiveRateTable::reload(std::istream& in) {
+    RateTable* next = new RateTable(backend_);
+    try {
+        next->load(in);
+    } catch (...) {
+        delete next;
+        throw;
+    }
+    WriteGuard guard(writeLock_);
+    publish(next);
+}
+
+void LiveRateTable::extend(std::istream& in) {
+    WriteGuard guard(writeLock_);
+    // current_ を書き換えるのは writeLock_ を持つ writer だけなので、ここでは普通に読める
+    RateTable* next = current_ ? new RateTable(*current_) : new RateTable(backend_);
+    try {
+        next->extend(in);
+    } catch (...) {
+        delete next;
+        throw;
+    }
+    publish(next);
+}
+
+void LiveRateTable::reload(const std::string& csvPath) {
+    int fd = ::open(csvPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + csvPath);
+    FdCloser closer(fd);
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+        throw std::runtime_error("could not open " + csvPath);
+    WriteGuard guard(writeLock_);
+    reloadLocked(fd, st, csvPath);
+}
+
+// st は fd の fstat。読んだ位置と st を同じ writeLock_ の中で記録する (writeLock_ を持って呼ぶこと)
+void LiveRateTable::reloadLocked(int fd, const struct stat& st, const std::string& csvPath) {
+    RateTable* next = new RateTable(backend_);
+    std::size_t used;
+    try {
+        used = next->loadCompleteLines(fd, static_cast<std::size_t>(st.st_size), csvPath);
+    } catch (...) {
+        delete next;
+        throw;
+    }
+    consumed_ = static_cast<off_t>(used);
+    seen_ = st;
+    publish(next);
+}
+
+// 別のファイルに置き換えられた、縮んだ、または同じサイズのまま書き直された
+bool LiveRateTable::rewritten(const struct stat& st) const {
+    if (st.st_dev != seen_.st_dev || st.st_ino != seen_.st_ino)
+        return true;
+    if (st.st_size < consumed_)
+        return true;
+    return st.st_size == seen_.st_size
+        && (st.st_mtim.tv_sec != seen_.st_mtim.tv_sec
+            || st.st_mtim.tv_nsec != seen_.st_mtim.tv_nsec);
+}
+
+bool LiveRateTable::refresh(const std::string& csvPath) {
+    int fd = ::open(csvPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + csvPath);
+    FdCloser closer(fd);
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+        throw std::runtime_error("could not open " + csvPath);
+
+    // 判断から consumed_ の更新まで 1 回のロックで行い、並行する refresh が食い違わないようにする
+    WriteGuard guard(writeLock_);
+    if (!current_ || rewritten(st)) {
+        reloadLocked(fd, st, csvPath);
+        return true;
+    }
+    seen_ = st;
+    if (st.st_size == consumed_)
+        return false;
+    // 追記された部分のうち、最後の '\n' までだけを読む
+    std::string tail(static_cast<std::size_t>(st.st_size - consumed_), '\0');
+    const ssize_t got = ::pread(fd, &tail[0], tail.size(), consumed_);
+    if (got < 0)
+        throw std::runtime_error("could not read " + csvPath);
+    tail.resize(static_cast<std::size_t>(got));
+    const std::string::size_type nl = tail.rfind('\n');
+    if (nl == std::string::npos)
+        return false;
+    tail.resize(nl + 1);
+    std::istringstream in(tail);
+    RateTable* next = new RateTable(*current_);
+    try {
+        next->extend(in);
+    } catch (...) {
+        delete next;
+        throw;
+    }
+    consumed_ += static_cast<off_t>(tail.size());
+    publish(next);
+    return true;
+}
+
+// ---- readers ----
+
+LiveRateTable::Reader::Reader(const LiveRateTable& table) : table_(table), slot_(kMaxReaders) {
+    for (std::size_t i = 0; i < kMaxReaders; ++i) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&table_.slots_[i].used, &expected, 1, false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            slot_ = i;
+            return;
+        }
+    }
+    throw std::runtime_error("too many readers.");
+}
+
+LiveRateTable::Reader::~Reader() {
+    __atomic_store_n(&table_.slots_[slot_].hazard, static_cast<const RateTable*>(0),
+                     __ATOMIC_RELEASE);
+    __atomic_store_n(&table_.slots_[slot_].used, 0, __ATOMIC_RELEASE);
+}
+
+/**
+  * Announces the current snapshot in our hazard slot and re-checks that it
+  * is still current, so a writer that swaps it out afterwards will see the
+  * slot and not free it. Lock-free: retries only if a writer published
+  * in between.
+*/
+const RateTable* LiveRateTable::Reader::pin() const {
+    const RateTable* p = __atomic_load_n(&table_.current_, __ATOMIC_ACQUIRE);
+    for (;;) {
+        __atomic_store_n(&table_.slots_[slot_].hazard, p, __ATOMIC_SEQ_CST);
+        const RateTable* again = __atomic_load_n(&table_.current_, __ATOMIC_SEQ_CST);
+        if (again == p) return p;
+        p = again;
+    }
+}
+
+void LiveRateTable::Reader::unpin() const {
+    __atomic_store_n(&table_.slots_[slot_].hazard, static_cast<const RateTable*>(0),
+                     __ATOMIC_RELEASE);
+}
+
+bool LiveRateTable::Reader::getRateForDate(const std::string& date, double& out) const {
+    const RateTable* t = pin();
+    const bool found = t && t->getRateForDate(date, out);
+    unpin();
+    return found;
+}
+
+bool LiveRateTable::Reader::getRateForDay(uint32_t day, double& out) const {
+    const RateTable* t = pin();
+    const bool found = t && t->getRateForDay(day, out);
+    unpin();
+    return found;
+}
+
+std::size_t LiveRateTable::Reader::getRatesForDays(const uint32_t* days, std::size_t n,
+                                                   double* out, bool* found) const {
+    const RateTable* t = pin();
+    std::size_t hits = 0;
+    if (t) {
+        hits = t->getRatesForDays(days, n, out, found);
+    } else {
+        for (std::size_t i = 0; i < n; ++i) found[i] = false;
+    }
+    unpin();
+    return hits;
+}
+
+std::size_t LiveRateTable::Reader::size() const {
+    const RateTable* t = pin();
+    const std::size_t n = t ? t->size() : 0;
+    unpin();
+    return n;
+}
@@ -0,0 +1,105 @@
+#ifndef LIVERATETABLE_HPP
+#define LIVERATETABLE_HPP
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstddef>
+#include <stdint.h>   // uint32_t
+#include <sys/types.h> // off_t
+#include <sys/stat.h>  // struct stat
+#include <pthread.h>
+#include "RateTable.hpp"
+
+/**
+  * RateTable that can be reloaded or extended while other threads read it.
+  * Every reload builds a new immutable RateTable and publishes it with one
+  * atomic pointer store (RCU style). Readers go through a Reader, which
+  * announces the snapshot it uses in a hazard-pointer slot, so a lookup
+  * never takes a lock or waits for a writer. A replaced snapshot is freed
+  * by a later writer once no slot points at it any more.
+  * Writers (reload/extend/refresh) are serialised by a mutex.
+*/
+class LiveRateTable {
+public:
+    /** Maximum number of Readers alive at the same time. */
+    static const std::size_t kMaxReaders = 64;
+
+    explicit LiveRateTable(RateTable::Backend backend = RateTable::FLAT);
+    /** All Readers must be gone before the table is destroyed. */
+    ~LiveRateTable();
+
+    /** Builds a new snapshot from `in` and publishes it. */
+    void reload(std::istream& in);
+    /** Publishes a copy of the current snapshot with the rows of `in` added. */
+    void extend(std::istream& in);
+    /**
+      * Loads the complete lines of csvPath and publishes them.
+      * Remembers where they end, and which file they came from, so refresh()
+      * only reads what is appended later.
+    */
+    void reload(const std::string& csvPath);
+    /**
+      * Picks up rows appended to csvPath since the last reload()/refresh().
+      * Only complete lines are read; a partial last line waits for the next
+      * call. If the file was replaced (other inode/device), shrank, or was
+      * rewritten in place with the same size (mtime changed), it is reloaded.
+      * @return true if a new snapshot was published
+      * @throws std::runtime_error if the file cannot be read
+    */
+    bool refresh(const std::string& csvPath);
+    /** @return number of snapshots published so far */
+    unsigned long generation() const;
+
+    /**
+      * Per-thread read handle holding one hazard slot.
+      * A Reader must only be used by one thread at a time.
+    */
+    class Reader {
+    public:
+        /** @throws std::runtime_error if kMaxReaders Readers are alive */
+        explicit Reader(const LiveRateTable& table);
+        ~Reader();
+        bool getRateForDate(const std::string& date, double& out) const;
+        bool getRateForDay(uint32_t day, double& out) const;
+        /** Looks the whole batch up in one snapshot. */
+        std::size_t getRatesForDays(const uint32_t* days, std::size_t n,
+                                    double* out, bool* found) const;
+        /** @return number of distinct dates in the current snapshot */
+        std::size_t size() const;
+    private:
+        Reader(const Reader&);
+        Reader& operator=(const Reader&);
+        const RateTable* pin() const;
+        void unpin() const;
+
+        const LiveRateTable& table_;
+        std::size_t slot_;
+    };
+
+private:
+    LiveRateTable(const LiveRateTable&);
+    LiveRateTable& operator=(const LiveRateTable&);
+
+    void publish(RateTable* next);
+    void reloadLocked(int fd, const struct stat& st, const std::string& csvPath);
+    bool rewritten(const struct stat& st) const;
+    void reclaim();
+
+    // 1 slot = 1 cache line (Reader 同士の false sharing を避ける)
+    struct Slot {
+        const RateTable* hazard;
+        int used;
+        char pad[64 - sizeof(const RateTable*) - sizeof(int)];
+    };
+
+    RateTable::Backend backend_;
+    RateTable* current_;                 // published snapshot (atomic)
+    unsigned long generation_;           // atomic
+    mutable Slot slots_[kMaxReaders];
+    pthread_mutex_t writeLock_;
+    std::vector<RateTable*> retired_;    // replaced, maybe still read
+    off_t consumed_;                     // bytes of the CSV already loaded
+    struct stat seen_;                   // fstat of the CSV at the last reload/refresh
+};
+
+#endif // LIVERATETABLE_HPP
@@ -0,0 +1,45 @@
+#include "OrderedOutput.hpp"
+
+OrderedOutput::OrderedOutput() {}
+OrderedOutput::~OrderedOutput() {}
+OrderedOutput::OrderedOutput(const OrderedOutput& src)
+    : data_(src.data_), segs_(src.segs_) {}
+OrderedOutput& OrderedOutput::operator=(const OrderedOutput& src) {
+    if (this != &src) {
+        this->data_ = src.data_;
+        this->segs_ = src.segs_;
+    }
+    return *this;
+}
+
+void OrderedOutput::append(bool toErr, const char* p, std::size_t n) {
+    data_.append(p, n);
+    if (!segs_.empty() && segs_.back().second == toErr)
+        segs_.back().first = data_.size();
+    else
+        segs_.push_back(std::make_pair(data_.size(), toErr));
+}
+
+void OrderedOutput::append(bool toErr, const std::string& s) {
+    append(toErr, s.data(), s.size());
+}
+
+void OrderedOutput::flushTo(std::ostream& out, std::ostream& err) {
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i < segs_.size(); ++i) {
+        std::ostream& os = segs_[i].second ? err : out;
+        os.write(data_.data() + begin, segs_[i].first - begin);
+        begin = segs_[i].first;
+    }
+    clear();
+}
+
+// capacity は残して次のブロックで再利用する
+void OrderedOutput::clear() {
+    data_.clear();
+    segs_.clear();
+}
+
+std::size_t OrderedOutput::size() const { return data_.size(); }
+
+const char* OrderedOutput::data() const { return data_.data(); }
@@ -0,0 +1,31 @@
+#ifndef ORDEREDOUTPUT_HPP
+#define ORDEREDOUTPUT_HPP
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+// out/err 向けの出力を 1 本のバッファに溜め、書いた順番のまま吐き出すためのクラス
+// (まとめて書いても stdout と stderr の行の前後関係が崩れない)
+class OrderedOutput {
+public:
+    OrderedOutput();
+    OrderedOutput(const OrderedOutput& src);
+    OrderedOutput& operator=(const OrderedOutput& src);
+    ~OrderedOutput();
+
+    void append(bool toErr, const char* p, std::size_t n);
+    void append(bool toErr, const std::string& s);
+    /** Writes the buffered segments to out/err in order and clears them. */
+    void flushTo(std::ostream& out, std::ostream& err);
+    void clear();
+    std::size_t size() const;
+    /** All buffered bytes, out and err segments in order. */
+    const char* data() const;
+
+private:
+    std::string data_;
+    std::vector<std::pair<std::size_t, bool> > segs_; // (end offset, toErr)
+};
+
+#endif // ORDEREDOUTPUT_HPP
@@ -0,0 +1,295 @@
+#include "QueryServer.hpp"
+#include <cerrno>
+#include <cstring>      // memset, strncpy, memchr
+#include <stdexcept>
+#include <fcntl.h>      // fcntl, open
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>     // sockaddr_un
+#include <unistd.h>     // read, write, close, unlink, pipe
+
+// 応答を溜めたまま読まない相手からは、これを超えたら読むのを止める
+static const std::size_t kMaxPendingOut = 4u << 20;
+static const std::size_t kReadChunk = 64u << 10;
+// '\n' の来ない行はこれ以上溜めず、エラーを返して接続を閉じる
+static const std::size_t kMaxLineBytes = 64u << 10;
+static const char kLineTooLong[] = "Error: bad input => line too long.\n";
+
+static void setNonBlocking(int fd) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+QueryServer::QueryServer(const BitcoinExchange& app)
+    : app_(app), listenFd_(-1), epollFd_(-1), spareFd_(-1), listenPaused_(false) {
+    if (::pipe(wakeFds_) < 0)
+        throw std::runtime_error("could not create pipe.");
+    setNonBlocking(wakeFds_[0]);
+    setNonBlocking(wakeFds_[1]);
+    spareFd_ = ::open("/dev/null", O_RDONLY);
+}
+
+QueryServer::~QueryServer() {
+    for (std::map<int, Conn>::iterator it = conns_.begin(); it != conns_.end(); ++it)
+        ::close(it->first);
+    if (epollFd_ >= 0) ::close(epollFd_);
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        ::unlink(path_.c_str());
+    }
+    ::close(wakeFds_[0]);
+    ::close(wakeFds_[1]);
+    if (spareFd_ >= 0) ::close(spareFd_);
+}
+
+void QueryServer::listenUnix(const std::string& path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + path);
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("could not create socket.");
+    ::unlink(path.c_str()); // 前回落ちた時のソケットファイルが残っていることがある
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || ::listen(fd, 128) < 0) {
+        ::close(fd);
+        throw std::runtime_error("could not listen on " + path);
+    }
+    setNonBlocking(fd);
+    listenFd_ = fd;
+    path_ = path;
+}
+
+void QueryServer::stop() {
+    const char c = 0;
+    ssize_t n = ::write(wakeFds_[1], &c, 1); // async-signal-safe
+    (void)n;
+}
+
+void QueryServer::run() {
+    if (listenFd_ < 0)
+        throw std::runtime_error("server is not listening.");
+    epollFd_ = ::epoll_create(64);
+    if (epollFd_ < 0)
+        throw std::runtime_error("could not create epoll.");
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+    ev.data.fd = wakeFds_[0];
+    ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFds_[0], &ev);
+
+    epoll_event events[64];
+    for (;;) {
+        const int n = ::epoll_wait(epollFd_, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("epoll_wait failed.");
+        }
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wakeFds_[0])
+                return;
+            if (fd == listenFd_) {
+                accept();
+                continue;
+            }
+            std::map<int, Conn>::iterator it = conns_.find(fd);
+            if (it == conns_.end()) continue;
+            Conn& c = it->second;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                onReadable(fd, c);
+            if (!flush(fd, c)) {
+                closeConn(fd);
+                continue;
+            }
+            if (c.closing && c.outPos == c.out.size()) {
+                closeConn(fd);
+                continue;
+            }
+            updateEvents(fd, c);
+        }
+    }
+}
+
+// listenFd_ の EPOLLIN を付け外しする (fd が尽きている間は外す)
+void QueryServer::watchListen(bool on) {
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = 0;
+    if (on) ev.events |= EPOLLIN;
+    ev.data.fd = listenFd_;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, listenFd_, &ev);
+    listenPaused_ = !on;
+}
+
+void QueryServer::accept() {
+    for (;;) {
+        int fd = ::accept(listenFd_, 0, 0);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EMFILE && errno != ENFILE) return; // EAGAIN: 全部受け付けた
+            // fd が尽きた。待ち行列に残すと level-triggered の EPOLLIN が鳴り続けるので、
+            // 予備の fd を空けて受け付けてすぐ閉じる。予備もなければ接続が閉じるまで待つ
+            if (spareFd_ < 0) {
+                watchListen(false);
+                return;
+            }
+            // (EMFILE は待ち行列が空でも返るので、受け付けるものがなければ戻る)
+            ::close(spareFd_);
+            fd = ::accept(listenFd_, 0, 0);
+            if (fd >= 0) ::close(fd);
+            spareFd_ = ::open("/dev/null", O_RDONLY);
+            if (fd < 0) return;
+            continue;
+        }
+        setNonBlocking(fd);
+        Conn& c = conns_[fd];
+        c.outPos = 0;
+        c.header_checked = false;
+        c.closing = false;
+        c.wantWrite = false;
+        c.reading = true;
+        epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// 完結した行 [b, e) に答えて out の末尾に追加する
+void QueryServer::answer(const char* b, const char* e, bool& header_checked,
+                         std::string& out) {
+    app_.processRange(b, e, header_checked, sink_);
+    out.append(sink_.data(), sink_.size());
+    sink_.clear();
+}
+
+// 読めるだけ読み、'\n' まで揃った行には読んだ単位でまとめて答える
+void QueryServer::onReadable(int fd, Conn& c) {
+    char buf[kReadChunk];
+    while (!c.closing && c.out.size() - c.outPos < kMaxPendingOut) {
+        const ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) { // EOF or error: 残りの行にも答えてから閉じる
+            c.closing = true;
+            if (!c.in.empty())
+                answer(c.in.data(), c.in.data() + c.in.size(), c.header_checked, c.out);
+            c.in.clear();
+            return;
+        }
+        const char* nl = static_cast<const char*>(std::memchr(buf, '\n', n));
+        if (nl == 0) { // まだ行の途中
+            c.in.append(buf, n);
+            if (c.in.size() > kMaxLineBytes) {
+                c.out.append(kLineTooLong, sizeof(kLineTooLong) - 1);
+                c.in.clear();
+                c.closing = true;
+            }
+            continue;
+        }
+        // 前回の残り + 今回の最後の '\n' まで
+        const char* last = buf + n;
+        while (last[-1] != '\n') --last;
+        if (c.in.empty()) {
+            answer(buf, last, c.header_checked, c.out);
+        } else {
+            c.in.append(buf, last - buf);
+            answer(c.in.data(), c.in.data() + c.in.size(), c.header_checked, c.out);
+            c.in.clear();
+        }
+        c.in.append(last, buf + n - last);
+    }
+}
+
+// @return false if the peer is gone
+bool QueryServer::flush(int fd, Conn& c) {
+    while (c.outPos < c.out.size()) {
+        const ssize_t n = ::send(fd, c.out.data() + c.outPos, c.out.size() - c.outPos,
+                                 MSG_NOSIGNAL);
+        if (n > 0) {
+            c.outPos += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n < 0 && errno == EINTR) continue;
+        return false;
+    }
+    if (c.outPos == c.out.size()) {
+        c.out.clear();
+        c.outPos = 0;
+    } else if (c.outPos > (1u << 20) && c.outPos > c.out.size() / 2) {
+        c.out.erase(0, c.outPos);
+        c.outPos = 0;
+    }
+    return true;
+}
+
+// 書き残しがあれば EPOLLOUT、溜まりすぎていれば EPOLLIN を外す
+void QueryServer::updateEvents(int fd, Conn& c) {
+    const bool wantWrite = c.outPos < c.out.size();
+    const bool reading = !c.closing && c.out.size() - c.outPos < kMaxPendingOut;
+    if (wantWrite == c.wantWrite && reading == c.reading) return;
+    epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = 0;
+    if (reading) ev.events |= EPOLLIN;
+    if (wantWrite) ev.events |= EPOLLOUT;
+    ev.data.fd = fd;
+    ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+    c.wantWrite = wantWrite;
+    c.reading = reading;
+}
+
+void QueryServer::closeConn(int fd) {
+    ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, 0);
+    ::close(fd);
+    conns_.erase(fd);
+    if (spareFd_ < 0)
+        spareFd_ = ::open("/dev/null", O_RDONLY);
+    if (listenPaused_)
+        watchListen(true);
+}
+
+static bool writeAll(int fd, const char* p, std::size_t len) {
+    while (len > 0) {
+        const ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+void QueryServer::serveStream(int inFd, int outFd) const {
+    std::string in;
+    OrderedOutput sink;
+    bool header_checked = false;
+    char buf[kReadChunk];
+    for (;;) {
+        const ssize_t n = ::read(inFd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        const bool eof = n <= 0;
+        if (!eof) in.append(buf, n);
+        const std::string::size_type nl = in.rfind('\n');
+        const std::size_t upto = eof ? in.size() : nl == std::string::npos ? 0 : nl + 1;
+        if (upto == 0 && in.size() > kMaxLineBytes) {
+            writeAll(outFd, kLineTooLong, sizeof(kLineTooLong) - 1);
+            return;
+        }
+        if (upto > 0) {
+            app_.processRange(in.data(), in.data() + upto, header_checked, sink);
+            in.erase(0, upto);
+            if (!writeAll(outFd, sink.data(), sink.size())) return;
+            sink.clear();
+        }
+        if (eof) return;
+    }
+}
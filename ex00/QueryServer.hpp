@@ -0,0 +1,80 @@
+#ifndef QUERYSERVER_HPP
+#define QUERYSERVER_HPP
+#include <map>
+#include <string>
+#include <cstddef>
+#include "BitcoinExchange.hpp"
+#include "OrderedOutput.hpp"
+
+/**
+  * Long-lived query mode for btc: the rate database is loaded once and
+  * "date | value" lines are answered as they arrive.
+  *
+  * Protocol: one request per '\n'-terminated line, one response line per
+  * non-empty request, in request order. Responses are exactly what btc
+  * prints for that line on stdout or stderr ("... => v = r" or
+  * "Error: ..."), produced by BitcoinExchange::processRange. As in input
+  * files, an optional "date | value" header on the first line is skipped.
+  * Clients may pipeline any number of requests; every read is answered
+  * with a single write of all the responses it completed.
+  * A line that grows past 64 KiB without a '\n' is answered with
+  * "Error: bad input => line too long." and the connection is closed.
+*/
+class QueryServer {
+public:
+    explicit QueryServer(const BitcoinExchange& app);
+    ~QueryServer();
+
+    /**
+      * Creates a Unix domain socket at path (replacing a stale one) and
+      * starts listening.
+      * @throws std::runtime_error on failure
+    */
+    void listenUnix(const std::string& path);
+    /**
+      * Serves connections with epoll until stop() is called.
+      * @throws std::runtime_error if listenUnix() was not called
+    */
+    void run();
+    /** Makes run() return. Safe to call from another thread or a signal handler. */
+    void stop();
+    /**
+      * Same protocol over a pair of file descriptors (e.g. stdin/stdout),
+      * until EOF on inFd. Each read() is answered before the next one.
+    */
+    void serveStream(int inFd, int outFd) const;
+
+private:
+    QueryServer(const QueryServer&);
+    QueryServer& operator=(const QueryServer&);
+
+    struct Conn {
+        std::string in;        // unparsed bytes (partial last line)
+        std::string out;       // responses not yet written
+        std::size_t outPos;    // out[0, outPos) already written
+        bool header_checked;
+        bool closing;          // peer sent EOF, close once out is drained
+        bool wantWrite;        // registered for EPOLLOUT
+        bool reading;          // registered for EPOLLIN
+    };
+
+    void accept();
+    void watchListen(bool on);
+    void onReadable(int fd, Conn& c);
+    bool flush(int fd, Conn& c);
+    void updateEvents(int fd, Conn& c);
+    void closeConn(int fd);
+    void answer(const char* b, const char* e, bool& header_checked, std::string& out);
+
+    const BitcoinExchange& app_;
+    std::string path_;
+    int listenFd_;
+    int epollFd_;
+    int wakeFds_[2];               // stop(): self-pipe
+    int spareFd_;                  // EMFILE: closed to accept and drop a connection
+    bool listenPaused_;            // listenFd_ unwatched until a connection closes
+    std::map<int, Conn> conns_;
+    OrderedOutput sink_;
+};
+
+#endif // QUERYSERVER_HPP
@@ -1,50 +1,584 @@
 #include "RateTable.hpp"
 #include "Utils.hpp"
+#include <algorithm>  // std::sort
+#include <cstdio>     // rename
+#include <cstring>    // memchr, memrchr, memcmp, memcpy
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close
 
-RateTable::RateTable() {}
+RateTable::RateTable(Backend backend)
+    : backend_(backend), rows_(0), firstDay_(0) {}
 RateTable::~RateTable() {}
-RateTable::RateTable(const RateTable& src) {
-    if (this != &src)
-        *this = RateTable();
-};
+RateTable::RateTable(const RateTable& src)
+    : backend_(src.backend_),
+      rows_(src.rows_),
+      rates_(src.rates_),
+      days_(src.days_),
+      values_(src.values_),
+      firstDay_(src.firstDay_),
+      dense_(src.dense_) {}
 RateTable& RateTable::operator=(const RateTable& src){
     if (this != &src) {
+        this->backend_ = src.backend_;
+        this->rows_ = src.rows_;
         this->rates_ = src.rates_;
+        this->days_ = src.days_;
+        this->values_ = src.values_;
+        this->firstDay_ = src.firstDay_;
+        this->dense_ = src.dense_;
     }
     return *this;
 }
 
+RateTable::Backend RateTable::backend() const { return backend_; }
+
+std::size_t RateTable::size() const { return rows_; }
+
+std::size_t RateTable::memoryFootprint() const {
+    switch (backend_) {
+        case FLAT:
+            return days_.capacity() * sizeof(uint32_t)
+                 + values_.capacity() * sizeof(double);
+        case DENSE:
+            return dense_.capacity() * sizeof(double);
+        default: {
+            // rb-tree node: 3 pointers + color, then the pair itself
+            std::size_t bytes = rates_.size()
+                * (4 * sizeof(void*) + sizeof(std::pair<const std::string,double>));
+            for (std::map<std::string,double>::const_iterator it = rates_.begin();
+                 it != rates_.end(); ++it) {
+                if (it->first.capacity() > 15) // libstdc++ SSO
+                    bytes += it->first.capacity() + 1;
+            }
+            return bytes;
+        }
+    }
+}
+
+// ---- row scanning shared by load() and loadFile() ----
+
+// [b, e) は trim 済みの rate 文字列。普通の 10 進数以外は strtod に任せる
+// (strtod は NUL 終端が必要なのでスタックにコピーする)
+static bool parseRate(const char* b, const char* e, double& out) {
+    if (parseDecimalFast(b, e, out)) return true;
+    char buf[64];
+    const std::size_t len = e - b;
+    std::string big;
+    const char* c = buf;
+    if (len < sizeof(buf)) {
+        std::memcpy(buf, b, len);
+        buf[len] = '\0';
+    } else { // 異常に長い値だけヒープを使う
+        big.assign(b, len);
+        c = big.c_str();
+    }
+    char* endp = 0;
+    out = std::strtod(c, &endp);
+    if (endp == c) return false;    // failed to parse
+    if (*endp != '\0') return false; // extra characters after number
+    return true;
+}
+
+/**
+  * Applies the data.csv skip rules to one line (without its '\n').
+  * @return true if the line is a data row; date range and rate are set
+*/
+static bool scanRow(const char* b, const char* e, bool& header_checked,
+                    const char*& dateB, const char*& dateE, double& rate) {
+    static const char header[] = "date,exchange_rate";
+    if (b == e) return false;
+    if (!header_checked) {
+        header_checked = true;
+        const char* tb = b;
+        const char* te = e;
+        trimRange(tb, te);
+        if (static_cast<std::size_t>(te - tb) == sizeof(header) - 1
+            && std::memcmp(tb, header, sizeof(header) - 1) == 0)
+            return false; // skip header
+    }
+    const char* comma = static_cast<const char*>(std::memchr(b, ',', e - b));
+    if (comma == 0) return false; // skip malformed line
+
+    dateB = b;
+    dateE = comma;
+    trimRange(dateB, dateE);
+    const char* rateB = comma + 1;
+    const char* rateE = e;
+    trimRange(rateB, rateE);
+    if (dateB == dateE || rateB == rateE) return false;
+    return parseRate(rateB, rateE, rate);
+}
+
 void RateTable::load(std::istream& in) {
     std::string line;
     bool header_checked = false;
+    const char* dateB;
+    const char* dateE;
+    double rate;
 
     while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        if (!header_checked) {
-            header_checked = true;
-            std::string t = trim(line);
-            if (t == "date,exchange_rate") continue; // skip header
-        }
-        std::string::size_type comma = line.find(',');
-        if (comma == std::string::npos) continue; // skip malformed line
+        const char* b = line.data();
+        if (scanRow(b, b + line.size(), header_checked, dateB, dateE, rate))
+            addRow(dateB, dateE - dateB, rate);
+    }
+    finishLoad();
+}
+
+// load() は既存の行に追記する (DENSE も元の (day, rate) 列を残しているので展開し直すだけ)
+void RateTable::extend(std::istream& in) {
+    load(in);
+}
+
+void RateTable::loadFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        throw std::runtime_error("could not open " + path);
+    }
+    try {
+        loadMapped(fd, static_cast<std::size_t>(st.st_size), path, false);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+}
+
+std::size_t RateTable::loadCompleteLines(int fd, std::size_t len, const std::string& path) {
+    return loadMapped(fd, len, path, true);
+}
 
-        std::string date = trim(line.substr(0, comma));
-        std::string srate = trim(line.substr(comma + 1));
-        if (date.size() == 0 || srate.size() == 0) continue;
+// fd の先頭 len バイトを mmap して行を読む。completeOnly なら最後の '\n' の後ろは読まない
+std::size_t RateTable::loadMapped(int fd, std::size_t len, const std::string& path,
+                                  bool completeOnly) {
+    void* map = MAP_FAILED;
+    if (len > 0) {
+        map = ::mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            throw std::runtime_error("could not map " + path);
+        ::madvise(map, len, MADV_SEQUENTIAL);
+    }
 
-        const char* c = srate.c_str();
-        char* endp = 0;
-        double rate = std::strtod(c, &endp);
-        if (endp == c) continue; // failed to parse
-        if (*endp != '\0') continue; // extra characters after number
-        rates_[date] = rate;
+    std::size_t used = 0;
+    if (len > 0) {
+        // 読み終わった部分は MADV_DONTNEED で手放し、peak RSS をファイルサイズに比例させない
+        static const std::size_t kReleaseChunk = 16u << 20;
+        char* base = static_cast<char*>(map);
+        std::size_t released = 0;
+        const char* p = base;
+        const char* end = p + len;
+        if (completeOnly) {
+            const char* last = static_cast<const char*>(::memrchr(base, '\n', len));
+            end = last ? last + 1 : base;
+        }
+        bool header_checked = false;
+        const char* dateB;
+        const char* dateE;
+        double rate;
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char* eol = nl ? nl : end;
+            if (scanRow(p, eol, header_checked, dateB, dateE, rate))
+                addRow(dateB, dateE - dateB, rate);
+            p = nl ? nl + 1 : end;
+            if (static_cast<std::size_t>(p - base) - released >= 2 * kReleaseChunk) {
+                ::madvise(base + released, kReleaseChunk, MADV_DONTNEED);
+                released += kReleaseChunk;
+            }
+        }
+        used = static_cast<std::size_t>(end - base);
+        ::munmap(map, len);
+    }
+    finishLoad();
+    return used;
+}
+
+// MAP は文字列キー、FLAT/DENSE は day number に変換して配列に追記 (重複は後勝ち)
+void RateTable::addRow(const char* date, std::size_t len, double rate) {
+    if (backend_ == MAP) {
+        rates_[std::string(date, len)] = rate;
+        return;
+    }
+    uint32_t day;
+    if (!parseDayNumber(date, len, day)) return;
+    if (!days_.empty() && days_.back() == day) {
+        values_.back() = rate;
+        return;
     }
+    days_.push_back(day);
+    values_.push_back(rate);
+}
 
-    if (rates_.empty())
+void RateTable::finishLoad() {
+    if (backend_ != MAP)
+        sortFlat();
+    if (backend_ == DENSE)
+        buildDense();
+    // DENSE も days_/values_ は残す: 展開からは同じ値が続く行を復元できず、extend や
+    // snapshot で元の行が要る
+    rows_ = backend_ == MAP ? rates_.size() : days_.size();
+    if (rows_ == 0)
         throw std::runtime_error("empty rate database.");
 }
 
+// 日付順に並んでいない data.csv 用: (day, 出現順) でソートし、同じ日は最後の行を残す
+void RateTable::sortFlat() {
+    const std::size_t n = days_.size();
+    std::size_t i = 1;
+    while (i < n && days_[i - 1] < days_[i]) ++i;
+    if (i >= n) return; // already sorted and unique
+
+    std::vector<std::pair<uint32_t, std::size_t> > order(n);
+    for (std::size_t k = 0; k < n; ++k)
+        order[k] = std::make_pair(days_[k], k);
+    std::sort(order.begin(), order.end());
+    std::vector<uint32_t> days;
+    std::vector<double> values;
+    days.reserve(n);
+    values.reserve(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        if (k + 1 < n && order[k + 1].first == order[k].first) continue;
+        days.push_back(order[k].first);
+        values.push_back(values_[order[k].second]);
+    }
+    days_.swap(days);
+    values_.swap(values);
+}
+
+// ---- binary snapshot ----
+//
+// layout (native endianness, all offsets 8-byte aligned):
+//   SnapshotHeader
+//   uint32_t days[rows]      sorted, unique day numbers
+//   padding to 8 bytes
+//   double   values[rows]    rate of days[i]
+// checksum is FNV-1a 64 over days[] and values[].
+
+static const char kSnapshotMagic[8] = {'B', 'T', 'C', 'R', 'A', 'T', 'E', '\0'};
+// version 2: 元の CSV の mtime をナノ秒まで持ち、inode と device も持つ
+static const uint32_t kSnapshotVersion = 2;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t sourceSize;   // st_size of the CSV it was built from
+    int64_t sourceMtime;   // st_mtim.tv_sec of the CSV it was built from
+    int64_t sourceMtimeNsec; // st_mtim.tv_nsec
+    uint64_t sourceIno;    // st_ino / st_dev: a rename-replaced CSV is a new file
+    uint64_t sourceDev;
+    uint64_t checksum;
+};
+
+// 同じ秒に同じ長さで書き直された CSV も、置き換えられた CSV も別物として扱う
+static void setSource(SnapshotHeader& h, const struct stat& src) {
+    h.sourceSize = static_cast<uint64_t>(src.st_size);
+    h.sourceMtime = static_cast<int64_t>(src.st_mtim.tv_sec);
+    h.sourceMtimeNsec = static_cast<int64_t>(src.st_mtim.tv_nsec);
+    h.sourceIno = static_cast<uint64_t>(src.st_ino);
+    h.sourceDev = static_cast<uint64_t>(src.st_dev);
+}
+
+static bool sameSource(const SnapshotHeader& h, const struct stat& src) {
+    return h.sourceSize == static_cast<uint64_t>(src.st_size)
+        && h.sourceMtime == static_cast<int64_t>(src.st_mtim.tv_sec)
+        && h.sourceMtimeNsec == static_cast<int64_t>(src.st_mtim.tv_nsec)
+        && h.sourceIno == static_cast<uint64_t>(src.st_ino)
+        && h.sourceDev == static_cast<uint64_t>(src.st_dev);
+}
+
+static std::size_t daysBytes(uint64_t rows) {
+    return static_cast<std::size_t>((rows * sizeof(uint32_t) + 7) & ~static_cast<uint64_t>(7));
+}
+
+static uint64_t fnv1a(uint64_t h, const void* data, std::size_t len) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t snapshotChecksum(const uint32_t* days, const double* values, uint64_t rows) {
+    uint64_t h = 14695981039346656037ULL;
+    h = fnv1a(h, days, rows * sizeof(uint32_t));
+    return fnv1a(h, values, rows * sizeof(double));
+}
+
+static bool writeAll(int fd, const void* data, std::size_t len) {
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 各バックエンドの中身を (day, rate) の昇順列に戻す
+void RateTable::exportRows(std::vector<uint32_t>& days, std::vector<double>& values) const {
+    days.clear();
+    values.clear();
+    if (backend_ != MAP) {
+        days = days_;
+        values = values_;
+    } else {
+        for (std::map<std::string,double>::const_iterator it = rates_.begin();
+             it != rates_.end(); ++it) {
+            uint32_t day;
+            if (!parseDayNumber(it->first.data(), it->first.size(), day)) continue;
+            days.push_back(day);
+            values.push_back(it->second);
+        }
+    }
+}
+
+void RateTable::saveSnapshot(const std::string& path, const std::string& sourceCsv) const {
+    struct stat src;
+    if (::stat(sourceCsv.c_str(), &src) < 0)
+        throw std::runtime_error("could not open " + sourceCsv);
+
+    std::vector<uint32_t> days;
+    std::vector<double> values;
+    exportRows(days, values);
+
+    SnapshotHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kSnapshotMagic, sizeof(h.magic));
+    h.version = kSnapshotVersion;
+    h.rows = days.size();
+    setSource(h, src);
+    h.checksum = snapshotChecksum(days.empty() ? 0 : &days[0],
+                                  values.empty() ? 0 : &values[0], h.rows);
+
+    // 途中で落ちても壊れた snapshot が残らないよう、一時ファイルに書いて rename する
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("could not create " + tmp);
+    static const char pad[8] = {0};
+    const std::size_t dayLen = days.size() * sizeof(uint32_t);
+    bool ok = writeAll(fd, &h, sizeof(h))
+        && (days.empty() || writeAll(fd, &days[0], dayLen))
+        && writeAll(fd, pad, daysBytes(h.rows) - dayLen)
+        && (values.empty() || writeAll(fd, &values[0], values.size() * sizeof(double)));
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) < 0) {
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("could not write " + path);
+    }
+}
+
+void RateTable::loadSnapshot(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        throw std::runtime_error("truncated snapshot: " + path);
+    }
+    const std::size_t len = static_cast<std::size_t>(st.st_size);
+    void* map = ::mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("could not map " + path);
+
+    const char* base = static_cast<const char*>(map);
+    const SnapshotHeader* h = reinterpret_cast<const SnapshotHeader*>(base);
+    const char* err = 0;
+    if (std::memcmp(h->magic, kSnapshotMagic, sizeof(h->magic)) != 0)
+        err = "not a rate snapshot: ";
+    else if (h->version != kSnapshotVersion)
+        err = "unsupported snapshot version: ";
+    else if (h->rows > (len - sizeof(SnapshotHeader)) / sizeof(uint32_t)
+             || len != sizeof(SnapshotHeader) + daysBytes(h->rows) + h->rows * sizeof(double))
+        err = "truncated snapshot: ";
+    if (err == 0) {
+        const uint32_t* days = reinterpret_cast<const uint32_t*>(base + sizeof(SnapshotHeader));
+        const double* values = reinterpret_cast<const double*>(
+            base + sizeof(SnapshotHeader) + daysBytes(h->rows));
+        if (snapshotChecksum(days, values, h->rows) != h->checksum) {
+            err = "snapshot checksum mismatch: ";
+        } else {
+            const std::size_t n = static_cast<std::size_t>(h->rows);
+            if (backend_ == MAP) {
+                char buf[DATE_TOTAL_LEN];
+                for (std::size_t i = 0; i < n; ++i) {
+                    formatDayNumber(days[i], buf);
+                    rates_[std::string(buf, DATE_TOTAL_LEN)] = values[i];
+                }
+            } else {
+                days_.insert(days_.end(), days, days + n);
+                values_.insert(values_.end(), values, values + n);
+            }
+        }
+    }
+    ::munmap(map, len);
+    if (err)
+        throw std::runtime_error(err + path);
+    finishLoad();
+}
+
+bool RateTable::isSnapshotFresh(const std::string& snapshotPath, const std::string& csvPath) {
+    struct stat src;
+    if (::stat(csvPath.c_str(), &src) < 0) return false;
+    int fd = ::open(snapshotPath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    SnapshotHeader h;
+    const bool read_ok = ::read(fd, &h, sizeof(h)) == static_cast<ssize_t>(sizeof(h));
+    ::close(fd);
+    return read_ok
+        && std::memcmp(h.magic, kSnapshotMagic, sizeof(h.magic)) == 0
+        && h.version == kSnapshotVersion
+        && sameSource(h, src);
+}
+
+// snapshot は day number の列なので、日付として正しくない行を文字列キーで残す MAP には使わない
+void RateTable::loadCached(const std::string& csvPath) {
+    const std::string snap = csvPath + ".snap";
+    if (backend_ != MAP && isSnapshotFresh(snap, csvPath)) {
+        try {
+            loadSnapshot(snap);
+            return;
+        } catch (const std::exception&) {
+            // 壊れた snapshot は無視して CSV を読み直す
+            rates_.clear();
+            days_.clear();
+            values_.clear();
+        }
+    }
+    loadFile(csvPath);
+}
+
+// days_/values_ を 1 日 1 スロットに展開し、欠けている日は前の日の値で埋める
+void RateTable::buildDense() {
+    dense_.clear();
+    if (days_.empty()) return;
+    firstDay_ = days_.front();
+    std::vector<double>(days_.back() - firstDay_ + 1).swap(dense_);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < dense_.size(); ++i) {
+        if (k + 1 < days_.size() && days_[k + 1] == firstDay_ + i) ++k;
+        dense_[i] = values_[k];
+    }
+}
+
+// Returns the index of the last entry in [lo, lo + n) whose day <= day.
+// Requires days_[lo] <= day.
+std::size_t RateTable::searchFlat(std::size_t lo, std::size_t n, uint32_t day) const {
+    const uint32_t* base = &days_[lo];
+    // invariant: base[0] <= day, answer is in [base, base + n)
+    while (n > 1) {
+        const std::size_t half = n / 2;
+        base = (base[half] <= day) ? base + half : base;  // cmov
+        n -= half;
+    }
+    return base - &days_[0];
+}
+
+// Returns the rate of the last entry whose day <= day.
+bool RateTable::lookupFlat(uint32_t day, double& out) const {
+    if (days_.empty() || day < days_[0]) return false;
+    out = values_[searchFlat(0, days_.size(), day)];
+    return true;
+}
+
+// searchFlat() starting from a previous answer `from`: widen the bracket
+// 1, 2, 4, ... entries towards day, then binary search inside it.
+// Requires days_[0] <= day. Costs O(log distance) instead of O(log M); the
+// widening gives up after kGallopSteps and searches the rest of the array,
+// so a far jump costs at most a few probes more than searchFlat().
+std::size_t RateTable::gallopFlat(std::size_t from, uint32_t day) const {
+    static const std::size_t kGallopSteps = 1u << 6;
+    const std::size_t n = days_.size();
+    std::size_t step = 1;
+    if (days_[from] <= day) {
+        std::size_t lo = from;
+        while (lo + step < n && days_[lo + step] <= day) {
+            lo += step;
+            if (step == kGallopSteps) return searchFlat(lo, n - lo, day);
+            step <<= 1;
+        }
+        const std::size_t hi = lo + step < n ? lo + step : n;
+        return searchFlat(lo, hi - lo, day);
+    }
+    std::size_t hi = from; // days_[hi] > day
+    while (step <= hi && days_[hi - step] > day) {
+        hi -= step;
+        if (step == kGallopSteps) return searchFlat(0, hi, day);
+        step <<= 1;
+    }
+    const std::size_t lo = step <= hi ? hi - step : 0;
+    return searchFlat(lo, hi - lo, day);
+}
+
+std::size_t RateTable::getRatesForDays(const uint32_t* days, std::size_t n,
+                                       double* out, bool* found) const {
+    std::size_t hits = 0;
+    if (backend_ != FLAT) {
+        for (std::size_t i = 0; i < n; ++i) {
+            found[i] = getRateForDay(days[i], out[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+    // 同じ向きの問い合わせが 2 回続いたら (単調な並びとみなして) 前回の位置から gallop する
+    std::size_t pos = 0;
+    std::size_t run = 0; // length of the current monotone run
+    int dir = 0;         // +1: ascending, -1: descending
+    uint32_t prev = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const uint32_t day = days[i];
+        if (days_.empty() || day < days_[0]) {
+            found[i] = false;
+            continue;
+        }
+        const int d = day > prev ? 1 : day < prev ? -1 : dir;
+        run = (run > 0 && d == dir) ? run + 1 : 1;
+        dir = d;
+        if (run > 2 || (run > 1 && day == prev))
+            pos = gallopFlat(pos, day);
+        else
+            pos = searchFlat(0, days_.size(), day);
+        prev = day;
+        out[i] = values_[pos];
+        found[i] = true;
+        ++hits;
+    }
+    return hits;
+}
+
+bool RateTable::lookupDense(uint32_t day, double& out) const {
+    if (dense_.empty() || day < firstDay_) return false;
+    std::size_t i = day - firstDay_;
+    if (i >= dense_.size()) i = dense_.size() - 1; // 最終日以降は最終レート
+    out = dense_[i];
+    return true;
+}
+
+bool RateTable::getRateForDay(uint32_t day, double& out) const {
+    if (backend_ == DENSE) return lookupDense(day, out);
+    if (backend_ == FLAT) return lookupFlat(day, out);
+    char buf[DATE_TOTAL_LEN];
+    formatDayNumber(day, buf);
+    return getRateForDate(std::string(buf, DATE_TOTAL_LEN), out); // SSO に収まる
+}
+
 bool RateTable::getRateForDate(const std::string& date, double& out) const {
+    if (backend_ != MAP) {
+        uint32_t day;
+        if (!parseDayNumber(date.data(), date.size(), day)) return false;
+        return backend_ == DENSE ? lookupDense(day, out) : lookupFlat(day, out);
+    }
     if (rates_.empty()) return false;
 
     // lower_bound returns the first element with key >= date
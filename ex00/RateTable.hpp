@@ -1,6 +1,7 @@
 #ifndef RATETABLE_HPP
 #define RATETABLE_HPP
 #include <map>
+#include <vector>
 #include <string>
 #include <istream>
 #include <sstream>
@@ -8,6 +9,7 @@
 #include <cctype>     // isdigit
 #include <cstdlib>    // strtod
 #include <iomanip>
+#include <stdint.h>   // uint32_t
 
 #define DATE_TOTAL_LEN 10
 #define DATE_YEAR_END  4  // YYYY-MM-DD
@@ -18,7 +20,21 @@
 // data.csv の読み込みとレート取得を担当するクラス
 class RateTable {
 public:
-    RateTable();
+  /**
+    * Lookup structure used after load().
+    * MAP  : std::map<std::string,double> (string keys, red-black tree)
+    * FLAT : day numbers in a sorted uint32_t array + parallel rate array,
+    *        searched with a branch-light binary search.
+    *        Rows whose date is not a valid YYYY-MM-DD are dropped.
+    * DENSE: one slot per calendar day from the first to the last date,
+    *        gaps forward-filled, so a lookup is a subtraction + one load.
+    *        Same row filtering as FLAT. Pick it when memoryFootprint() of
+    *        the dense table is acceptable (8 bytes * days spanned). The
+    *        sorted rows are kept as well, for extend() and saveSnapshot().
+  */
+    enum Backend { MAP, FLAT, DENSE };
+
+    explicit RateTable(Backend backend = MAP);
     RateTable(const RateTable& src);
     RateTable& operator=(const RateTable& src);
     ~RateTable();
@@ -28,6 +44,46 @@ public:
     * @param in The input stream to read from.
   */
   void load(std::istream& in);
+  /**
+    * Same as load() but maps the file with mmap and scans rows in place,
+    * without per-row heap allocations for the FLAT and DENSE backends.
+    * @param path Path of the CSV file.
+    * @throws std::runtime_error if the file cannot be opened or is empty.
+  */
+  void loadFile(const std::string& path);
+  /**
+    * Same as loadFile() on the first `len` bytes of an open descriptor,
+    * but stops after the last '\n': a partial last line is not loaded.
+    * @return number of bytes loaded (offset just past the last '\n')
+    * @throws std::runtime_error if the file cannot be mapped.
+  */
+  std::size_t loadCompleteLines(int fd, std::size_t len, const std::string& path);
+  /**
+    * Adds the rows of `in` to an already loaded table, with the same skip
+    * rules as load(). A date that is already present takes the new rate.
+  */
+  void extend(std::istream& in);
+  /**
+    * Writes the loaded rates as a binary snapshot (see RateTable.cpp for
+    * the layout), recording size and mtime of sourceCsv for freshness checks.
+    * @throws std::runtime_error on I/O failure.
+  */
+  void saveSnapshot(const std::string& path, const std::string& sourceCsv) const;
+  /**
+    * Loads a snapshot written by saveSnapshot() through mmap.
+    * @throws std::runtime_error if the file is missing, truncated, has the
+    *         wrong magic/version or fails the checksum.
+  */
+  void loadSnapshot(const std::string& path);
+  /** @return true if snapshotPath was written from csvPath as it is now */
+  static bool isSnapshotFresh(const std::string& snapshotPath, const std::string& csvPath);
+  /**
+    * Loads csvPath + ".snap" when it is fresh and valid,
+    * otherwise parses csvPath with loadFile(). The MAP backend always
+    * parses the CSV: a snapshot has no rows with invalid dates, which
+    * MAP keeps.
+  */
+  void loadCached(const std::string& csvPath);
   /**
    * Gets the rate for the given date, or the closest previous date if not found.
    * @param date The date string in YYYY-MM-DD format.
@@ -35,8 +91,43 @@ public:
    * @return true if a rate was found, false otherwise.
   */
   bool getRateForDate(const std::string& date, double& out) const; // 同日 or 直近過去
+  /** Same as getRateForDate() for a day number from parseDayNumber(). */
+  bool getRateForDay(uint32_t day, double& out) const;
+  /**
+    * Batch version of getRateForDay() for n day numbers.
+    * FLAT gallops from the previous answer while the days stay monotone
+    * (either direction), so sorted batches cost about O(n + log M) instead
+    * of n full searches; a break in the run falls back to a full search.
+    * DENSE indexes directly and MAP looks each day up on its own.
+    * @param out rate of days[i], left untouched where found[i] is false
+    * @return number of days with a rate
+  */
+  std::size_t getRatesForDays(const uint32_t* days, std::size_t n,
+                              double* out, bool* found) const;
+  Backend backend() const;
+  /** @return number of distinct dates loaded */
+  std::size_t size() const;
+  /** @return approximate bytes held by the lookup structure */
+  std::size_t memoryFootprint() const;
 private:
-  std::map<std::string,double> rates_;
+  std::size_t loadMapped(int fd, std::size_t len, const std::string& path, bool completeOnly);
+  void addRow(const char* date, std::size_t len, double rate);
+  void finishLoad();
+  void sortFlat();
+  void buildDense();
+  void exportRows(std::vector<uint32_t>& days, std::vector<double>& values) const;
+  bool lookupFlat(uint32_t day, double& out) const;
+  std::size_t searchFlat(std::size_t lo, std::size_t n, uint32_t day) const;
+  std::size_t gallopFlat(std::size_t from, uint32_t day) const;
+  bool lookupDense(uint32_t day, double& out) const;
+
+  Backend backend_;
+  std::size_t rows_;
+  std::map<std::string,double> rates_;  // MAP
+  std::vector<uint32_t> days_;          // FLAT/DENSE: sorted day numbers
+  std::vector<double> values_;          // FLAT/DENSE: rate of days_[i]
+  uint32_t firstDay_;                   // DENSE: day number of dense_[0]
+  std::vector<double> dense_;           // DENSE: rate of firstDay_ + i
 };
 
 #endif // RATETABLE_HPP
\ No newline at end of file
@@ -3,6 +3,10 @@
 
 #include <string>
 #include <ostream>
+#include <cstddef>   // std::size_t
+#include <stdint.h>  // uint32_t (C++98 には <cstdint> がない)
+#include <cstdio>    // sprintf
+#include <cstring>   // memcpy
 
 inline std::string trim(const std::string& s) {
     std::string::size_type b = s.find_first_not_of(" \t\r\n");
@@ -11,8 +15,246 @@ inline std::string trim(const std::string& s) {
     return s.substr(b, e - b + 1);
 }
 
+// trim() のポインタ版: [b, e) を前後の " \t\r\n" を除いた範囲に縮める
+inline void trimRange(const char*& b, const char*& e) {
+    while (b < e && (*b == ' ' || *b == '\t' || *b == '\r' || *b == '\n')) ++b;
+    while (e > b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r' || e[-1] == '\n')) --e;
+}
+
 inline void printError(std::ostream& err, const std::string& msg) {
     err << "Error: " << msg << '\n';
 }
 
+inline bool isLeapYear(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || (y % 400 == 0);
+}
+
+/**
+  * Converts a calendar date to a day number (days since 0000-03-01 shifted by
+  * 400 years so that year 0000 stays non-negative).
+  * Consecutive calendar days map to consecutive numbers, so comparing two day
+  * numbers gives the same order as comparing the "YYYY-MM-DD" strings.
+*/
+inline uint32_t daysFromCivil(int y, int m, int d) {
+    y += 400 - (m <= 2 ? 1 : 0);
+    const int era = y / 400;
+    const int yoe = y - era * 400;                                  // [0, 399]
+    const int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;  // [0, 365]
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;          // [0, 146096]
+    return static_cast<uint32_t>(era) * 146097u + static_cast<uint32_t>(doe);
+}
+
+/** Inverse of daysFromCivil. */
+inline void civilFromDays(uint32_t days, int& y, int& m, int& d) {
+    const int era = static_cast<int>(days / 146097u);
+    const int doe = static_cast<int>(days - static_cast<uint32_t>(era) * 146097u);
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 - 400 + (m <= 2 ? 1 : 0);
+}
+
+/** Writes the day number as "YYYY-MM-DD" (10 chars, no NUL). */
+inline void formatDayNumber(uint32_t days, char* out) {
+    int y, m, d;
+    civilFromDays(days, y, m, d);
+    out[0] = static_cast<char>('0' + y / 1000 % 10);
+    out[1] = static_cast<char>('0' + y / 100 % 10);
+    out[2] = static_cast<char>('0' + y / 10 % 10);
+    out[3] = static_cast<char>('0' + y % 10);
+    out[4] = '-';
+    out[5] = static_cast<char>('0' + m / 10);
+    out[6] = static_cast<char>('0' + m % 10);
+    out[7] = '-';
+    out[8] = static_cast<char>('0' + d / 10);
+    out[9] = static_cast<char>('0' + d % 10);
+}
+
+/**
+  * Parses a "YYYY-MM-DD" date into its day number.
+  * Accepts exactly what BitcoinExchange::isValidDate accepts.
+  * On little-endian targets the ten characters are checked as one 64-bit
+  * and one 16-bit word (SWAR) instead of byte by byte.
+  * @param s pointer to the first character of the date
+  * @param len number of characters (must be DATE_TOTAL_LEN)
+  * @param out day number on success
+  * @return true if the date is valid
+*/
+inline bool parseDayNumber(const char* s, std::size_t len, uint32_t& out) {
+    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    if (len != 10) return false;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // s[0..7] = "YYYY-MM-", byte i of x is s[i]
+    static const uint64_t kDashes = 0xFF0000FF00000000ULL; // bytes 4 and 7
+    static const uint64_t kZeros = 0x3030303030303030ULL;
+    uint64_t x;
+    uint16_t t;
+    std::memcpy(&x, s, 8);
+    std::memcpy(&t, s + 8, 2);
+    if ((x & kDashes) != 0x2D00002D00000000ULL) return false;
+    // dash lanes -> '0', then every byte must be 0x30..0x39:
+    // high nibble 3, and low nibble + 6 must not carry into it
+    x = (x & ~kDashes) | (kZeros & kDashes);
+    if ((x & 0xF0F0F0F0F0F0F0F0ULL) != kZeros
+        || ((x + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != kZeros)
+        return false;
+    if ((t & 0xF0F0) != 0x3030 || ((t + 0x0606) & 0xF0F0) != 0x3030)
+        return false;
+    const uint64_t d = x - kZeros;
+    const int y4 = static_cast<int>(d & 0xFF) * 1000 + static_cast<int>(d >> 8 & 0xFF) * 100
+                 + static_cast<int>(d >> 16 & 0xFF) * 10 + static_cast<int>(d >> 24 & 0xFF);
+    const int m = static_cast<int>(d >> 40 & 0xFF) * 10 + static_cast<int>(d >> 48 & 0xFF);
+    const int dd = (t & 0xFF) * 10 + (t >> 8) - ('0' * 11);
+#else
+    if (s[4] != '-' || s[7] != '-') return false;
+    int v[8];
+    static const int pos[8] = {0, 1, 2, 3, 5, 6, 8, 9};
+    for (int i = 0; i < 8; ++i) {
+        unsigned int c = static_cast<unsigned char>(s[pos[i]]) - '0';
+        if (c > 9) return false;
+        v[i] = static_cast<int>(c);
+    }
+    const int y4 = v[0] * 1000 + v[1] * 100 + v[2] * 10 + v[3];
+    const int m = v[4] * 10 + v[5];
+    const int dd = v[6] * 10 + v[7];
+#endif
+    if (m < 1 || m > 12) return false;
+    int maxd = mdays[m - 1];
+    if (m == 2 && isLeapYear(y4)) maxd = 29;
+    if (dd < 1 || dd > maxd) return false;
+    out = daysFromCivil(y4, m, dd);
+    return true;
+}
+
+/**
+  * Fast path for strtod on a plain decimal: [+-]digits[.digits][e[+-]digits]
+  * filling the whole range [b, e).
+  * The result is correctly rounded (one IEEE multiply or divide of exact
+  * operands, Clinger's fast path), so it equals strtod's. Anything else,
+  * such as leading/trailing spaces, inf/nan, hex, more than 2^53 in the
+  * mantissa or a power of ten beyond 1e22, returns false and the caller
+  * falls back to strtod with its own accept/reject rules.
+  * @return true if out was set
+*/
+inline bool parseDecimalFast(const char* b, const char* e, double& out) {
+    static const double p10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* p = b;
+    bool neg = false;
+    if (p < e && (*p == '+' || *p == '-')) { neg = *p == '-'; ++p; }
+    uint64_t m = 0;
+    int nd = 0;      // significant digits in m
+    int exp10 = 0;
+    bool any = false;
+    for (; p < e && static_cast<unsigned>(*p - '0') <= 9; ++p) {
+        any = true;
+        if (m == 0 && *p == '0') continue; // 先頭の 0 は桁数に数えない
+        if (++nd > 19) return false;
+        m = m * 10 + static_cast<unsigned>(*p - '0');
+    }
+    if (p < e && *p == '.') {
+        for (++p; p < e && static_cast<unsigned>(*p - '0') <= 9; ++p) {
+            any = true;
+            --exp10;
+            if (m == 0 && *p == '0') continue;
+            if (++nd > 19) return false;
+            m = m * 10 + static_cast<unsigned>(*p - '0');
+        }
+    }
+    if (!any) return false;
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool eneg = false;
+        if (p < e && (*p == '+' || *p == '-')) { eneg = *p == '-'; ++p; }
+        if (p == e) return false;
+        int ev = 0;
+        for (; p < e && static_cast<unsigned>(*p - '0') <= 9; ++p) {
+            if (ev < 100000) ev = ev * 10 + (*p - '0');
+        }
+        exp10 += eneg ? -ev : ev;
+    }
+    if (p != e) return false;
+    if (m > (static_cast<uint64_t>(1) << 53)) return false;
+    double v = static_cast<double>(m);
+    if (m != 0) {
+        if (exp10 < -22 || exp10 > 22) return false;
+        v = exp10 < 0 ? v / p10[-exp10] : v * p10[exp10];
+    }
+    out = neg ? -v : v;
+    return true;
+}
+
+/**
+  * Formats v exactly like printf("%g", v) / the default ostream << double
+  * (6 significant digits) and returns the number of chars written.
+  * Positive values in [1e-4, 1e22) are formatted with integer arithmetic;
+  * everything else, and values that land within rounding error of a tie,
+  * go through sprintf. out needs room for 32 chars.
+*/
+inline int formatDoubleG(double v, char* out) {
+    static const double p10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (!(v >= 1e-4 && v < 1e22))
+        return std::sprintf(out, "%g", v);
+    // x: 10^x <= v < 10^(x+1) の見積もり、r = v * 10^(5-x) を [1e5, 1e6) に入れる
+    int x = 0;
+    if (v >= 1.0) {
+        while (x < 22 && v >= p10[x + 1]) ++x;
+    } else {
+        while (x > -4 && v * p10[-x] < 1.0) --x;
+    }
+    double r = 0.0;
+    for (int tries = 0; tries < 3; ++tries) {
+        r = (x <= 5) ? v * p10[5 - x] : v / p10[x - 5]; // 丸めは 1 回だけ
+        if (r < 1e5 && x > -4) { --x; continue; }
+        if (r >= 1e6 && x < 22) { ++x; continue; }
+        break;
+    }
+    if (r < 1e5 || r >= 1e6)
+        return std::sprintf(out, "%g", v);
+    long q = static_cast<long>(r);
+    const double frac = r - static_cast<double>(q);
+    if (frac > 0.5 - 1e-9 && frac < 0.5 + 1e-9) // 丸めの境界は printf に任せる
+        return std::sprintf(out, "%g", v);
+    if (frac > 0.5) ++q;
+    if (q == 1000000) { q = 100000; ++x; }
+
+    char dig[6];
+    for (int i = 5; i >= 0; --i) { dig[i] = static_cast<char>('0' + q % 10); q /= 10; }
+    int nd = 6;
+    while (nd > 1 && dig[nd - 1] == '0') --nd; // %g は末尾の 0 を落とす
+
+    int n = 0;
+    if (x >= 6) { // d.ddddde+XX
+        out[n++] = dig[0];
+        if (nd > 1) {
+            out[n++] = '.';
+            for (int i = 1; i < nd; ++i) out[n++] = dig[i];
+        }
+        out[n++] = 'e';
+        out[n++] = '+';
+        out[n++] = static_cast<char>('0' + x / 10);
+        out[n++] = static_cast<char>('0' + x % 10);
+    } else if (x >= 0) {
+        for (int i = 0; i <= x; ++i) out[n++] = dig[i];
+        if (nd > x + 1) {
+            out[n++] = '.';
+            for (int i = x + 1; i < nd; ++i) out[n++] = dig[i];
+        }
+    } else {
+        out[n++] = '0';
+        out[n++] = '.';
+        for (int i = -1; i > x; --i) out[n++] = '0';
+        for (int i = 0; i < nd; ++i) out[n++] = dig[i];
+    }
+    out[n] = '\0';
+    return n;
+}
+
 #endif
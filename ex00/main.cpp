@@ -1,26 +1,80 @@
 #include "BitcoinExchange.hpp"
+#include "QueryServer.hpp"
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <cstdlib> // strtod (C++98 には std::stod がない)
+#include <cstring>  // memset
+#include <unistd.h> // sysconf
+#include <csignal>  // sigaction
+
+// BTC_THREADS があればそれを使い、なければオンラインの CPU 数
+static unsigned workerThreads() {
+    const char* env = std::getenv("BTC_THREADS");
+    if (env && std::atoi(env) > 0) return static_cast<unsigned>(std::atoi(env));
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned>(n) : 1;
+}
 
 static void printError(const std::string& msg){
     std::cerr << "Error: " << msg << '\n';
 }
 
+static QueryServer* g_server = 0;
+
+static void onStopSignal(int) {
+    if (g_server) g_server->stop();
+}
+
+/**
+  * btc --serve <socket>  : answers "date | value" lines on a Unix socket
+  * btc --serve -         : same protocol on stdin/stdout
+  * Runs until SIGINT/SIGTERM (socket) or EOF (stdin).
+*/
+static int serve(const BitcoinExchange& app, const std::string& where) {
+    std::signal(SIGPIPE, SIG_IGN);
+    QueryServer server(app);
+    if (where == "-") {
+        server.serveStream(0, 1);
+        return 0;
+    }
+    server.listenUnix(where);
+    g_server = &server;
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+    server.run();
+    g_server = 0;
+    return 0;
+}
+
 int main(int argc, char** argv) {
+    if (argc == 3 && std::string(argv[1]) == "--serve") {
+        try {
+            BitcoinExchange app(std::string("data.csv"), RateTable::FLAT);
+            return serve(app, argv[2]);
+        } catch (const std::exception& e) {
+            printError(e.what());
+            return 1;
+        }
+    }
     if (argc != 2) { printError("could not open file."); return 1; }
 
-    // レビューでどうなるか不明だけど、いったん同じディレクトリにdata.csvを置く
-    std::ifstream db("data.csv");
-    if (!db) { printError("could not open data.csv"); return 1; }
+    try {
+        // レビューでどうなるか不明だけど、いったん同じディレクトリにdata.csvを置く
+        // FLAT は日付として正しくない data.csv の行を捨てる (MAP は文字列キーで残していた)
+        BitcoinExchange app(std::string("data.csv"), RateTable::FLAT);
 
-    std::ifstream in(argv[1]);
-    if (!in) { printError("could not open file."); return 1; }
+        std::ifstream in(argv[1]);
+        if (!in) { printError("could not open file."); return 1; }
 
-    BitcoinExchange app(db);
-    app.run(in, std::cout, std::cerr);
-    db.close();
-    in.close();
+        in.close();
+        app.runParallel(argv[1], std::cout, std::cerr, workerThreads());
+    } catch (const std::exception& e) {
+        printError(e.what());
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
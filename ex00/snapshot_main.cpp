@@ -0,0 +1,24 @@
+// data.csv -> data.csv.snap 変換ツール
+// btc は新しい snapshot があれば CSV をパースせずにそちらを mmap する
+#include "RateTable.hpp"
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " <data.csv> [output.snap]" << std::endl;
+        return 1;
+    }
+    const std::string csv = argv[1];
+    const std::string out = argc == 3 ? argv[2] : csv + ".snap";
+    try {
+        RateTable table(RateTable::FLAT);
+        table.loadFile(csv);
+        table.saveSnapshot(out, csv);
+        std::cout << out << ": " << table.size() << " rows" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
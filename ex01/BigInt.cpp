@@ -0,0 +1,203 @@
+#include "BigInt.hpp"
+#include <cstdio>    // sprintf
+#include <stdexcept>
+
+const uint32_t BigInt::kBase;
+
+BigInt::BigInt() : negative_(false) {}
+BigInt::~BigInt() {}
+BigInt::BigInt(const BigInt& src) : negative_(src.negative_), mag_(src.mag_) {}
+BigInt& BigInt::operator=(const BigInt& src) {
+    if (this != &src) {
+        this->negative_ = src.negative_;
+        this->mag_ = src.mag_;
+    }
+    return *this;
+}
+
+BigInt::BigInt(long long v) : negative_(v < 0) {
+    // LLONG_MIN も符号を反転できるように unsigned で絶対値を取る
+    unsigned long long m = negative_ ? 0ull - static_cast<unsigned long long>(v)
+                                     : static_cast<unsigned long long>(v);
+    while (m != 0) {
+        mag_.push_back(static_cast<uint32_t>(m % kBase));
+        m /= kBase;
+    }
+}
+
+// ---- magnitude helpers ----
+
+void BigInt::trim(Mag& m) {
+    while (!m.empty() && m.back() == 0) m.pop_back();
+}
+
+BigInt BigInt::make(bool negative, const Mag& mag) {
+    BigInt r;
+    r.mag_ = mag;
+    trim(r.mag_);
+    r.negative_ = negative && !r.mag_.empty(); // -0 は作らない
+    return r;
+}
+
+int BigInt::compareMag(const Mag& a, const Mag& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (std::size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+BigInt::Mag BigInt::addMag(const Mag& a, const Mag& b) {
+    const Mag& longer = a.size() >= b.size() ? a : b;
+    const Mag& shorter = a.size() >= b.size() ? b : a;
+    Mag r(longer.size() + 1, 0);
+    uint32_t carry = 0;
+    for (std::size_t i = 0; i < longer.size(); ++i) {
+        uint32_t s = longer[i] + carry + (i < shorter.size() ? shorter[i] : 0);
+        carry = s >= kBase;
+        r[i] = carry ? s - kBase : s;
+    }
+    r[longer.size()] = carry;
+    trim(r);
+    return r;
+}
+
+BigInt::Mag BigInt::subMag(const Mag& a, const Mag& b) {
+    Mag r(a.size(), 0);
+    int64_t borrow = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        int64_t d = static_cast<int64_t>(a[i]) - borrow - (i < b.size() ? b[i] : 0);
+        borrow = d < 0;
+        r[i] = static_cast<uint32_t>(borrow ? d + kBase : d);
+    }
+    trim(r);
+    return r;
+}
+
+BigInt::Mag BigInt::mulSmall(const Mag& a, uint32_t m) {
+    Mag r(a.size() + 1, 0);
+    uint64_t carry = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        const uint64_t t = static_cast<uint64_t>(a[i]) * m + carry;
+        r[i] = static_cast<uint32_t>(t % kBase);
+        carry = t / kBase;
+    }
+    r[a.size()] = static_cast<uint32_t>(carry);
+    trim(r);
+    return r;
+}
+
+BigInt::Mag BigInt::mulMag(const Mag& a, const Mag& b) {
+    if (a.empty() || b.empty()) return Mag();
+    if (b.size() == 1) return mulSmall(a, b[0]);
+    if (a.size() == 1) return mulSmall(b, a[0]);
+    // 1 limb < 10^9 なので、積 + 途中の和は 64 bit に収まる
+    std::vector<uint64_t> acc(a.size() + b.size(), 0);
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (std::size_t j = 0; j < b.size(); ++j) {
+            const uint64_t t = acc[i + j] + static_cast<uint64_t>(a[i]) * b[j] + carry;
+            acc[i + j] = t % kBase;
+            carry = t / kBase;
+        }
+        acc[i + b.size()] += carry;
+    }
+    Mag r(acc.size());
+    for (std::size_t i = 0; i < acc.size(); ++i) r[i] = static_cast<uint32_t>(acc[i]);
+    trim(r);
+    return r;
+}
+
+// 筆算: 上の limb から 1 つずつ降ろし、商の 1 桁 (0..10^9-1) は二分探索で決める
+BigInt::Mag BigInt::divMag(const Mag& a, const Mag& b) {
+    if (compareMag(a, b) < 0) return Mag();
+    Mag q(a.size(), 0);
+    if (b.size() == 1) {
+        uint64_t rem = 0;
+        for (std::size_t i = a.size(); i-- > 0;) {
+            const uint64_t cur = rem * kBase + a[i];
+            q[i] = static_cast<uint32_t>(cur / b[0]);
+            rem = cur % b[0];
+        }
+        trim(q);
+        return q;
+    }
+    Mag rem;
+    for (std::size_t i = a.size(); i-- > 0;) {
+        rem.insert(rem.begin(), a[i]);
+        trim(rem);
+        uint32_t lo = 0, hi = kBase - 1;
+        while (lo < hi) {
+            const uint32_t mid = lo + (hi - lo + 1) / 2;
+            if (compareMag(mulSmall(b, mid), rem) <= 0)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        q[i] = lo;
+        if (lo != 0) rem = subMag(rem, mulSmall(b, lo));
+    }
+    trim(q);
+    return q;
+}
+
+// ---- arithmetic ----
+
+BigInt BigInt::operator+(const BigInt& o) const {
+    if (negative_ == o.negative_)
+        return make(negative_, addMag(mag_, o.mag_));
+    if (compareMag(mag_, o.mag_) >= 0)
+        return make(negative_, subMag(mag_, o.mag_));
+    return make(o.negative_, subMag(o.mag_, mag_));
+}
+
+BigInt BigInt::operator-(const BigInt& o) const {
+    BigInt neg(o);
+    neg.negative_ = !o.negative_ && !o.mag_.empty();
+    return *this + neg;
+}
+
+BigInt BigInt::operator*(const BigInt& o) const {
+    return make(negative_ != o.negative_, mulMag(mag_, o.mag_));
+}
+
+BigInt BigInt::operator/(const BigInt& o) const {
+    if (o.mag_.empty())
+        throw std::runtime_error("division by zero.");
+    return make(negative_ != o.negative_, divMag(mag_, o.mag_));
+}
+
+bool BigInt::isZero() const {
+    return mag_.empty();
+}
+
+bool BigInt::toLongLong(long long& out) const {
+    if (mag_.size() > 3) return false; // 10^27 以上
+    unsigned long long m = 0;
+    for (std::size_t i = mag_.size(); i-- > 0;) {
+        if (m > (~0ull - mag_[i]) / kBase) return false;
+        m = m * kBase + mag_[i];
+    }
+    const unsigned long long limit = 1ull << 63; // |LLONG_MIN|
+    if (negative_) {
+        if (m > limit) return false;
+        out = static_cast<long long>(0ull - m);
+    } else {
+        if (m >= limit) return false;
+        out = static_cast<long long>(m);
+    }
+    return true;
+}
+
+std::string BigInt::toString() const {
+    if (mag_.empty()) return "0";
+    std::string s = negative_ ? "-" : "";
+    char buf[16];
+    std::sprintf(buf, "%u", mag_.back());
+    s += buf;
+    for (std::size_t i = mag_.size() - 1; i-- > 0;) {
+        std::sprintf(buf, "%09u", mag_[i]);
+        s += buf;
+    }
+    return s;
+}
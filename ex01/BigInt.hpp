@@ -0,0 +1,49 @@
+#ifndef BIGINT_HPP
+#define BIGINT_HPP
+#include <string>
+#include <vector>
+#include <stdint.h>  // uint32_t (C++98 には <cstdint> がない)
+
+/**
+  * Arbitrary-precision signed integer for RPN's bigint mode.
+  * Sign and magnitude, magnitude in base 10^9 limbs (least significant
+  * first), so printing needs no division. Division truncates toward zero
+  * like long long division.
+*/
+class BigInt {
+public:
+    BigInt();
+    BigInt(long long v);
+    BigInt(const BigInt& src);
+    BigInt& operator=(const BigInt& src);
+    ~BigInt();
+
+    BigInt operator+(const BigInt& o) const;
+    BigInt operator-(const BigInt& o) const;
+    BigInt operator*(const BigInt& o) const;
+    /** @throws std::runtime_error("division by zero.") */
+    BigInt operator/(const BigInt& o) const;
+
+    bool isZero() const;
+    /** @return true and the value in out if it fits in a long long */
+    bool toLongLong(long long& out) const;
+    std::string toString() const;
+
+private:
+    typedef std::vector<uint32_t> Mag;
+    static const uint32_t kBase = 1000000000u;
+
+    static int compareMag(const Mag& a, const Mag& b);
+    static Mag addMag(const Mag& a, const Mag& b);
+    static Mag subMag(const Mag& a, const Mag& b);  // requires |a| >= |b|
+    static Mag mulMag(const Mag& a, const Mag& b);
+    static Mag divMag(const Mag& a, const Mag& b);
+    static Mag mulSmall(const Mag& a, uint32_t m);
+    static void trim(Mag& m);
+    static BigInt make(bool negative, const Mag& mag);
+
+    bool negative_;
+    Mag mag_;   // empty == 0
+};
+
+#endif // BIGINT_HPP
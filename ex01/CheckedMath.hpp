@@ -0,0 +1,56 @@
+#ifndef CHECKEDMATH_HPP
+#define CHECKEDMATH_HPP
+#include <stdexcept>
+#include <limits>
+
+/**
+  * Overflow-checked long long arithmetic for the RPN evaluators, built on
+  * the GCC/Clang __builtin_*_overflow intrinsics (one add/sub/imul plus a
+  * jump on the overflow flag). The error branches are marked unlikely and
+  * the throws live in out-of-line cold functions, so the fast path stays
+  * a few instructions with a never-taken branch.
+  *
+  * Operand order follows RPN::processOperator: the result is b op a,
+  * where a is the value on top of the stack.
+*/
+
+__attribute__((noreturn, noinline, cold))
+inline void throwOverflow(const char* what) {
+    throw std::overflow_error(what);
+}
+
+__attribute__((noreturn, noinline, cold))
+inline void throwDivisionByZero() {
+    throw std::runtime_error("division by zero.");
+}
+
+inline long long checkedAdd(long long b, long long a) {
+    long long r;
+    if (__builtin_expect(__builtin_add_overflow(b, a, &r), 0))
+        throwOverflow("addition overflow");
+    return r;
+}
+
+inline long long checkedSub(long long b, long long a) {
+    long long r;
+    if (__builtin_expect(__builtin_sub_overflow(b, a, &r), 0))
+        throwOverflow("subtraction overflow");
+    return r;
+}
+
+inline long long checkedMul(long long b, long long a) {
+    long long r;
+    if (__builtin_expect(__builtin_mul_overflow(b, a, &r), 0))
+        throwOverflow("multiplication overflow");
+    return r;
+}
+
+inline long long checkedDiv(long long b, long long a) {
+    if (__builtin_expect(a == 0, 0))
+        throwDivisionByZero();
+    if (__builtin_expect(b == std::numeric_limits<long long>::min() && a == -1, 0))
+        throwOverflow("division overflow: LLONG_MIN / -1");
+    return b / a;
+}
+
+#endif // CHECKEDMATH_HPP
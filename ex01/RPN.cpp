@@ -1,4 +1,7 @@
 #include "RPN.hpp"
+#include "CheckedMath.hpp"
+#include "BigInt.hpp"
+#include <vector>
 
 RPN::RPN() {}
 RPN::~RPN() {}
@@ -14,27 +17,13 @@ bool RPN::isOperator(char c) {
     return c == '+' || c == '-' || c == '*' || c == '/';
 }
 
-bool willMulOverflow(long long a, long long b) {
-    if (a == 0 || b == 0) return false;
-    __int128 t = static_cast<__int128>(a) * static_cast<__int128>(b);
-    return ( t > std::numeric_limits<long long>::max() ||
-           t < std::numeric_limits<long long>::min());
-}
-
+// 4 つとも CheckedMath.hpp の __builtin_*_overflow で検査する
 long long RPN::processOperator(char op, long long a, long long b) {
     switch (op) {
-        case '+': return b + a;
-        case '-': return b - a;
-        case '*':
-            if (willMulOverflow(b, a))
-                throw std::overflow_error("multiplication overflow");
-            return b * a;
-        case '/':
-            if (a == 0)
-                throw std::runtime_error("division by zero.");
-            if (b == std::numeric_limits<long long>::min() && a == -1)
-                throw std::overflow_error("division overflow: LLONG_MIN / -1");
-            return b / a;
+        case '+': return checkedAdd(b, a);
+        case '-': return checkedSub(b, a);
+        case '*': return checkedMul(b, a);
+        case '/': return checkedDiv(b, a);
         default:
             throw std::runtime_error(std::string("unknown operator: ") + op);
             return 0;
@@ -44,25 +33,96 @@ long long RPN::processOperator(char op, long long a, long long b) {
 void RPN::parseAndPushToken(const std::string& expresstion) {
     std::stringstream ss(expresstion);
     std::string token;
-    std::stack<long long, std::list<long long> > st;
+    RPNStack st; // 浅い式はヒープを使わない
 
     while (ss >> token) {
         if (std::isdigit(token[0])) {
             if (token.size() > 1) throw std::runtime_error("invalid token: " + token);
             st.push(token[0] - '0');
+        } else if (isOperator(token[0]) && token.size() == 1) {
+            long long a, b;
+            st.pop2(a, b);
+            st.push(processOperator(token[0], a, b));
+        } else {
+            throw std::runtime_error("invalid token: " + token);
+        }
+    }
+    std::cout << st.result() << std::endl;
+}
+// ========= bigint mode =========
+
+namespace {
+// long long に収まる間は small だけを使い、BigInt は空のまま (確保しない)
+struct Value {
+    bool big;
+    long long small;
+    BigInt value;
+};
+
+// 収まれば long long に戻す
+void setResult(Value& v, const BigInt& r) {
+    v.big = !r.toLongLong(v.small);
+    v.value = v.big ? r : BigInt();
+}
+
+BigInt toBig(const Value& v) {
+    return v.big ? v.value : BigInt(v.small);
+}
+}
+
+std::string RPN::evaluateBigInt(const std::string& expression) {
+    std::stringstream ss(expression);
+    std::string token;
+    std::vector<Value> st;
+
+    while (ss >> token) {
+        if (std::isdigit(token[0])) {
+            if (token.size() > 1) throw std::runtime_error("invalid token: " + token);
+            Value v;
+            v.big = false;
+            v.small = token[0] - '0';
+            st.push_back(v);
         } else if (isOperator(token[0]) && token.size() == 1) {
             if (st.size() < 2)
                 throw std::runtime_error("insufficient values in expression.");
-            long long a = st.top();
-            st.pop();
-            long long b = st.top();
-            st.pop();
-            st.push(processOperator(token[0], a, b));
+            const Value a = st.back();
+            st.pop_back();
+            Value& b = st.back();
+            if (!a.big && !b.big) {
+                long long r;
+                bool overflow;
+                switch (token[0]) {
+                    case '+': overflow = __builtin_add_overflow(b.small, a.small, &r); break;
+                    case '-': overflow = __builtin_sub_overflow(b.small, a.small, &r); break;
+                    case '*': overflow = __builtin_mul_overflow(b.small, a.small, &r); break;
+                    default:
+                        if (a.small == 0)
+                            throw std::runtime_error("division by zero.");
+                        overflow = b.small == std::numeric_limits<long long>::min()
+                                   && a.small == -1;
+                        r = overflow ? 0 : b.small / a.small;
+                        break;
+                }
+                if (!overflow) {
+                    b.small = r;
+                    continue;
+                }
+            }
+            const BigInt x = toBig(b), y = toBig(a);
+            switch (token[0]) {
+                case '+': setResult(b, x + y); break;
+                case '-': setResult(b, x - y); break;
+                case '*': setResult(b, x * y); break;
+                default:  setResult(b, x / y); break;
+            }
         } else {
             throw std::runtime_error("invalid token: " + token);
         }
     }
     if (st.size() != 1)
         throw std::runtime_error("the input has too many values.");
-    std::cout << st.top() << std::endl;
-}
\ No newline at end of file
+    if (st[0].big) return st[0].value.toString();
+    std::ostringstream out;
+    out << st[0].small;
+    return out.str();
+}
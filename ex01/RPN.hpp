@@ -9,8 +9,12 @@
 #include <iostream>
 #include <limits>
 #include <list>
+#include "RPNStack.hpp"
 
 class RPN {
+    friend class RPNProgram; // processOperator を共有する
+    friend class RPNStream;
+    friend class RPNDag;
 private:
     RPN();
     RPN(const RPN&);
@@ -22,6 +26,15 @@ private:
 
 public:
     static void parseAndPushToken(const std::string& expresstion);
+    /**
+      * Bigint mode (opt-in): same tokens and errors as parseAndPushToken,
+      * but a result that does not fit in a long long is promoted to a
+      * BigInt instead of throwing, and demoted again once it fits.
+      * Values that fit stay on the long long fast path.
+      * @return the result in decimal
+      * @throws std::runtime_error for syntax errors and division by zero
+    */
+    static std::string evaluateBigInt(const std::string& expression);
 };
 
 #endif // RPN_HPP
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "RPNDag.hpp"
+#include "RPNProgram.hpp"
+#include "RPN.hpp"
+#include <algorithm> // copy
+#include <map>
+
+RPNDag::RPNDag() : tokens_(0), result_(0) {}
+RPNDag::~RPNDag() {}
+RPNDag::RPNDag(const RPNDag& src)
+    : init_(src.init_), loads_(src.loads_), steps_(src.steps_),
+      tokens_(src.tokens_), result_(src.result_) {}
+RPNDag& RPNDag::operator=(const RPNDag& src) {
+    if (this != &src) {
+        this->init_ = src.init_;
+        this->loads_ = src.loads_;
+        this->steps_ = src.steps_;
+        this->tokens_ = src.tokens_;
+        this->result_ = src.result_;
+    }
+    return *this;
+}
+
+namespace {
+enum Kind { NODE_CONST, NODE_VAR, NODE_OP };
+
+// 同じ Node は 1 つだけ作る (hash-consing)。op の子は自分より前に作られている
+struct Node {
+    Kind kind;
+    unsigned char op;
+    long long value;    // NODE_CONST: 値, NODE_VAR: 変数番号
+    unsigned b;
+    unsigned a;
+
+    bool operator<(const Node& o) const {
+        if (kind != o.kind) return kind < o.kind;
+        if (op != o.op) return op < o.op;
+        if (value != o.value) return value < o.value;
+        if (b != o.b) return b < o.b;
+        return a < o.a;
+    }
+};
+
+class DagBuilder {
+public:
+    unsigned constant(long long v) {
+        Node n = {NODE_CONST, 0, v, 0, 0};
+        return intern(n);
+    }
+    unsigned variable(unsigned v) {
+        Node n = {NODE_VAR, 0, static_cast<long long>(v), 0, 0};
+        return intern(n);
+    }
+    // b op a (定数同士は呼ぶ前に畳み込んでおくこと)
+    unsigned binary(unsigned char op, unsigned b, unsigned a) {
+        // + と * は可換なので子の順番をそろえる (wrap も overflow 判定も対称)
+        if ((op == RPNProgram::OP_ADD || op == RPNProgram::OP_MUL) && b > a) {
+            const unsigned t = b;
+            b = a;
+            a = t;
+        }
+        Node n = {NODE_OP, op, 0, b, a};
+        return intern(n);
+    }
+    const Node& operator[](unsigned id) const { return nodes_[id]; }
+    const std::vector<Node>& nodes() const { return nodes_; }
+
+private:
+    unsigned intern(const Node& n) {
+        std::map<Node, unsigned>::iterator it = index_.find(n);
+        if (it != index_.end()) return it->second;
+        const unsigned id = static_cast<unsigned>(nodes_.size());
+        nodes_.push_back(n);
+        index_.insert(std::make_pair(n, id));
+        return id;
+    }
+
+    std::vector<Node> nodes_;
+    std::map<Node, unsigned> index_;
+};
+}
+
+RPNDag RPNDag::optimize(const std::string& expression) {
+    static const char chars[4] = {'+', '-', '*', '/'};
+    const RPNProgram prog = RPNProgram::compile(expression); // トークンとスタックの検査
+    DagBuilder builder;
+    std::vector<unsigned> stack;
+    for (std::size_t i = 0; i < prog.code_.size(); ++i) {
+        const unsigned char op = prog.code_[i];
+        if (op <= RPNProgram::OP_PUSH9) {
+            stack.push_back(builder.constant(op));
+        } else if (op >= RPNProgram::OP_VAR0) {
+            stack.push_back(builder.variable(op - RPNProgram::OP_VAR0));
+        } else {
+            const unsigned a = stack.back();
+            stack.pop_back();
+            const unsigned b = stack.back();
+            if (builder[a].kind == NODE_CONST && builder[b].kind == NODE_CONST)
+                stack.back() = builder.constant(RPN::processOperator(
+                    chars[op - RPNProgram::OP_ADD], builder[a].value, builder[b].value));
+            else
+                stack.back() = builder.binary(op, b, a);
+        }
+    }
+
+    // 畳み込まれて使われなくなった定数などを捨て、残った node に slot を振る
+    const std::vector<Node>& nodes = builder.nodes();
+    const unsigned root = stack.back();
+    std::vector<char> live(nodes.size(), 0);
+    live[root] = 1;
+    for (std::size_t i = nodes.size(); i-- > 0;) {
+        if (live[i] && nodes[i].kind == NODE_OP) {
+            live[nodes[i].b] = 1;
+            live[nodes[i].a] = 1;
+        }
+    }
+    RPNDag dag;
+    dag.tokens_ = prog.size();
+    std::vector<unsigned> slot(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        if (!live[i]) continue;
+        const Node& n = nodes[i];
+        slot[i] = static_cast<unsigned>(dag.init_.size());
+        dag.init_.push_back(n.kind == NODE_CONST ? n.value : 0);
+        if (n.kind == NODE_VAR) {
+            Load l = {slot[i], static_cast<unsigned>(n.value)};
+            dag.loads_.push_back(l);
+        } else if (n.kind == NODE_OP) {
+            Step s = {n.op, slot[i], slot[n.b], slot[n.a]};
+            dag.steps_.push_back(s);
+        }
+    }
+    dag.result_ = slot[root];
+    return dag;
+}
+
+long long RPNDag::evaluate() const {
+    if (!loads_.empty())
+        throw std::runtime_error("unbound variable.");
+    return evaluateWith(0);
+}
+
+long long RPNDag::evaluateWith(const long long* vars) const {
+    static const std::size_t kInlineSlots = 256;
+    if (init_.empty()) // default-constructed
+        throw std::runtime_error("the input has too many values.");
+    if (!loads_.empty() && vars == 0)
+        throw std::runtime_error("unbound variable.");
+    if (init_.size() <= kInlineSlots) {
+        long long slots[kInlineSlots];
+        return run(vars, slots);
+    }
+    std::vector<long long> slots(init_.size());
+    return run(vars, &slots[0]);
+}
+
+long long RPNDag::run(const long long* vars, long long* slots) const {
+    static const char ops[4] = {'+', '-', '*', '/'};
+    std::copy(init_.begin(), init_.end(), slots);
+    for (std::size_t i = 0; i < loads_.size(); ++i)
+        slots[loads_[i].slot] = vars[loads_[i].var];
+    const Step* s = steps_.empty() ? 0 : &steps_[0];
+    const Step* const end = s + steps_.size();
+    for (; s != end; ++s)
+        slots[s->dst] = RPN::processOperator(ops[s->op - RPNProgram::OP_ADD],
+                                             slots[s->a], slots[s->b]);
+    return slots[result_];
+}
+
+std::size_t RPNDag::nodesBefore() const {
+    return tokens_;
+}
+
+std::size_t RPNDag::nodesAfter() const {
+    return init_.size();
+}
+
+std::size_t RPNDag::operations() const {
+    return steps_.size();
+}
@@ -0,0 +1,69 @@
+#ifndef RPNDAG_HPP
+#define RPNDAG_HPP
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+  * Optimized form of an RPN expression. The token tree is turned into a
+  * DAG in which
+  *   - operators whose operands are both constants are folded with
+  *     RPN::processOperator, so overflow and division by zero in constant
+  *     subtrees are reported by optimize() instead of at every evaluation;
+  *   - identical subexpressions (also a+b / b+a and a*b / b*a) become one
+  *     node and are computed once per evaluation.
+  * The remaining nodes are evaluated in the order their first occurrence
+  * appears in the expression, into one slot per node, so results and
+  * runtime errors are the same as RPNProgram::evaluateWith().
+*/
+class RPNDag {
+public:
+    RPNDag();
+    RPNDag(const RPNDag& src);
+    RPNDag& operator=(const RPNDag& src);
+    ~RPNDag();
+
+    /**
+      * @throws std::runtime_error with RPNProgram::compile()'s messages
+      * @throws std::overflow_error / std::runtime_error from RPN::processOperator
+      *         if a constant subtree fails
+    */
+    static RPNDag optimize(const std::string& expression);
+
+    /** @throws std::runtime_error("unbound variable.") if variables are used */
+    long long evaluate() const;
+    /**
+      * Evaluates with variable values vars[RPNProgram::variableIndex(name)].
+      * @throws std::overflow_error / std::runtime_error from RPN::processOperator
+    */
+    long long evaluateWith(const long long* vars) const;
+
+    /** @return nodes of the expression tree (= tokens) */
+    std::size_t nodesBefore() const;
+    /** @return nodes left in the DAG (constants, variables, operators) */
+    std::size_t nodesAfter() const;
+    /** @return operators evaluated per evaluate() call */
+    std::size_t operations() const;
+
+private:
+    long long run(const long long* vars, long long* slots) const;
+
+    struct Step {
+        unsigned char op;       // RPNProgram::OP_ADD..OP_DIV
+        unsigned dst;
+        unsigned b;             // b op a (b: the deeper operand)
+        unsigned a;
+    };
+    struct Load {
+        unsigned slot;
+        unsigned var;
+    };
+
+    std::vector<long long> init_;   // constants already in their slots
+    std::vector<Load> loads_;       // variables copied in before the steps
+    std::vector<Step> steps_;
+    std::size_t tokens_;
+    unsigned result_;               // slot of the root
+};
+
+#endif // RPNDAG_HPP
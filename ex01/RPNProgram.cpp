@@ -0,0 +1,205 @@
+#include "RPNProgram.hpp"
+#include "RPN.hpp"
+
+const std::size_t RPNProgram::kNumVariables;
+
+RPNProgram::RPNProgram() : maxDepth_(0), varMask_(0) {}
+RPNProgram::~RPNProgram() {}
+RPNProgram::RPNProgram(const RPNProgram& src)
+    : code_(src.code_), maxDepth_(src.maxDepth_), varMask_(src.varMask_) {}
+RPNProgram& RPNProgram::operator=(const RPNProgram& src) {
+    if (this != &src) {
+        this->code_ = src.code_;
+        this->maxDepth_ = src.maxDepth_;
+        this->varMask_ = src.varMask_;
+    }
+    return *this;
+}
+
+int RPNProgram::variableIndex(const std::string& token) {
+    if (token == "x") return 0;
+    if (token == "y") return 1;
+    if (token.size() == 2 && token[0] == 'a' && std::isdigit(token[1]))
+        return 2 + (token[1] - '0');
+    return -1;
+}
+
+bool RPNProgram::usesVariable(std::size_t v) const {
+    return v < kNumVariables && (varMask_ >> v & 1u) != 0;
+}
+
+// トークンの切り方とエラーメッセージは RPN::parseAndPushToken と同じ
+RPNProgram RPNProgram::compile(const std::string& expression) {
+    std::stringstream ss(expression);
+    std::string token;
+    RPNProgram prog;
+    std::size_t depth = 0;
+
+    while (ss >> token) {
+        if (std::isdigit(token[0])) {
+            if (token.size() > 1) throw std::runtime_error("invalid token: " + token);
+            prog.code_.push_back(static_cast<unsigned char>(OP_PUSH0 + (token[0] - '0')));
+            if (++depth > prog.maxDepth_) prog.maxDepth_ = depth;
+        } else if (variableIndex(token) >= 0) {
+            const int v = variableIndex(token);
+            prog.code_.push_back(static_cast<unsigned char>(OP_VAR0 + v));
+            prog.varMask_ |= 1u << v;
+            if (++depth > prog.maxDepth_) prog.maxDepth_ = depth;
+        } else if (token.size() == 1 && RPN::isOperator(token[0])) {
+            if (depth < 2)
+                throw std::runtime_error("insufficient values in expression.");
+            --depth;
+            switch (token[0]) {
+                case '+': prog.code_.push_back(OP_ADD); break;
+                case '-': prog.code_.push_back(OP_SUB); break;
+                case '*': prog.code_.push_back(OP_MUL); break;
+                default:  prog.code_.push_back(OP_DIV); break;
+            }
+        } else {
+            throw std::runtime_error("invalid token: " + token);
+        }
+    }
+    if (depth != 1)
+        throw std::runtime_error("the input has too many values.");
+    return prog;
+}
+
+long long RPNProgram::evaluate() const {
+    return evaluateWith(0);
+}
+
+long long RPNProgram::evaluateWith(const long long* vars) const {
+    static const std::size_t kInlineDepth = 256;
+    if (maxDepth_ <= kInlineDepth) {
+        long long stack[kInlineDepth];
+        return evaluate(vars, stack);
+    }
+    std::vector<long long> stack(maxDepth_);
+    return evaluate(vars, &stack[0]);
+}
+
+long long RPNProgram::evaluate(long long* stack) const {
+    return evaluate(0, stack);
+}
+
+// compile 済みなので深さのチェックは不要。sp は次に push する位置
+long long RPNProgram::evaluate(const long long* vars, long long* stack) const {
+    static const char ops[4] = {'+', '-', '*', '/'};
+    if (code_.empty()) // default-constructed
+        throw std::runtime_error("the input has too many values.");
+    if (varMask_ != 0 && vars == 0)
+        throw std::runtime_error("unbound variable.");
+    long long* sp = stack;
+    const unsigned char* pc = &code_[0];
+    const unsigned char* const end = pc + code_.size();
+    for (; pc != end; ++pc) {
+        const unsigned char op = *pc;
+        if (op <= OP_PUSH9) {
+            *sp++ = op;
+            continue;
+        }
+        if (op >= OP_VAR0) {
+            *sp++ = vars[op - OP_VAR0];
+            continue;
+        }
+        const long long a = *--sp;
+        sp[-1] = RPN::processOperator(ops[op - OP_ADD], a, sp[-1]);
+    }
+    return stack[0];
+}
+
+// ---- batch evaluation ----
+//
+// 1 ブロック = kLanes 行。スタックは深さごとに kLanes 個の列を持ち、
+// 命令ごとに全レーンをまとめて処理する (b = 下の段, a = 上の段, b op a -> b)
+
+static const std::size_t kLanes = 64;
+
+// 符号ビットで overflow を判定する (__builtin_add_overflow と同じ結果で、ベクトル化できる)
+static void laneAdd(long long* b, const long long* a, unsigned char* err, std::size_t m) {
+    for (std::size_t i = 0; i < m; ++i) {
+        const long long r = static_cast<long long>(static_cast<unsigned long long>(b[i])
+                                                   + static_cast<unsigned long long>(a[i]));
+        const bool ov = ((b[i] ^ r) & (a[i] ^ r)) < 0;
+        err[i] = err[i] ? err[i] : (ov ? RPNProgram::LANE_ADD_OVERFLOW : 0);
+        b[i] = r;
+    }
+}
+
+static void laneSub(long long* b, const long long* a, unsigned char* err, std::size_t m) {
+    for (std::size_t i = 0; i < m; ++i) {
+        const long long r = static_cast<long long>(static_cast<unsigned long long>(b[i])
+                                                   - static_cast<unsigned long long>(a[i]));
+        const bool ov = ((b[i] ^ a[i]) & (b[i] ^ r)) < 0;
+        err[i] = err[i] ? err[i] : (ov ? RPNProgram::LANE_SUB_OVERFLOW : 0);
+        b[i] = r;
+    }
+}
+
+static void laneMul(long long* b, const long long* a, unsigned char* err, std::size_t m) {
+    for (std::size_t i = 0; i < m; ++i) {
+        long long r;
+        const bool ov = __builtin_mul_overflow(b[i], a[i], &r);
+        err[i] = err[i] ? err[i] : (ov ? RPNProgram::LANE_MUL_OVERFLOW : 0);
+        b[i] = r;
+    }
+}
+
+static void laneDiv(long long* b, const long long* a, unsigned char* err, std::size_t m) {
+    const long long kMin = std::numeric_limits<long long>::min();
+    for (std::size_t i = 0; i < m; ++i) {
+        const bool zero = a[i] == 0;
+        const bool ov = b[i] == kMin && a[i] == -1;
+        const unsigned char e = zero ? RPNProgram::LANE_DIV_BY_ZERO
+                              : ov ? RPNProgram::LANE_DIV_OVERFLOW : 0;
+        err[i] = err[i] ? err[i] : e;
+        b[i] = (zero || ov) ? 0 : b[i] / a[i];
+    }
+}
+
+void RPNProgram::evaluateBatch(const long long* const* columns, std::size_t n,
+                               long long* out, unsigned char* errors) const {
+    if (code_.empty())
+        throw std::runtime_error("the input has too many values.");
+    if (varMask_ != 0 && columns == 0)
+        throw std::runtime_error("unbound variable.");
+    std::vector<long long> scratch(maxDepth_ * kLanes);
+    long long* const stack = &scratch[0];
+    const unsigned char* const begin = &code_[0];
+    const unsigned char* const end = begin + code_.size();
+
+    for (std::size_t start = 0; start < n; start += kLanes) {
+        const std::size_t m = n - start < kLanes ? n - start : kLanes;
+        unsigned char* err = errors + start;
+        for (std::size_t i = 0; i < m; ++i) err[i] = LANE_OK;
+        long long* top = stack; // 次に push する段
+        for (const unsigned char* pc = begin; pc != end; ++pc) {
+            const unsigned char op = *pc;
+            if (op <= OP_PUSH9) {
+                for (std::size_t i = 0; i < m; ++i) top[i] = op;
+                top += kLanes;
+                continue;
+            }
+            if (op >= OP_VAR0) {
+                const long long* col = columns[op - OP_VAR0] + start;
+                for (std::size_t i = 0; i < m; ++i) top[i] = col[i];
+                top += kLanes;
+                continue;
+            }
+            top -= kLanes;
+            long long* b = top - kLanes;
+            switch (op) {
+                case OP_ADD: laneAdd(b, top, err, m); break;
+                case OP_SUB: laneSub(b, top, err, m); break;
+                case OP_MUL: laneMul(b, top, err, m); break;
+                default:     laneDiv(b, top, err, m); break;
+            }
+        }
+        for (std::size_t i = 0; i < m; ++i)
+            out[start + i] = err[i] ? 0 : stack[i];
+    }
+}
+
+std::size_t RPNProgram::size() const { return code_.size(); }
+
+std::size_t RPNProgram::maxDepth() const { return maxDepth_; }
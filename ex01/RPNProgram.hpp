@@ -0,0 +1,99 @@
+#ifndef RPNPROGRAM_HPP
+#define RPNPROGRAM_HPP
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/**
+  * An RPN expression compiled once and evaluated any number of times.
+  * compile() tokenizes like RPN::parseAndPushToken and checks the stack
+  * effect of every token up front, so evaluate() runs a byte-per-token
+  * loop with no allocation and no per-token validation. Arithmetic goes
+  * through RPN::processOperator, so overflow and division by zero throw
+  * the same exceptions as the interpreter.
+  *
+  * Besides single digits, compiled programs accept the variables x, y and
+  * a0..a9. Their values are passed to evaluate() by variable index, or as
+  * one column per variable to evaluateBatch().
+*/
+class RPNProgram {
+    friend class RPNDag; // code_ から DAG を作る
+public:
+    // 1 命令 = 1 byte。0-9 はその数字を push する
+    enum Op {
+        OP_PUSH0 = 0,
+        OP_PUSH9 = 9,
+        OP_ADD,
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_VAR0         // OP_VAR0 + variableIndex()
+    };
+    /** x, y, a0..a9 */
+    static const std::size_t kNumVariables = 12;
+
+    /** Per-lane result of evaluateBatch(): the first error hit in that lane. */
+    enum LaneError {
+        LANE_OK = 0,
+        LANE_DIV_BY_ZERO,    // "division by zero."
+        LANE_MUL_OVERFLOW,   // "multiplication overflow"
+        LANE_DIV_OVERFLOW,   // "division overflow: LLONG_MIN / -1"
+        LANE_ADD_OVERFLOW,   // "addition overflow"
+        LANE_SUB_OVERFLOW    // "subtraction overflow"
+    };
+
+    RPNProgram();
+    RPNProgram(const RPNProgram& src);
+    RPNProgram& operator=(const RPNProgram& src);
+    ~RPNProgram();
+
+    /**
+      * @throws std::runtime_error with the interpreter's messages:
+      *         "invalid token: <tok>", "insufficient values in expression.",
+      *         "the input has too many values."
+    */
+    static RPNProgram compile(const std::string& expression);
+    /** @return index of variable token (x=0, y=1, a0..a9=2..11), or -1 */
+    static int variableIndex(const std::string& token);
+
+    /** Evaluates with a stack on the C stack (heap only if maxDepth() > 256). */
+    long long evaluate() const;
+    /**
+      * Evaluates with a caller-provided stack of at least maxDepth() slots.
+      * @throws std::overflow_error / std::runtime_error from RPN::processOperator
+    */
+    long long evaluate(long long* stack) const;
+    /**
+      * Evaluates with variable values vars[variableIndex(name)].
+      * @throws std::runtime_error("unbound variable.") if the program uses
+      *         variables and vars is null
+    */
+    long long evaluate(const long long* vars, long long* stack) const;
+    /** evaluate(vars, stack) with an internal stack. */
+    long long evaluateWith(const long long* vars) const;
+    /**
+      * Evaluates n rows at once. columns[v] holds n values of variable v
+      * (only the variables the program uses are read). The program runs
+      * over blocks of rows one instruction at a time, so push/+/- are
+      * plain vectorizable loops (overflow from the sign bits) and * and /
+      * are branch-free per lane.
+      * Errors do not throw: errors[i] gets the first LaneError of row i
+      * and out[i] is 0 for such rows.
+    */
+    void evaluateBatch(const long long* const* columns, std::size_t n,
+                       long long* out, unsigned char* errors) const;
+    /** @return true if the program reads variable index v */
+    bool usesVariable(std::size_t v) const;
+
+    /** @return number of instructions (= tokens) */
+    std::size_t size() const;
+    /** @return largest stack depth reached during evaluation */
+    std::size_t maxDepth() const;
+
+private:
+    std::vector<unsigned char> code_;
+    std::size_t maxDepth_;
+    unsigned int varMask_;  // bit v: uses variable v
+};
+
+#endif // RPNPROGRAM_HPP
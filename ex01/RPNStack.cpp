@@ -0,0 +1,65 @@
+#include "RPNStack.hpp"
+#include <algorithm> // copy
+#include <stdexcept>
+
+const std::size_t RPNStack::kInlineCapacity;
+
+RPNStack::RPNStack() : data_(inline_), size_(0), capacity_(kInlineCapacity) {}
+
+RPNStack::~RPNStack() {
+    if (spilled()) delete[] data_;
+}
+
+RPNStack::RPNStack(const RPNStack& src)
+    : data_(inline_), size_(0), capacity_(kInlineCapacity) {
+    *this = src;
+}
+
+RPNStack& RPNStack::operator=(const RPNStack& src) {
+    if (this != &src) {
+        if (src.size_ > capacity_) {
+            long long* buf = new long long[src.capacity_];
+            if (spilled()) delete[] data_;
+            data_ = buf;
+            capacity_ = src.capacity_;
+        }
+        std::copy(src.data_, src.data_ + src.size_, data_);
+        size_ = src.size_;
+    }
+    return *this;
+}
+
+// 満杯になったら倍の連続領域に移す (inline_ からは最初の 1 回だけ)
+void RPNStack::grow() {
+    long long* buf = new long long[capacity_ * 2];
+    std::copy(data_, data_ + size_, buf);
+    if (spilled()) delete[] data_;
+    data_ = buf;
+    capacity_ *= 2;
+}
+
+long long RPNStack::top() const {
+    if (size_ == 0)
+        throw std::runtime_error("insufficient values in expression.");
+    return data_[size_ - 1];
+}
+
+void RPNStack::pop() {
+    if (size_ == 0)
+        throw std::runtime_error("insufficient values in expression.");
+    --size_;
+}
+
+void RPNStack::pop2(long long& a, long long& b) {
+    if (size_ < 2)
+        throw std::runtime_error("insufficient values in expression.");
+    a = data_[size_ - 1];
+    b = data_[size_ - 2];
+    size_ -= 2;
+}
+
+long long RPNStack::result() const {
+    if (size_ != 1)
+        throw std::runtime_error("the input has too many values.");
+    return data_[0];
+}
@@ -0,0 +1,59 @@
+#ifndef RPNSTACK_HPP
+#define RPNSTACK_HPP
+#include <cstddef>
+
+/**
+  * Operand stack for RPN::parseAndPushToken.
+  * The first kInlineCapacity values live in an array inside the object, so
+  * ordinary expressions never touch the heap. Deeper expressions spill to
+  * one contiguous buffer that doubles when full (amortised O(1) push, one
+  * allocation per doubling instead of one per operand).
+  *
+  * Same push/top/pop as std::stack. pop2() and result() carry the
+  * interpreter's error checks.
+*/
+class RPNStack {
+public:
+    static const std::size_t kInlineCapacity = 64;
+
+    RPNStack();
+    RPNStack(const RPNStack& src);
+    RPNStack& operator=(const RPNStack& src);
+    ~RPNStack();
+
+    void push(long long v) {
+        if (size_ == capacity_) grow();
+        data_[size_++] = v;
+    }
+    /** @throws std::runtime_error("insufficient values in expression.") if empty */
+    long long top() const;
+    /** @throws std::runtime_error("insufficient values in expression.") if empty */
+    void pop();
+    /**
+      * Pops the two operands of a binary operator: a = top, b = below it.
+      * @throws std::runtime_error("insufficient values in expression.")
+    */
+    void pop2(long long& a, long long& b);
+    /**
+      * @return the only value left on the stack
+      * @throws std::runtime_error("the input has too many values.") if size() != 1
+    */
+    long long result() const;
+
+    /** Empties the stack, keeping any spilled buffer for reuse. */
+    void clear() { size_ = 0; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    /** @return true once the stack has left the inline array */
+    bool spilled() const { return data_ != inline_; }
+
+private:
+    void grow();
+
+    long long* data_;       // inline_ or a heap buffer
+    std::size_t size_;
+    std::size_t capacity_;
+    long long inline_[kInlineCapacity];
+};
+
+#endif // RPNSTACK_HPP
@@ -0,0 +1,328 @@
+#include "RPNStream.hpp"
+#include "RPN.hpp"
+#include <algorithm> // min
+#include <cstring>    // memchr
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>    // open
+#include <pthread.h>
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close, sysconf
+
+const std::size_t RPNStream::kBlockSize;
+const std::size_t RPNStream::kMaxTokenEcho;
+const std::size_t RPNStream::kDefaultChunkBytes;
+
+// istream の >> と同じ区切り ('\n' は行の区切りとして別に扱う)
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r';
+}
+
+RPNStream::RPNStream(std::ostream& out, std::ostream& err, unsigned long firstLine)
+    : out_(out), err_(err), line_(firstLine), lineHasTokens_(false), skipping_(false) {
+    stats_.lines = 0;
+    stats_.errors = 0;
+    stats_.tokens = 0;
+    stats_.bytes = 0;
+}
+
+RPNStream::~RPNStream() {}
+
+const RPNStream::Stats& RPNStream::stats() const {
+    return stats_;
+}
+
+void RPNStream::run(std::istream& in) {
+    std::vector<char> buf(kBlockSize);
+    while (in) {
+        in.read(&buf[0], buf.size());
+        const std::streamsize n = in.gcount();
+        if (n <= 0) break;
+        feed(&buf[0], static_cast<std::size_t>(n));
+    }
+    finish();
+}
+
+void RPNStream::fail(const std::string& message) {
+    err_ << "Error: line " << line_ << ": " << message << '\n';
+    ++stats_.errors;
+    stack_.clear();
+    skipping_ = true;
+}
+
+// [b, e) は 1 トークン。判定とエラーメッセージは RPN::parseAndPushToken と同じ
+void RPNStream::token(const char* b, const char* e) {
+    ++stats_.tokens;
+    lineHasTokens_ = true;
+    const std::size_t len = e - b;
+    try {
+        if (std::isdigit(static_cast<unsigned char>(*b))) {
+            if (len > 1) throw std::runtime_error("invalid token: " + std::string(b, e));
+            stack_.push(*b - '0');
+        } else if (len == 1 && RPN::isOperator(*b)) {
+            long long a, v;
+            stack_.pop2(a, v);
+            stack_.push(RPN::processOperator(*b, a, v));
+        } else {
+            throw std::runtime_error("invalid token: " + std::string(b, e));
+        }
+    } catch (const std::exception& ex) {
+        fail(ex.what());
+    }
+}
+
+void RPNStream::endLine() {
+    if (lineHasTokens_) {
+        ++stats_.lines;
+        if (!skipping_) {
+            try {
+                out_ << stack_.result() << '\n';
+            } catch (const std::exception& ex) {
+                fail(ex.what());
+            }
+        }
+    }
+    stack_.clear();
+    lineHasTokens_ = false;
+    skipping_ = false;
+    ++line_;
+}
+
+void RPNStream::feed(const char* p, std::size_t n) {
+    const char* const end = p + n;
+    stats_.bytes += n;
+    if (!partial_.empty()) { // 前のブロックの最後で切れたトークンの続き
+        const char* q = p;
+        while (q != end && *q != '\n' && !isBlank(*q)) ++q;
+        if (partial_.size() < kMaxTokenEcho)
+            partial_.append(p, std::min<std::size_t>(q - p, kMaxTokenEcho - partial_.size()));
+        if (q == end) return;
+        if (!skipping_) token(partial_.data(), partial_.data() + partial_.size());
+        partial_.clear();
+        p = q;
+    }
+    while (p != end) {
+        const char c = *p;
+        if (c == '\n') {
+            endLine();
+            ++p;
+            continue;
+        }
+        if (isBlank(c)) {
+            ++p;
+            continue;
+        }
+        const char* q = p + 1;
+        while (q != end && *q != '\n' && !isBlank(*q)) ++q;
+        if (q == end) { // トークンがブロックをまたぐ
+            partial_.assign(p, std::min<std::size_t>(q - p, kMaxTokenEcho));
+            return;
+        }
+        if (skipping_)
+            lineHasTokens_ = true;
+        else
+            token(p, q);
+        p = q;
+    }
+}
+
+void RPNStream::finish() {
+    if (!partial_.empty()) {
+        if (!skipping_) token(partial_.data(), partial_.data() + partial_.size());
+        partial_.clear();
+    }
+    if (lineHasTokens_) endLine();
+}
+
+// ========= runParallel =========
+
+void* RPNStream::chunkWorker(void* arg) {
+    ChunkJob* job = static_cast<ChunkJob*>(arg);
+    RPNStream stream(job->out, job->err, job->firstLine);
+    stream.feed(job->begin, job->end - job->begin);
+    stream.finish();
+    job->stats = stream.stats();
+    return 0;
+}
+
+// jobs[0] は呼び出したスレッドで、残りは 1 チャンク 1 スレッドで評価する。
+// pthread_create に失敗したチャンクも、ここで順に評価してから戻る
+void RPNStream::runChunks(ChunkJob* jobs, std::size_t n, pthread_t* tids) {
+    std::size_t started = 1;
+    while (started < n && ::pthread_create(&tids[started], 0, chunkWorker, &jobs[started]) == 0)
+        ++started;
+    chunkWorker(&jobs[0]);
+    for (std::size_t i = started; i < n; ++i)
+        chunkWorker(&jobs[i]);
+    for (std::size_t i = 1; i < started; ++i)
+        ::pthread_join(tids[i], 0);
+}
+
+// from + want - 1 以降で最初の '\n' の直後を返す (なければ end)。
+// from + 2 * want までに '\n' がなければ 0: 1 行が巨大な式なのでチャンクに分けない
+static const char* lineEndNear(const char* from, const char* end, std::size_t want) {
+    if (static_cast<std::size_t>(end - from) <= want) return end;
+    const char* target = from + want - 1;
+    const std::size_t span = std::min<std::size_t>(end - target, want + 1);
+    const char* nl = static_cast<const char*>(std::memchr(target, '\n', span));
+    if (nl) return nl + 1;
+    return target + span == end ? end : 0;
+}
+
+static unsigned long countLines(const char* p, const char* end) {
+    unsigned long n = 0;
+    while ((p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != 0) {
+        ++n;
+        ++p;
+    }
+    return n;
+}
+
+static void addStats(RPNStream::Stats& to, const RPNStream::Stats& s) {
+    to.lines += s.lines;
+    to.errors += s.errors;
+    to.tokens += s.tokens;
+    to.bytes += s.bytes;
+}
+
+// [base, p) のうちページ単位で読み終わった部分を手放す (peak RSS を入力サイズに比例させない)
+static void releaseDone(const char* base, const char* p, std::size_t page, std::size_t& released) {
+    const std::size_t done = (static_cast<std::size_t>(p - base) / page) * page;
+    if (done > released) {
+        ::madvise(const_cast<char*>(base) + released, done - released, MADV_DONTNEED);
+        released = done;
+    }
+}
+
+/**
+  * Evaluates from p up to the first '\n' at or after p + want - 1 (or to
+  * end) on this thread, feeding the mapping in kBlockSize blocks like
+  * run() and releasing pages behind it, so a single huge expression never
+  * becomes one chunk. Output goes straight to out/err.
+  * @return where the next chunk starts
+*/
+static const char* streamLongLine(const char* p, const char* end, std::size_t want,
+                                  unsigned long& line, std::ostream& out, std::ostream& err,
+                                  RPNStream::Stats& total, const char* base, std::size_t page,
+                                  std::size_t& released) {
+    RPNStream stream(out, err, line);
+    const char* target = p + want - 1;
+    line += countLines(p, target);
+    while (p < end) {
+        const char* blockEnd = p + std::min<std::size_t>(RPNStream::kBlockSize, end - p);
+        const char* from = std::max(p, target);
+        const char* nl = from < blockEnd
+            ? static_cast<const char*>(std::memchr(from, '\n', blockEnd - from)) : 0;
+        if (nl) {
+            blockEnd = nl + 1;
+            ++line;
+        }
+        stream.feed(p, blockEnd - p);
+        p = blockEnd;
+        releaseDone(base, p, page, released);
+        if (nl) break;
+    }
+    stream.finish();
+    addStats(total, stream.stats());
+    return p;
+}
+
+// 例外で抜けても jobs を解放する
+namespace {
+template <typename T>
+class ArrayGuard {
+public:
+    explicit ArrayGuard(T* p) : p_(p) {}
+    ~ArrayGuard() { delete[] p_; }
+    T* get() const { return p_; }
+private:
+    ArrayGuard(const ArrayGuard&);
+    ArrayGuard& operator=(const ArrayGuard&);
+    T* p_;
+};
+}
+
+RPNStream::Stats RPNStream::runParallel(const std::string& path, std::ostream& out,
+                                        std::ostream& err, unsigned threads,
+                                        std::size_t chunkBytes) {
+    Stats total = {0, 0, 0, 0};
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("could not open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        ::close(fd);
+        throw std::runtime_error("could not open " + path);
+    }
+    if (!S_ISREG(st.st_mode)) { // pipe は mmap もチャンク分けもできない: run() で読む
+        ::close(fd);
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        RPNStream stream(out, err);
+        stream.run(in);
+        return stream.stats();
+    }
+    const std::size_t len = static_cast<std::size_t>(st.st_size);
+    if (len == 0) {
+        ::close(fd);
+        return total;
+    }
+    void* map = ::mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // munmap までマップは使える
+    if (map == MAP_FAILED)
+        throw std::runtime_error("could not map " + path);
+    ::madvise(map, len, MADV_SEQUENTIAL);
+
+    if (threads == 0) threads = 1;
+    if (chunkBytes == 0) chunkBytes = 1;
+    const char* base = static_cast<const char*>(map);
+    const char* end = base + len;
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    // 行の評価は前の行に依存しないので、行の切れ目で最大 threads 個のチャンクに分けて
+    // 同時に評価し、out は out、err は err でチャンクの順につないで書く
+    ArrayGuard<ChunkJob> guard(new ChunkJob[threads]);
+    ChunkJob* jobs = guard.get();
+    std::vector<pthread_t> tids(threads);
+    std::string merged;
+    const char* p = base;
+    unsigned long line = 1;
+    std::size_t released = 0;
+    while (p < end) {
+        std::size_t n = 0;
+        for (; n < threads && p < end; ++n) {
+            const char* e = lineEndNear(p, end, chunkBytes);
+            if (!e) break;
+            ChunkJob& job = jobs[n];
+            job.begin = p;
+            job.end = e;
+            job.firstLine = line;
+            job.out.str("");
+            job.err.str("");
+            line += countLines(job.begin, job.end); // エラーの行番号のため (memchr なので安い)
+            p = job.end;
+        }
+        if (n == 0) { // p から始まる行が長すぎる: その行は逐次で読む
+            p = streamLongLine(p, end, chunkBytes, line, out, err, total, base, page, released);
+            continue;
+        }
+        runChunks(jobs, n, &tids[0]);
+
+        merged.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            merged += jobs[i].out.str();
+            addStats(total, jobs[i].stats);
+        }
+        out.write(merged.data(), merged.size());
+        merged.clear();
+        for (std::size_t i = 0; i < n; ++i)
+            merged += jobs[i].err.str();
+        err.write(merged.data(), merged.size());
+
+        releaseDone(base, p, page, released);
+    }
+    ::munmap(map, len);
+    out.flush();
+    return total;
+}
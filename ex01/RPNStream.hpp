@@ -0,0 +1,100 @@
+#ifndef RPNSTREAM_HPP
+#define RPNSTREAM_HPP
+#include <string>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <cstddef>
+#include <pthread.h>
+#include "RPNStack.hpp"
+
+/**
+  * Evaluates RPN expressions from a stream, one expression per line.
+  * Input is read in fixed-size blocks and tokens are scanned straight out
+  * of the block, so memory is bounded by the stack depth of the deepest
+  * expression, not by the input size: a multi-gigabyte single-line
+  * expression is fine.
+  *
+  * Tokens and errors follow RPN::parseAndPushToken. Each non-blank line
+  * prints its result followed by '\n' to out. A failing line prints
+  * "Error: line <n>: <message>" to err, and the rest of that line is
+  * skipped. Blank lines are ignored.
+  *
+  * runParallel() evaluates a regular file with a pool of threads: the
+  * file is split into line-aligned chunks, every worker evaluates its
+  * chunk into private out/err buffers, and each window of chunks is
+  * written as one block to out followed by one block to err. Each stream
+  * receives exactly what run() writes to it, in input order, but results
+  * and errors of the same window are not interleaved line by line, so
+  * when out and err share a destination the order only holds per stream.
+*/
+class RPNStream {
+public:
+    static const std::size_t kBlockSize = 64 * 1024;
+    /** An invalid token longer than this is cut in the error message. */
+    static const std::size_t kMaxTokenEcho = 256;
+    static const std::size_t kDefaultChunkBytes = 1 << 20;
+
+    struct Stats {
+        unsigned long lines;        // non-blank lines evaluated
+        unsigned long errors;       // lines that failed
+        unsigned long long tokens;
+        unsigned long long bytes;
+    };
+
+    /** firstLine: number used for the first line in error messages */
+    RPNStream(std::ostream& out, std::ostream& err, unsigned long firstLine = 1);
+    ~RPNStream();
+
+    /**
+      * Evaluates the file at path with `threads` workers, each taking a
+      * chunk of about chunkBytes (cut after a '\n'). A line with no '\n'
+      * within about 2 * chunkBytes is streamed in blocks on the calling
+      * thread instead. Falls back to run() for pipes and other non-regular
+      * files.
+      * @return the summed Stats of all chunks
+      * @throws std::runtime_error if the file cannot be opened or mapped
+    */
+    static Stats runParallel(const std::string& path, std::ostream& out, std::ostream& err,
+                             unsigned threads, std::size_t chunkBytes = kDefaultChunkBytes);
+
+    /** Reads `in` to EOF in kBlockSize blocks and evaluates every line. */
+    void run(std::istream& in);
+    /** Evaluates the next n bytes. Lines and tokens may span calls. */
+    void feed(const char* p, std::size_t n);
+    /** End of input: evaluates a last line that has no '\n'. */
+    void finish();
+
+    const Stats& stats() const;
+
+private:
+    RPNStream(const RPNStream&);
+    RPNStream& operator=(const RPNStream&);
+
+    void token(const char* b, const char* e);
+    void endLine();
+    void fail(const std::string& message);
+
+    // runParallel 用: 1 チャンク分の仕事と出力先 (ワーカーごとに 1 つ)
+    struct ChunkJob {
+        const char* begin;
+        const char* end;
+        unsigned long firstLine;
+        std::ostringstream out;
+        std::ostringstream err;
+        Stats stats;
+    };
+    static void* chunkWorker(void* arg);
+    static void runChunks(ChunkJob* jobs, std::size_t n, pthread_t* tids);
+
+    std::ostream& out_;
+    std::ostream& err_;
+    RPNStack stack_;
+    std::string partial_;       // token cut at the end of the previous block
+    unsigned long line_;        // 1-based number of the current line
+    bool lineHasTokens_;
+    bool skipping_;             // an error happened: ignore up to '\n'
+    Stats stats_;
+};
+
+#endif // RPNSTREAM_HPP
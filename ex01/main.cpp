@@ -1,8 +1,51 @@
 #include "RPN.hpp"
+#include "RPNStream.hpp"
+#include <cstdlib>  // getenv, atoi
+#include <unistd.h> // sysconf
+
+// RPN_THREADS があればそれを使い、なければオンラインの CPU 数
+static unsigned workerThreads() {
+    const char* env = std::getenv("RPN_THREADS");
+    if (env && std::atoi(env) > 0) return static_cast<unsigned>(std::atoi(env));
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned>(n) : 1;
+}
+
+// ./RPN --stream [file]: 1 行 1 式で file (なければ stdin) を評価する
+static int runStream(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+    if (argc == 3) {
+        try {
+            RPNStream::Stats stats = RPNStream::runParallel(argv[2], std::cout, std::cerr,
+                                                            workerThreads());
+            return stats.errors == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    RPNStream stream(std::cout, std::cerr);
+    stream.run(std::cin);
+    std::cout.flush();
+    return stream.stats().errors == 0 ? 0 : 1;
+}
 
 int main(int argc, char** argv) {
+    if (argc >= 2 && argc <= 3 && std::string(argv[1]) == "--stream")
+        return runStream(argc, argv);
+    if (argc == 3 && std::string(argv[1]) == "--bigint") {
+        try {
+            std::cout << RPN::evaluateBigInt(argv[2]) << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
     if (argc != 2) {
         std::cerr << "Usage: " << argv[0] << " \"<RPN expression>\"" << std::endl;
+        std::cerr << "       " << argv[0] << " --stream [file]" << std::endl;
+        std::cerr << "       " << argv[0] << " --bigint \"<RPN expression>\"" << std::endl;
         return 1;
     }
 
@@ -14,4 +57,4 @@ int main(int argc, char** argv) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
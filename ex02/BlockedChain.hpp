@@ -0,0 +1,157 @@
+#ifndef BLOCKEDCHAIN_HPP
+#define BLOCKEDCHAIN_HPP
+#include <vector>
+#include <algorithm>    // for std::copy, std::copy_backward
+#include <cstddef>      // for std::size_t
+
+/**
+  * Sequence with access and insertion by rank, for PmergeMe's main chain.
+  * Elements live in blocks of at most kBlock entries, all cut from one pool
+  * sized from the final length. A Fenwick tree over the block sizes maps a
+  * rank to its block in O(log blocks). An insertion moves at most kBlock
+  * entries, and a full block is split in two (O(blocks) pointer moves, once
+  * every kBlock / 2 insertions into it).
+  *
+  * at() remembers the block of the previous lookup, so the probes of one
+  * binary search only walk the Fenwick tree until they stay in one block.
+*/
+template <typename T>
+class BlockedChain {
+public:
+    static const std::size_t kBlock = 512;
+
+    /** Room for `capacity` entries in total. */
+    explicit BlockedChain(std::size_t capacity)
+        : pool_((capacity / (kBlock / 2) + 2) * kBlock), poolUsed_(0), size_(0),
+          cacheBlock_(0), cacheStart_(0), cacheValid_(false) {}
+    ~BlockedChain() {}
+
+    /** Replaces the contents with [first, last), blocks half full. */
+    void assign(const T* first, const T* last) {
+        blocks_.clear();
+        counts_.clear();
+        poolUsed_ = 0;
+        size_ = last - first;
+        for (const T* p = first; p < last; p += kBlock / 2) {
+            const std::size_t n = std::min<std::size_t>(kBlock / 2, last - p);
+            T* b = newBlock();
+            std::copy(p, p + n, b);
+            blocks_.push_back(b);
+            counts_.push_back(static_cast<int>(n));
+        }
+        rebuildTree();
+    }
+
+    std::size_t size() const { return size_; }
+
+    const T& at(std::size_t rank) {
+        if (!cacheValid_ || rank < cacheStart_
+            || rank >= cacheStart_ + static_cast<std::size_t>(counts_[cacheBlock_]))
+            locate(rank);
+        return blocks_[cacheBlock_][rank - cacheStart_];
+    }
+
+    void insert(std::size_t rank, const T& v) {
+        if (blocks_.empty()) {
+            blocks_.push_back(newBlock());
+            counts_.push_back(0);
+            rebuildTree();
+        }
+        // 末尾への追加は最後のブロックへ
+        std::size_t b, start;
+        if (rank == size_) {
+            b = blocks_.size() - 1;
+            start = size_ - counts_[b];
+        } else {
+            locate(rank);
+            b = cacheBlock_;
+            start = cacheStart_;
+        }
+        if (counts_[b] == static_cast<int>(kBlock)) {
+            split(b);
+            if (rank - start >= kBlock / 2) {
+                start += kBlock / 2;
+                ++b;
+            }
+        }
+        T* block = blocks_[b];
+        const std::size_t off = rank - start;
+        std::copy_backward(block + off, block + counts_[b], block + counts_[b] + 1);
+        block[off] = v;
+        ++counts_[b];
+        for (std::size_t i = b + 1; i <= tree_.size() - 1; i += i & (0 - i)) // Fenwick add
+            ++tree_[i];
+        ++size_;
+        cacheValid_ = false;
+    }
+
+    /** Writes all entries in order to out[0, size()). */
+    void copyTo(T* out) const {
+        for (std::size_t b = 0; b < blocks_.size(); ++b)
+            out = std::copy(blocks_[b], blocks_[b] + counts_[b], out);
+    }
+
+private:
+    BlockedChain(const BlockedChain&);
+    BlockedChain& operator=(const BlockedChain&);
+
+    T* newBlock() {
+        T* b = &pool_[0] + poolUsed_;
+        poolUsed_ += kBlock;
+        return b;
+    }
+
+    // tree_[i] (1 始まり) は counts_ の Fenwick tree
+    void rebuildTree() {
+        tree_.assign(blocks_.size() + 1, 0);
+        for (std::size_t i = 1; i < tree_.size(); ++i) {
+            tree_[i] += counts_[i - 1];
+            const std::size_t parent = i + (i & (0 - i));
+            if (parent < tree_.size()) tree_[parent] += tree_[i];
+        }
+        step_ = 1;
+        while (step_ * 2 < tree_.size()) step_ *= 2;
+    }
+
+    // rank を含むブロックと、その先頭の rank を cache に入れる
+    void locate(std::size_t rank) {
+        std::size_t pos = 0;
+        std::size_t before = 0;
+        for (std::size_t s = step_; s > 0; s /= 2) {
+            const std::size_t next = pos + s;
+            if (next < tree_.size() && before + tree_[next] <= rank) {
+                pos = next;
+                before += tree_[next];
+            }
+        }
+        cacheBlock_ = pos < blocks_.size() ? pos : blocks_.size() - 1;
+        cacheStart_ = pos < blocks_.size() ? before : before - counts_[cacheBlock_];
+        cacheValid_ = true;
+    }
+
+    // 満杯のブロック b を半分ずつに分ける
+    void split(std::size_t b) {
+        T* fresh = newBlock();
+        std::copy(blocks_[b] + kBlock / 2, blocks_[b] + kBlock, fresh);
+        counts_[b] = kBlock / 2;
+        blocks_.insert(blocks_.begin() + b + 1, fresh);
+        counts_.insert(counts_.begin() + b + 1, static_cast<int>(kBlock / 2));
+        rebuildTree();
+    }
+
+    std::vector<T> pool_;
+    std::size_t poolUsed_;
+    std::vector<T*> blocks_;
+    std::vector<int> counts_;
+    std::vector<std::size_t> tree_;
+    std::size_t step_;
+    std::size_t size_;
+    std::size_t cacheBlock_;
+    std::size_t cacheStart_;
+    bool cacheValid_;
+};
+
+template <typename T>
+const std::size_t BlockedChain<T>::kBlock;
+
+#endif // BLOCKEDCHAIN_HPP
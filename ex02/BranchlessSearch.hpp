@@ -0,0 +1,63 @@
+#ifndef BRANCHLESSSEARCH_HPP
+#define BRANCHLESSSEARCH_HPP
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 最後に線形に数える区間 (int 16 個 = キャッシュライン 1 本)
+static const int kScanWindow = 16;
+
+// a[0, 16) のうち val より小さいものの数
+inline int countLessThan16(const int* a, int val) {
+#if defined(__AVX2__)
+    const __m256i v = _mm256_set1_epi32(val);
+    const __m256i lo = _mm256_cmpgt_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a)));
+    const __m256i hi = _mm256_cmpgt_epi32(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 8)));
+    return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(lo)))
+         + __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(hi)));
+#elif defined(__SSE2__)
+    const __m128i v = _mm_set1_epi32(val);
+    __m128i acc = _mm_setzero_si128();
+    for (int k = 0; k < kScanWindow; k += 4) // 比較結果は -1 なので引けば数になる
+        acc = _mm_sub_epi32(acc, _mm_cmplt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + k)), v));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int n = 0;
+    for (int k = 0; k < kScanWindow; ++k) n += a[k] < val;
+    return n;
+#endif
+}
+
+/**
+  * Lower bound of val in the sorted a[0, m): the number of elements less
+  * than val. The loop halves the range with a conditional move instead of
+  * a branch, and stops at one cache line, which is counted with SIMD
+  * compares. machineCompares gets the element compares actually executed.
+*/
+inline int lowerBoundInt(const int* a, int m, int val, long& machineCompares) {
+    if (m < kScanWindow) {
+        int n = 0;
+        for (int k = 0; k < m; ++k) n += a[k] < val;
+        machineCompares += m;
+        return n;
+    }
+    // a[0, base) は val 未満、a[base + n, m) は val 以上
+    int base = 0;
+    int n = m;
+    while (n > kScanWindow) {
+        const int half = n / 2;
+        base = a[base + half] < val ? base + half : base;
+        n -= half;
+        ++machineCompares;
+    }
+    // 区間を含む 16 個を数える (配列の外は読まないよう末尾に寄せる)
+    const int s = base < m - kScanWindow ? base : m - kScanWindow;
+    machineCompares += kScanWindow;
+    return s + countLessThan16(a + s, val);
+}
+
+#endif // BRANCHLESSSEARCH_HPP
@@ -0,0 +1,55 @@
+#ifndef PARALLELFOR_HPP
+#define PARALLELFOR_HPP
+#include <vector>
+#include <cstddef>      // for std::size_t
+#include <pthread.h>
+
+template <typename Job>
+struct ParallelSlice {
+    Job* job;
+    std::size_t begin;
+    std::size_t end;
+    long result;
+};
+
+template <typename Job>
+void* parallelWorker(void* arg) {
+    ParallelSlice<Job>* s = static_cast<ParallelSlice<Job>*>(arg);
+    s->result = (*s->job)(s->begin, s->end);
+    return 0;
+}
+
+// [0, n) を最大 threads 個の連続した区間に分け、job(begin, end) を別々のスレッドで呼ぶ
+// 1 区間が grain より短くなる分け方はしない (スレッドを作る方が高くつく)
+// job の戻り値 (PmergeMe では比較回数) の合計を返す
+template <typename Job>
+long parallelFor(Job& job, std::size_t n, unsigned threads, std::size_t grain) {
+    std::size_t parts = grain ? n / grain : n;
+    if (parts > threads) parts = threads;
+    if (parts <= 1) return n ? job(0, n) : 0;
+
+    std::vector<ParallelSlice<Job> > slices(parts);
+    std::vector<pthread_t> tids(parts);
+    for (std::size_t i = 0; i < parts; ++i) {
+        slices[i].job = &job;
+        slices[i].begin = n * i / parts;
+        slices[i].end = n * (i + 1) / parts;
+        slices[i].result = 0;
+    }
+    std::size_t started = 1;
+    for (; started < parts; ++started) {
+        if (::pthread_create(&tids[started], 0, parallelWorker<Job>, &slices[started]) != 0)
+            break;
+    }
+    parallelWorker<Job>(&slices[0]);
+    for (std::size_t i = started; i < parts; ++i) // スレッドを作れなかった分はここで処理
+        parallelWorker<Job>(&slices[i]);
+    long total = 0;
+    for (std::size_t i = 0; i < parts; ++i) {
+        if (i > 0 && i < started) ::pthread_join(tids[i], 0);
+        total += slices[i].result;
+    }
+    return total;
+}
+
+#endif // PARALLELFOR_HPP
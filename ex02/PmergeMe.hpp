@@ -2,44 +2,289 @@
 #define PMERGEME_HPP
 #include <algorithm>    // for std::swap, std::distance
 #include <cstddef>      // for std::size_t
+#include <functional>   // for std::less
+#include <memory>       // for std::allocator
+#include <stdint.h>     // for uint32_t, uint64_t
+#include "ScratchArena.hpp"
+#include "BlockedChain.hpp"
+#include "ParallelFor.hpp"
+#include "BranchlessSearch.hpp"
 
-#ifdef DEBUG
-extern int num_comparisons;
-#endif
+// Container<T> の要素の型だけを Index に替えた型 (std::vector<int> -> std::vector<Index>)
+template <typename Container, typename Index>
+struct RebindContainer;
+template <template <typename, typename> class C, typename T, typename A, typename Index>
+struct RebindContainer<C<T, A>, Index> {
+    typedef C<Index, std::allocator<Index> > type;
+};
 
-template <typename Container>
+/**
+  * Ford-Johnson merge-insertion sort over the elements of Container.
+  * Keys are ordered by Compare (a strict weak ordering), and every call
+  * to it is counted on this instance. Index lists come back in the same
+  * kind of container, holding Index instead of value_type.
+*/
+template <typename Container,
+          typename Compare = std::less<typename Container::value_type>,
+          typename Index = uint32_t>
 class PmergeMe {
 public:
     typedef Container container_type;
     typedef typename Container::value_type value_type;
     typedef typename Container::iterator iterator;
     typedef typename Container::const_iterator const_iterator;
-    PmergeMe() {}
-    PmergeMe(const PmergeMe& rhs) { *this = rhs; }
+    typedef Compare value_compare;
+    // 返すインデックス列 (uint32_t なら 2^32 - 1 個まで。size_t も使える)
+    typedef Index index_type;
+    typedef typename RebindContainer<Container, Index>::type index_container;
+    PmergeMe() : comp_(), comparisons_(0), machineComparisons_(0) {}
+    explicit PmergeMe(const Compare& comp)
+        : comp_(comp), comparisons_(0), machineComparisons_(0) {}
+    PmergeMe(const PmergeMe& rhs)
+        : comp_(rhs.comp_), comparisons_(rhs.comparisons_),
+          machineComparisons_(rhs.machineComparisons_) {}
     PmergeMe& operator=(const PmergeMe& rhs) {
-        (void)rhs;
+        comp_ = rhs.comp_;
+        comparisons_ = rhs.comparisons_;
+        machineComparisons_ = rhs.machineComparisons_;
         return *this;
     }
     ~PmergeMe() {}
-    Container mergeInsertionSort(typename Container::iterator first,
-                               typename Container::iterator last);
+    // このインスタンスが Compare を呼んだ回数 (resetCounters からの累計)
+    // 分岐なし探索は範囲を分けるのに要る ceil(log2(m + 1)) 回で数える
+    long comparisons() const { return comparisons_; }
+    // 挿入位置の探索で実際に行った要素比較の数 (分岐なし探索の最後の 16 個も含む)
+    long machineComparisons() const { return machineComparisons_; }
+    void resetCounters() {
+        comparisons_ = 0;
+        machineComparisons_ = 0;
+    }
+    index_container mergeInsertionSort(typename Container::iterator first,
+                                       typename Container::iterator last);
+    // mergeInsertionSort と同じ結果・同じ比較回数。作業領域は N から一度だけ確保する
+    index_container mergeInsertionSortArena(typename Container::iterator first,
+                                            typename Container::iterator last);
+    // arena 版と同じ結果・同じ比較回数。大きい段の main chain は BlockedChain に持たせ、
+    // 1 回の挿入で動かすのを O(N) 要素から O(BlockedChain::kBlock) 要素にする
+    index_container mergeInsertionSortBlocked(typename Container::iterator first,
+                                              typename Container::iterator last);
+    // blocked 版と同じ結果・同じ比較回数。キーをコピーせずポインタで指したまま並べる
+    // (文字列のように、コピーも比較も高くつく value_type 向け)
+    index_container mergeInsertionSortIndirect(typename Container::const_iterator first,
+                                               typename Container::const_iterator last);
+    // threads 本で並べる。結果は正しく並んだインデックス列だが、各グループを
+    // まとめて挿入するので比較の順番・回数と同じキーの順番は逐次版と違う
+    // (threads が 0 か N < kParallelMinSize なら mergeInsertionSortBlocked と同じ)
+    index_container mergeInsertionSortParallel(typename Container::iterator first,
+                                               typename Container::iterator last,
+                                               unsigned threads);
+    // 挿入位置の二分探索の方法
+    // SEARCH_BRANCHY: binaryInsertion と同じ (既定の Compare なら一致したら打ち切る)
+    // SEARCH_BRANCHLESS: 条件付き move で範囲を半分にしていき、最後の 16 個は
+    //   (int を std::less で比べるなら SIMD で) まとめて数える。挿入位置は同じ。
+    //   BlockedChain に載せる大きい段 (kBlockedMinSize 以上) は SEARCH_BRANCHY のまま
+    enum Search { SEARCH_BRANCHY, SEARCH_BRANCHLESS };
+    // インデックス列を返さず [first, last) そのものを並べ替える
+    // (SEARCH_BRANCHY なら比較の順番・回数はインデックス版と同じ)
+    void sortValues(typename Container::iterator first, typename Container::iterator last,
+                    Search search = SEARCH_BRANCHY);
+    // sortValues の方針
+    struct Options {
+        Options() : search(SEARCH_BRANCHY), smallKernels(false), mergeAbove(0) {}
+        Search search;
+        // kSmallMax 以下の段を arena を使わない専用の手順で並べる
+        // (3, 4 個は決定木、それ以上はスタック上の Ford-Johnson。比較回数は最適のまま)
+        bool smallKernels;
+        // 0 でなければ、これより長い列は半分ずつのマージソートにし、mergeAbove 以下の
+        // 区間だけを Ford-Johnson で並べる。比較回数は少し増えるが、挿入で大きな
+        // main chain を動かさずに済む (時間だけを気にする呼び出し向け)
+        int mergeAbove;
+    };
+    void sortValues(typename Container::iterator first, typename Container::iterator last,
+                    const Options& options);
+    // キー [first, last) を並べ替え、ids[i] (レコード ID) をキーと一緒に動かす
+    void sortWithPayload(typename Container::iterator first, typename Container::iterator last,
+                         uint64_t* ids);
+    // これより短い段は配列のまま挿入する (memmove の方が速い)
+    static const int kBlockedMinSize = 4096;
+    // smallKernels で専用の手順を使う長さの上限
+    static const int kSmallMax = 16;
+    // これより短い段は並列にしない
+    static const int kParallelMinSize = 1 << 15;
 
 private:
+    struct ChainEntry {
+        value_type value;
+        Index index;
+    };
+    struct KeyedEntry {
+        value_type key;
+        uint64_t id;
+    };
+    // キーを指すだけのレコード (mergeInsertionSortIndirect)
+    struct KeyRef {
+        const value_type* key;
+        Index index;
+    };
+    static const value_type& keyOf(const value_type& v) { return v; }
+    static const value_type& keyOf(const ChainEntry& e) { return e.value; }
+    static const value_type& keyOf(const KeyedEntry& e) { return e.key; }
+    static const value_type& keyOf(const KeyRef& e) { return *e.key; }
+    // 勝者の再帰に渡す {キー, 位置}。ChainEntry はキーをコピーし、KeyRef は指す
+    // (a は再帰から戻るまで動かさないので、指した先はそのまま使える)
+    template <typename T>
+    static void makeLink(ChainEntry& link, const T& rec, int pos) {
+        link.value = keyOf(rec);
+        link.index = static_cast<Index>(pos);
+    }
+    template <typename T>
+    static void makeLink(KeyRef& link, const T& rec, int pos) {
+        link.key = &keyOf(rec);
+        link.index = static_cast<Index>(pos);
+    }
+
+    // main chain の 2 つの持ち方。どちらも operator[] (キー), length と
+    // 挿入待ちの pending[i] を扱う pendingKey, insertPending を持つ
+    template <typename T>
+    struct ArrayChain {
+        T* items;
+        int size;
+        const T* pending;
+        const value_type& operator[](int i) const { return keyOf(items[i]); }
+        int length() const { return size; }
+        const value_type& pendingKey(int i) const { return keyOf(pending[i]); }
+        void insertPending(int pos, int i);
+    };
+    template <typename T>
+    struct BlockChain {
+        BlockChain(std::size_t capacity, const T* p) : chain(capacity), pending(p) {}
+        BlockedChain<T> chain;
+        const T* pending;
+        const value_type& operator[](int i) { return keyOf(chain.at(i)); }
+        int length() const { return static_cast<int>(chain.size()); }
+        const value_type& pendingKey(int i) const { return keyOf(pending[i]); }
+        void insertPending(int pos, int i) { chain.insert(pos, pending[i]); }
+    };
+
+    // 並列版の各段の処理 (parallelFor に [begin, end) を渡される。戻り値は比較回数)
+    static const std::size_t kParallelGrain = 4096;
+    template <typename T>
+    struct PairJob {
+        const Compare* comp;
+        T* a;
+        ChainEntry* winners;
+        int half;
+        long operator()(std::size_t begin, std::size_t end) const;
+    };
+    template <typename T>
+    struct GatherJob {
+        const T* a;
+        const ChainEntry* winners;
+        T* mainChain;
+        T* pending;
+        int half;
+        long operator()(std::size_t begin, std::size_t end) const;
+    };
+    template <typename T>
+    struct SearchJob {
+        const Compare* comp;
+        const T* chain;
+        int size;
+        const T* pending;
+        int right;
+        int* pos;
+        int* count;
+        long operator()(std::size_t begin, std::size_t end) const;
+    };
+    struct ScatterJob {
+        const int* pos;
+        const int* start;
+        int* cursor;
+        int* gapItems;
+        long operator()(std::size_t begin, std::size_t end) const;
+    };
+    template <typename T>
+    struct KeyLess {
+        KeyLess(const Compare& c, const T* p, long& n) : comp(&c), pending(p), comparisons(&n) {}
+        bool operator()(int x, int y) const {
+            ++*comparisons;
+            return (*comp)(keyOf(pending[x]), keyOf(pending[y]));
+        }
+        const Compare* comp;
+        const T* pending;
+        long* comparisons;
+    };
+    template <typename T>
+    struct MergeJob {
+        const Compare* comp;
+        const T* chain;
+        int size;
+        const T* pending;
+        const int* start;
+        int* gapItems;
+        int* cursor;
+        T* next;
+        long operator()(std::size_t begin, std::size_t end) const;
+    };
+
+    // sortRecords の flags
+    enum { kBlocked = 1, kBranchless = 2, kSmallKernels = 4 };
+
+    static std::size_t arenaSize(int N);
+    static std::size_t parallelArenaSize(int N);
+    index_container sortIndicesArena(typename Container::iterator first,
+                                     typename Container::iterator last, bool blocked);
+    // Link は勝者の再帰に使うレコード (ChainEntry か KeyRef)
+    template <typename T, typename Link>
+    void sortRecords(T* a, int N, ScratchArena<T>& own, ScratchArena<Link>& links,
+                     unsigned flags);
+    template <typename T>
+    void sortRecordsParallel(T* a, int N, ScratchArena<T>& own, ScratchArena<ChainEntry>& links,
+                             unsigned threads);
+    bool lessCounted(const value_type& x, const value_type& y);
+    template <typename T, typename Link>
+    void sortSmall(T* a, int N, bool branchless);
+    template <typename T, typename Link>
+    void mergeSortRuns(T* a, T* tmp, int N, int cutoff, ScratchArena<T>& own,
+                       ScratchArena<Link>& links, unsigned flags);
+    template <typename Chain>
+    static int searchInsertPos(Chain& chain, const value_type& val, int right,
+                               const Compare& comp, long& comparisons);
+    template <typename Chain>
+    static int branchlessSearch(Chain& chain, const value_type& val, int right,
+                                const Compare& comp, long& comparisons, long& machineCompares);
+    static int branchlessSearch(ArrayChain<int>& chain, const value_type& val, int right,
+                                const Compare& comp, long& comparisons, long& machineCompares);
+    // Compare が既定の std::less<value_type> か (int ならそのときだけ lowerBoundInt が使える)
+    static bool isDefaultLess(const std::less<value_type>*) { return true; }
+    template <typename C>
+    static bool isDefaultLess(const C*) { return false; }
+    // 既定の < なら == で一致を見て探索を打ち切れる (ほかの Compare は < しか答えない)
+    static bool sameKey(const std::less<value_type>*, const value_type& x, const value_type& y) {
+        return x == y;
+    }
+    template <typename C>
+    static bool sameKey(const C*, const value_type&, const value_type&) { return false; }
+    template <typename Chain>
+    void jacobsthalInsertInto(Chain& chain, int remSize, int N, bool branchless);
     int binaryInsertion(Container& mainChain,
             const value_type& val,
             int right);
     void makePairsAndSwap(Container& elems,
-                          Container& idx);
-    void jacobsthalInsert(Container& mainChain, Container& mainIdx,
-                                           const Container& remChain, const Container& remIdx,
+                          index_container& idx);
+    void jacobsthalInsert(Container& mainChain, index_container& mainIdx,
+                                           const Container& remChain, const index_container& remIdx,
                                            int N);
     void materializeChains(const_iterator first,
-                            Container& mainIdx,
-                            Container& remIdx,
+                            index_container& mainIdx,
+                            index_container& remIdx,
                             Container& mainVals,
                             Container& remVals,
-                            const Container& sortIdx);
-    
+                            const index_container& sortIdx);
+
+    Compare comp_;
+    long comparisons_;
+    long machineComparisons_;
 };
 
 #include "PmergeMe.tpp"
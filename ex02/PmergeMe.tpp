@@ -2,27 +2,23 @@
 #define PMERGE_ME_TPP
 #include "PmergeMe.hpp"
 
-#ifdef DEBUG
-extern int num_comparisons;
-#endif
-
-template <typename Container>
-int PmergeMe<Container>::binaryInsertion(Container& mainChain,
+template <typename Container, typename Compare, typename Index>
+int PmergeMe<Container, Compare, Index>::binaryInsertion(Container& mainChain,
                                        const typename Container::value_type& val,
                                        int right) {
     int left = 0;
     if (mainChain.size() <= static_cast<size_t>(right)) {
       right = mainChain.size() - 1;
     }
+    // 一致で打ち切るのは既定の Compare だけ。ほかは 1 段 1 回の呼び出しで
+    // 同じキーの先頭まで探す (キーが全部違えば比較の順番も回数も同じ)
     while (left <= right) {
-#ifdef DEBUG
-      num_comparisons++;
-#endif  // DEBUG
+        ++comparisons_;
         int mid = left + (right - left) / 2;
-        if (mainChain[mid] == val) {
+        if (sameKey(static_cast<const Compare*>(0), mainChain[mid], val)) {
             left = mid;
             break;
-        } else if (mainChain[mid] < val) {
+        } else if (comp_(mainChain[mid], val)) {
             left = mid + 1;
         } else {
             right = mid - 1;
@@ -32,28 +28,26 @@ int PmergeMe<Container>::binaryInsertion(Container& mainChain,
     return left;
 }
 
-template <typename Container>
-void PmergeMe<Container>::makePairsAndSwap(Container& elems, Container& sortIdx) {
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::makePairsAndSwap(Container& elems, index_container& sortIdx) {
   const int N    = static_cast<int>(sortIdx.size());
   const int half = N / 2;
   for (int i = 0, j = half; i < half; ++i, ++j) {
-#ifdef DEBUG
-      num_comparisons++;
-#endif  // DEBUG
-    if (elems[i] < elems[j]) {
+    ++comparisons_;
+    if (comp_(elems[i], elems[j])) {
       std::swap(elems[i], elems[j]);
       std::swap(sortIdx[i], sortIdx[j]);
     }
   }
 }
 
-template <typename Container>
-void PmergeMe<Container>::materializeChains(const_iterator first,
-                                            Container& mainIdx,
-                                            Container& remIdx,
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::materializeChains(const_iterator first,
+                                            index_container& mainIdx,
+                                            index_container& remIdx,
                                             Container& mainChain,
                                             Container& remChain,
-                                            const Container& sortIdx) {
+                                            const index_container& sortIdx) {
   const int N = static_cast<int>(mainIdx.size());
   for (int i = 0; i < N / 2; i++) {
     mainChain.push_back(first[mainIdx[i]]);
@@ -73,10 +67,10 @@ void PmergeMe<Container>::materializeChains(const_iterator first,
 
 // ========= jacobsthalInsert =========
 // remVals を Jacobsthal 順に mainVals へ二分挿入していき、対応するインデックス列 mainIdx も更新する
-template <typename Container>
-void PmergeMe<Container>::jacobsthalInsert(Container& mainChain, Container& mainIdx,
-                                           const Container& remChain, const Container& remIdx,
-                                           int N) {
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::jacobsthalInsert(Container& mainChain, index_container& mainIdx,
+                                           const Container& remChain,
+                                           const index_container& remIdx, int N) {
   // Jacobsthal: J0=0, J1=2, Jn=J(n-1)+2*J(n-2)
   std::size_t numInserted  = 1; // remChain[0] is already inserted
   std::size_t prevGroup    = 0;
@@ -121,26 +115,27 @@ void PmergeMe<Container>::jacobsthalInsert(Container& mainChain, Container& main
 }
 
 // ========= mergeInsertionSort 本体 =========
-template <typename Container>
-Container PmergeMe<Container>::mergeInsertionSort(typename Container::iterator first,
-                               typename Container::iterator last) {
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::mergeInsertionSort(typename Container::iterator first,
+                                                       typename Container::iterator last) {
   const int N = static_cast<int>(std::distance(first, last));
   Container elems(first, last);
-  Container sortIdx(N);
-  for (int i = 0; i < N; ++i) sortIdx[i] = i;
+  index_container sortIdx(N);
+  for (int i = 0; i < N; ++i) sortIdx[i] = static_cast<Index>(i);
   if (N <= 1) return sortIdx;
   makePairsAndSwap(elems, sortIdx);
   if (N == 2) { // 2要素の場合は昇順にして返す
     std::swap(sortIdx[0], sortIdx[1]);
     return sortIdx;
   }
-  Container firstHalfIdx =
+  index_container firstHalfIdx =
       mergeInsertionSort(elems.begin(), elems.begin() + (N / 2));
-  Container mainIdx(N, -1);
+  index_container mainIdx(N);
   for (int i = 0; i < N / 2; ++i) {
     mainIdx[i] = sortIdx[firstHalfIdx[i]];
   }
-  Container remIdx;
+  index_container remIdx;
   // for (int i = 0; i < N / 2; ++i) {
   //   int idx = mainIdx[i];
   //   int pairedIdx = idx >= N / 2 ? idx - N / 2 : idx + N / 2;
@@ -148,7 +143,7 @@ Container PmergeMe<Container>::mergeInsertionSort(typename Container::iterator f
   // }
   const int half = N / 2;
   for (int k = 0; k < half; ++k) {
-    int pos = firstHalfIdx[k];             // 0..half-1
+    Index pos = firstHalfIdx[k];           // 0..half-1
     mainIdx[k] = sortIdx[pos];             // main（大きい方の元インデックス）
     remIdx.push_back(sortIdx[pos + half]); // pend（小さい方の元インデックス）
   }
@@ -158,4 +153,589 @@ Container PmergeMe<Container>::mergeInsertionSort(typename Container::iterator f
   return mainIdx;
 }
 
+// ========= arena 版 =========
+// 上の関数と同じ手順を、ScratchArena から切り出した配列の上で行う
+// (比較の順番も回数も同じなので、結果のインデックス列も同じになる)
+// 各段はインデックスではなくレコードそのものを並べ替える。レコードは
+// ChainEntry (値 + 元のインデックス), value_type, KeyedEntry (値 + 64bit ID) のどれか
+
+template <typename Container, typename Compare, typename Index>
+const int PmergeMe<Container, Compare, Index>::kBlockedMinSize;
+
+// 再帰の各段で使う量の合計 (子の分は親が次を取る前に release されるので、これで足りる)
+template <typename Container, typename Compare, typename Index>
+std::size_t PmergeMe<Container, Compare, Index>::arenaSize(int N) {
+  std::size_t total = 0;
+  for (; N > 2; N /= 2) total += 2 * static_cast<std::size_t>(N) + 2; // winners, mainChain, pending
+  return total;
+}
+
+// binaryInsertion と同じ探索 (同じ位置を同じ順番で比較する)
+// 比較回数は comparisons に足す (並列版のスレッドが comparisons_ を触らないように)
+template <typename Container, typename Compare, typename Index>
+template <typename Chain>
+int PmergeMe<Container, Compare, Index>::searchInsertPos(Chain& chain, const value_type& val, int right,
+                                                         const Compare& comp, long& comparisons) {
+    int left = 0;
+    if (chain.length() <= right) {
+      right = chain.length() - 1;
+    }
+    while (left <= right) {
+        ++comparisons;
+        int mid = left + (right - left) / 2;
+        if (sameKey(static_cast<const Compare*>(0), chain[mid], val)) {
+            left = mid;
+            break;
+        } else if (comp(chain[mid], val)) {
+            left = mid + 1;
+        } else {
+            right = mid - 1;
+        }
+    }
+    return left;
+}
+
+// m 個の候補 (m + 1 個の隙間) を分けるのに二分探索が要る回数
+inline long searchCost(int m) {
+  return m > 0 ? 32 - __builtin_clz(static_cast<unsigned>(m)) : 0;
+}
+
+// searchInsertPos と同じ範囲 [0, right] での lower bound を分岐なしで求める
+template <typename Container, typename Compare, typename Index>
+template <typename Chain>
+int PmergeMe<Container, Compare, Index>::branchlessSearch(Chain& chain, const value_type& val, int right,
+                                                          const Compare& comp, long& comparisons,
+                                                          long& machineCompares) {
+  const int m = chain.length() <= right ? chain.length() : right + 1;
+  comparisons += searchCost(m);
+  int base = 0;
+  int n = m;
+  while (n > 1) {
+    const int half = n / 2;
+    base = comp(chain[base + half], val) ? base + half : base;
+    n -= half;
+    ++machineCompares;
+  }
+  if (n == 0) return 0;
+  ++machineCompares;
+  return base + comp(chain[base], val);
+}
+
+// int の配列を std::less で比べるなら最後のキャッシュラインを SIMD で数える
+template <typename Container, typename Compare, typename Index>
+int PmergeMe<Container, Compare, Index>::branchlessSearch(ArrayChain<int>& chain, const value_type& val,
+                                                          int right, const Compare& comp,
+                                                          long& comparisons,
+                                                          long& machineCompares) {
+  if (!isDefaultLess(static_cast<const Compare*>(0)))
+    return branchlessSearch<ArrayChain<int> >(chain, val, right, comp, comparisons,
+                                              machineCompares);
+  const int m = chain.length() <= right ? chain.length() : right + 1;
+  comparisons += searchCost(m);
+  return lowerBoundInt(chain.items, m, val, machineCompares);
+}
+
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+void PmergeMe<Container, Compare, Index>::ArrayChain<T>::insertPending(int pos, int i) {
+  std::copy_backward(items + pos, items + size, items + size + 1);
+  items[pos] = pending[i];
+  ++size;
+}
+
+// jacobsthalInsert と同じ順番・同じ上限で pending[0, remSize) を chain に挿入する
+template <typename Container, typename Compare, typename Index>
+template <typename Chain>
+void PmergeMe<Container, Compare, Index>::jacobsthalInsertInto(Chain& chain, int remSize, int N,
+                                               bool branchless) {
+  std::size_t numInserted  = 1;
+  std::size_t prevGroup    = 0;
+  std::size_t curGroup     = 2;
+  std::size_t upperBoundIx = (N - 1 < 4 ? N - 1 : 3);
+  const std::size_t remCount = remSize;
+  long comparisons = 0;
+  long machineCompares = 0;
+
+  while (numInserted + curGroup < remCount) {
+    std::size_t i = numInserted + curGroup - 1;
+    for (;;) {
+      chain.insertPending(branchless
+          ? branchlessSearch(chain, chain.pendingKey(i), upperBoundIx - 1, comp_, comparisons,
+                             machineCompares)
+          : searchInsertPos(chain, chain.pendingKey(i), upperBoundIx - 1, comp_, comparisons),
+          i);
+      if (i == numInserted) break;
+      --i;
+    }
+    numInserted += curGroup;
+    std::size_t nextGroup = curGroup + 2 * prevGroup;
+    prevGroup    = curGroup;
+    curGroup     = nextGroup;
+    upperBoundIx = 2 * upperBoundIx + 1;
+  }
+  if (numInserted < remCount) {
+    std::size_t i = remCount - 1;
+    for (;;) {
+      chain.insertPending(branchless
+          ? branchlessSearch(chain, chain.pendingKey(i), upperBoundIx - 1, comp_, comparisons,
+                             machineCompares)
+          : searchInsertPos(chain, chain.pendingKey(i), upperBoundIx - 1, comp_, comparisons),
+          i);
+      if (i == numInserted) break;
+      --i;
+    }
+  }
+  comparisons_ += comparisons;
+  machineComparisons_ += branchless ? machineCompares : comparisons;
+}
+
+// a[0, N) をキー順に並べ替える。own は T の作業領域、links は勝者の再帰用
+// (T と Link が同じ型のときは同じ arena を渡してよい)
+// flags は kBlocked | kBranchless | kSmallKernels
+template <typename Container, typename Compare, typename Index>
+template <typename T, typename Link>
+void PmergeMe<Container, Compare, Index>::sortRecords(T* a, int N, ScratchArena<T>& own,
+                                                      ScratchArena<Link>& links, unsigned flags) {
+  if ((flags & kSmallKernels) && N <= kSmallMax) {
+    sortSmall<T, Link>(a, N, (flags & kBranchless) != 0);
+    return;
+  }
+  if (N <= 2) {
+    if (N == 2) {
+      ++comparisons_;
+      // makePairsAndSwap の後に入れ替えるので、結果は「小さくなければ入れ替え」
+      if (!comp_(keyOf(a[0]), keyOf(a[1]))) std::swap(a[0], a[1]);
+    }
+    return;
+  }
+  const int half = N / 2;
+  for (int i = 0, j = half; i < half; ++i, ++j) {
+    if (comp_(keyOf(a[i]), keyOf(a[j]))) std::swap(a[i], a[j]);
+  }
+  comparisons_ += half;
+  // 勝者 (大きい方) を、自分の位置を持たせて再帰で並べる
+  const std::size_t linkMark = links.mark();
+  Link* winners = links.take(half);
+  for (int k = 0; k < half; ++k) makeLink(winners[k], a[k], k);
+  sortRecords(winners, half, links, links, flags);
+
+  const std::size_t ownMark = own.mark();
+  const int remSize = half + (N % 2);
+  T* mainChain = own.take(N);
+  T* pending = own.take(remSize);
+  for (int k = 0; k < half; ++k) {
+    mainChain[k + 1] = a[winners[k].index];
+    pending[k] = a[winners[k].index + half];
+  }
+  if (N % 2 == 1) pending[half] = a[N - 1];
+  mainChain[0] = pending[0];
+  const bool branchless = (flags & kBranchless) != 0;
+  if ((flags & kBlocked) && N >= kBlockedMinSize) {
+    BlockChain<T> chain(N, pending);
+    chain.chain.assign(mainChain, mainChain + half + 1);
+    // BlockedChain では探索の各段がブロックをまたぐので、分岐なしにしても速くならない
+    jacobsthalInsertInto(chain, remSize, N, false);
+    chain.chain.copyTo(a);
+  } else {
+    ArrayChain<T> chain = {mainChain, half + 1, pending};
+    jacobsthalInsertInto(chain, remSize, N, branchless);
+    std::copy(mainChain, mainChain + N, a);
+  }
+  own.release(ownMark);
+  links.release(linkMark);
+}
+
+// ========= 短い列 (smallKernels) =========
+// arena も再帰の段ごとの準備も使わずに並べる。3, 4 個は決定木で、
+// 5 個以上はスタック上の配列で sortRecords と同じ手順 (どちらも比較回数は F(N))
+
+template <typename Container, typename Compare, typename Index>
+const int PmergeMe<Container, Compare, Index>::kSmallMax;
+
+template <typename Container, typename Compare, typename Index>
+bool PmergeMe<Container, Compare, Index>::lessCounted(const value_type& x, const value_type& y) {
+  ++comparisons_;
+  return comp_(x, y);
+}
+
+template <typename Container, typename Compare, typename Index>
+template <typename T, typename Link>
+void PmergeMe<Container, Compare, Index>::sortSmall(T* a, int N, bool branchless) {
+  if (N <= 1) return;
+  if (N == 2) {
+    if (!lessCounted(keyOf(a[0]), keyOf(a[1]))) std::swap(a[0], a[1]);
+    return;
+  }
+  if (N == 3) { // 2 回か 3 回
+    if (lessCounted(keyOf(a[1]), keyOf(a[0]))) std::swap(a[0], a[1]);
+    if (!lessCounted(keyOf(a[2]), keyOf(a[1]))) return;
+    const T x = a[2];
+    a[2] = a[1];
+    if (lessCounted(keyOf(x), keyOf(a[0]))) {
+      a[1] = a[0];
+      a[0] = x;
+    } else {
+      a[1] = x;
+    }
+    return;
+  }
+  if (N == 4) { // 2 組を比べ、大きい方同士を比べ、残りを二分探索で入れる (4 回か 5 回)
+    if (lessCounted(keyOf(a[1]), keyOf(a[0]))) std::swap(a[0], a[1]);
+    if (lessCounted(keyOf(a[3]), keyOf(a[2]))) std::swap(a[2], a[3]);
+    if (lessCounted(keyOf(a[3]), keyOf(a[1]))) {
+      std::swap(a[0], a[2]);
+      std::swap(a[1], a[3]);
+    }
+    // a[0] <= a[1] <= a[3], a[2] <= a[3]: a[2] を a[0], a[1] の前後のどこかに入れる
+    const T x = a[2];
+    a[2] = a[1];
+    if (lessCounted(keyOf(x), keyOf(a[0]))) {
+      a[1] = a[0];
+      a[0] = x;
+    } else if (lessCounted(keyOf(x), keyOf(a[2]))) {
+      a[1] = x;
+    } else {
+      a[1] = a[2];
+      a[2] = x;
+    }
+    return;
+  }
+  const int half = N / 2;
+  for (int i = 0, j = half; i < half; ++i, ++j) {
+    if (comp_(keyOf(a[i]), keyOf(a[j]))) std::swap(a[i], a[j]);
+  }
+  comparisons_ += half;
+  Link winners[kSmallMax / 2];
+  for (int k = 0; k < half; ++k) makeLink(winners[k], a[k], k);
+  sortSmall<Link, Link>(winners, half, branchless);
+  T mainChain[kSmallMax];
+  T pending[kSmallMax / 2 + 1];
+  const int remSize = half + (N % 2);
+  for (int k = 0; k < half; ++k) {
+    mainChain[k + 1] = a[winners[k].index];
+    pending[k] = a[winners[k].index + half];
+  }
+  if (N % 2 == 1) pending[half] = a[N - 1];
+  mainChain[0] = pending[0];
+  ArrayChain<T> chain = {mainChain, half + 1, pending};
+  jacobsthalInsertInto(chain, remSize, N, branchless);
+  std::copy(mainChain, mainChain + N, a);
+}
+
+// ========= mergeAbove =========
+// cutoff 以下になるまで半分に分け、その区間は sortRecords、あとは安定にマージする
+
+template <typename Container, typename Compare, typename Index>
+template <typename T, typename Link>
+void PmergeMe<Container, Compare, Index>::mergeSortRuns(T* a, T* tmp, int N, int cutoff,
+                                                        ScratchArena<T>& own,
+                                                        ScratchArena<Link>& links,
+                                                        unsigned flags) {
+  if (N <= cutoff) {
+    sortRecords(a, N, own, links, flags);
+    return;
+  }
+  const int half = N / 2;
+  mergeSortRuns(a, tmp, half, cutoff, own, links, flags);
+  mergeSortRuns(a + half, tmp + half, N - half, cutoff, own, links, flags);
+  long comparisons = 0;
+  int i = 0, j = half, k = 0;
+  while (i < half && j < N) {
+    ++comparisons;
+    tmp[k++] = comp_(keyOf(a[j]), keyOf(a[i])) ? a[j++] : a[i++];
+  }
+  while (i < half) tmp[k++] = a[i++];
+  while (j < N) tmp[k++] = a[j++];
+  std::copy(tmp, tmp + N, a);
+  comparisons_ += comparisons;
+}
+
+// ========= 並列版 =========
+// Jacobsthal のグループ内の要素は、それぞれ chain の先頭 upperBoundIx 個だけを探す。
+// グループを挿入し始める前の chain で探しても、相方 (main の要素) の位置は変わらないか
+// 前にずれるだけなので上限はそのまま使える。そこで位置をまとめて並列に求め、
+// 位置ごとに数えて 1 回の併合でグループ全体を入れる (挿入は O(N log N) になる)。
+// 同じ隙間に入る要素同士だけは追加で比較して並べる。
+
+template <typename Container, typename Compare, typename Index>
+const int PmergeMe<Container, Compare, Index>::kParallelMinSize;
+template <typename Container, typename Compare, typename Index>
+const std::size_t PmergeMe<Container, Compare, Index>::kParallelGrain;
+
+template <typename Container, typename Compare, typename Index>
+std::size_t PmergeMe<Container, Compare, Index>::parallelArenaSize(int N) {
+  std::size_t total = 0;
+  for (; N > 2; N /= 2) total += 3 * static_cast<std::size_t>(N) + 2; // winners, chain x2, pending
+  return total;
+}
+
+// 組ごとに比較して大きい方を前半に置き、勝者 {キー, 位置} を書き出す
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+long PmergeMe<Container, Compare, Index>::PairJob<T>::operator()(std::size_t begin, std::size_t end) const {
+  long comparisons = 0;
+  for (std::size_t i = begin; i < end; ++i) {
+    ++comparisons;
+    if ((*comp)(keyOf(a[i]), keyOf(a[i + half]))) std::swap(a[i], a[i + half]);
+    makeLink(winners[i], a[i], static_cast<int>(i));
+  }
+  return comparisons;
+}
+
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+long PmergeMe<Container, Compare, Index>::GatherJob<T>::operator()(std::size_t begin, std::size_t end) const {
+  for (std::size_t k = begin; k < end; ++k) {
+    mainChain[k + 1] = a[winners[k].index];
+    pending[k] = a[winners[k].index + half];
+  }
+  return 0;
+}
+
+// pending[k] の入る隙間 (chain[p] の直前) を求め、隙間ごとに数える
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+long PmergeMe<Container, Compare, Index>::SearchJob<T>::operator()(std::size_t begin, std::size_t end) const {
+  long comparisons = 0;
+  ArrayChain<const T> view = {chain, size, pending}; // 読むだけ
+  for (std::size_t k = begin; k < end; ++k) {
+    pos[k] = searchInsertPos(view, keyOf(pending[k]), right, *comp, comparisons);
+    __atomic_add_fetch(&count[pos[k]], 1, __ATOMIC_RELAXED);
+  }
+  return comparisons;
+}
+
+// 隙間ごとの区間 [start[p], start[p + 1]) に要素番号を置く (区間内の順番は merge で決める)
+template <typename Container, typename Compare, typename Index>
+long PmergeMe<Container, Compare, Index>::ScatterJob::operator()(std::size_t begin, std::size_t end) const {
+  for (std::size_t k = begin; k < end; ++k)
+    gapItems[start[pos[k]] + __atomic_fetch_add(&cursor[pos[k]], 1, __ATOMIC_RELAXED)] =
+        static_cast<int>(k);
+  return 0;
+}
+
+// 隙間 q の要素 (キー順、同じキーは番号順) と chain[q] を next に書く
+// ScatterJob が置いた順番はスレッドの進み方で変わるので、まず番号順にしてから比較する
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+long PmergeMe<Container, Compare, Index>::MergeJob<T>::operator()(std::size_t begin, std::size_t end) const {
+  long comparisons = 0;
+  for (std::size_t q = begin; q < end; ++q) {
+    const int first = start[q];
+    const int last = start[q + 1];
+    if (last - first > 1) {
+      std::sort(gapItems + first, gapItems + last);
+      if (last - first > 16) {
+        std::stable_sort(gapItems + first, gapItems + last, KeyLess<T>(*comp, pending, comparisons));
+      } else {
+        for (int k = first + 1; k < last; ++k) { // たいてい 2 個なので挿入ソート
+          const int item = gapItems[k];
+          int m = k;
+          while (m > first) {
+            ++comparisons;
+            if (!(*comp)(keyOf(pending[item]), keyOf(pending[gapItems[m - 1]]))) break;
+            gapItems[m] = gapItems[m - 1];
+            --m;
+          }
+          gapItems[m] = item;
+        }
+      }
+    }
+    T* out = next + q + first;
+    for (int k = first; k < last; ++k) *out++ = pending[gapItems[k]];
+    if (static_cast<int>(q) < size) *out = chain[q];
+    cursor[q] = 0;
+  }
+  return comparisons;
+}
+
+template <typename Container, typename Compare, typename Index>
+template <typename T>
+void PmergeMe<Container, Compare, Index>::sortRecordsParallel(T* a, int N, ScratchArena<T>& own,
+                                              ScratchArena<ChainEntry>& links,
+                                              unsigned threads) {
+  if (threads == 0 || N < kParallelMinSize) {
+    sortRecords(a, N, own, links, kBlocked);
+    return;
+  }
+  long comparisons = 0;
+  const int half = N / 2;
+  const std::size_t linkMark = links.mark();
+  ChainEntry* winners = links.take(half);
+  PairJob<T> pairs = {&comp_, a, winners, half};
+  comparisons += parallelFor(pairs, half, threads, kParallelGrain);
+  sortRecordsParallel(winners, half, links, links, threads);
+
+  const std::size_t ownMark = own.mark();
+  const int remSize = half + (N % 2);
+  T* chain = own.take(N);
+  T* next = own.take(N);
+  T* pending = own.take(remSize);
+  GatherJob<T> gather = {a, winners, chain, pending, half};
+  parallelFor(gather, half, threads, kParallelGrain);
+  if (N % 2 == 1) pending[half] = a[N - 1];
+  chain[0] = pending[0];
+
+  // count[p]: 隙間 p に入る数 (ScatterJob では置いた数、MergeJob が 0 に戻す)
+  std::vector<int> count(N + 1, 0);
+  std::vector<int> start(N + 2);
+  std::vector<int> pos(remSize);
+  std::vector<int> gapItems(remSize);
+  int size = half + 1;
+  std::size_t numInserted  = 1;
+  std::size_t prevGroup    = 0;
+  std::size_t curGroup     = 2;
+  std::size_t upperBoundIx = (N - 1 < 4 ? N - 1 : 3);
+  const std::size_t remCount = remSize;
+  while (numInserted < remCount) {
+    const std::size_t g = std::min(curGroup, remCount - numInserted);
+    const T* group = pending + numInserted;
+    SearchJob<T> search = {&comp_, chain, size, group, static_cast<int>(upperBoundIx) - 1,
+                           &pos[0], &count[0]};
+    comparisons += parallelFor(search, g, threads, kParallelGrain);
+    int run = 0;
+    for (int p = 0; p <= size; ++p) {
+      start[p] = run;
+      run += count[p];
+      count[p] = 0;
+    }
+    start[size + 1] = run;
+    ScatterJob scatter = {&pos[0], &start[0], &count[0], &gapItems[0]};
+    parallelFor(scatter, g, threads, kParallelGrain);
+    MergeJob<T> merge = {&comp_, chain, size, group, &start[0], &gapItems[0], &count[0], next};
+    comparisons += parallelFor(merge, size + 1, threads, kParallelGrain);
+    std::swap(chain, next);
+    size += static_cast<int>(g);
+
+    numInserted += g;
+    std::size_t nextGroup = curGroup + 2 * prevGroup;
+    prevGroup    = curGroup;
+    curGroup     = nextGroup;
+    upperBoundIx = 2 * upperBoundIx + 1;
+  }
+  std::copy(chain, chain + N, a);
+  own.release(ownMark);
+  links.release(linkMark);
+  comparisons_ += comparisons;
+}
+
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::sortIndicesArena(typename Container::iterator first,
+                                                     typename Container::iterator last,
+                                                     bool blocked) {
+  const int N = static_cast<int>(std::distance(first, last));
+  ScratchArena<ChainEntry> arena(N + arenaSize(N));
+  ChainEntry* recs = arena.take(N);
+  for (int i = 0; i < N; ++i, ++first) {
+    recs[i].value = *first;
+    recs[i].index = static_cast<Index>(i);
+  }
+  sortRecords(recs, N, arena, arena, blocked ? kBlocked : 0);
+  index_container out(N);
+  for (int i = 0; i < N; ++i) out[i] = recs[i].index;
+  return out;
+}
+
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::mergeInsertionSortArena(typename Container::iterator first,
+                                                            typename Container::iterator last) {
+  return sortIndicesArena(first, last, false);
+}
+
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::mergeInsertionSortBlocked(typename Container::iterator first,
+                                                              typename Container::iterator last) {
+  return sortIndicesArena(first, last, true);
+}
+
+// 勝者の再帰にもキーへのポインタを渡すので、キーは 1 回もコピーしない
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::mergeInsertionSortIndirect(typename Container::const_iterator first,
+                                                               typename Container::const_iterator last) {
+  const int N = static_cast<int>(std::distance(first, last));
+  ScratchArena<KeyRef> arena(N + arenaSize(N));
+  KeyRef* recs = arena.take(N);
+  for (int i = 0; i < N; ++i, ++first) {
+    recs[i].key = &*first;
+    recs[i].index = static_cast<Index>(i);
+  }
+  sortRecords(recs, N, arena, arena, kBlocked);
+  index_container out(N);
+  for (int i = 0; i < N; ++i) out[i] = recs[i].index;
+  return out;
+}
+
+template <typename Container, typename Compare, typename Index>
+typename PmergeMe<Container, Compare, Index>::index_container
+PmergeMe<Container, Compare, Index>::mergeInsertionSortParallel(typename Container::iterator first,
+                                                               typename Container::iterator last,
+                                                               unsigned threads) {
+  const int N = static_cast<int>(std::distance(first, last));
+  ScratchArena<ChainEntry> arena(N + parallelArenaSize(N));
+  ChainEntry* recs = arena.take(N);
+  for (int i = 0; i < N; ++i, ++first) {
+    recs[i].value = *first;
+    recs[i].index = static_cast<Index>(i);
+  }
+  sortRecordsParallel(recs, N, arena, arena, threads);
+  index_container out(N);
+  for (int i = 0; i < N; ++i) out[i] = recs[i].index;
+  return out;
+}
+
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::sortValues(typename Container::iterator first,
+                                     typename Container::iterator last, Search search) {
+  const int N = static_cast<int>(std::distance(first, last));
+  ScratchArena<value_type> values(N + arenaSize(N));
+  ScratchArena<ChainEntry> links(arenaSize(N));
+  value_type* a = values.take(N);
+  std::copy(first, last, a);
+  sortRecords(a, N, values, links,
+              kBlocked | (search == SEARCH_BRANCHLESS ? kBranchless : 0));
+  std::copy(a, a + N, first);
+}
+
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::sortValues(typename Container::iterator first,
+                                     typename Container::iterator last, const Options& options) {
+  const int N = static_cast<int>(std::distance(first, last));
+  const bool merge = options.mergeAbove > 0 && N > options.mergeAbove;
+  ScratchArena<value_type> values(N + arenaSize(N) + (merge ? N : 0));
+  ScratchArena<ChainEntry> links(arenaSize(N));
+  value_type* a = values.take(N);
+  std::copy(first, last, a);
+  const unsigned flags = kBlocked
+                       | (options.search == SEARCH_BRANCHLESS ? kBranchless : 0)
+                       | (options.smallKernels ? kSmallKernels : 0);
+  if (merge)
+    mergeSortRuns(a, values.take(N), N, options.mergeAbove, values, links, flags);
+  else
+    sortRecords(a, N, values, links, flags);
+  std::copy(a, a + N, first);
+}
+
+template <typename Container, typename Compare, typename Index>
+void PmergeMe<Container, Compare, Index>::sortWithPayload(typename Container::iterator first,
+                                          typename Container::iterator last, uint64_t* ids) {
+  const int N = static_cast<int>(std::distance(first, last));
+  ScratchArena<KeyedEntry> recs(N + arenaSize(N));
+  ScratchArena<ChainEntry> links(arenaSize(N));
+  KeyedEntry* a = recs.take(N);
+  typename Container::iterator it = first;
+  for (int i = 0; i < N; ++i, ++it) {
+    a[i].key = *it;
+    a[i].id = ids[i];
+  }
+  sortRecords(a, N, recs, links, kBlocked);
+  for (int i = 0; i < N; ++i, ++first) {
+    *first = a[i].key;
+    ids[i] = a[i].id;
+  }
+}
+
 #endif // PMERGE_ME_TPP
@@ -0,0 +1,31 @@
+#ifndef SCRATCHARENA_HPP
+#define SCRATCHARENA_HPP
+#include <vector>
+#include <cstddef>      // for std::size_t
+
+// 一度だけ確保した領域からスタック順に切り出す (release で mark まで戻す)
+// PmergeMe の再帰で、各段の作業用配列を毎回 new しないために使う
+template <typename T>
+class ScratchArena {
+public:
+    explicit ScratchArena(std::size_t capacity) : buf_(capacity), top_(0) {}
+    ~ScratchArena() {}
+
+    T* take(std::size_t n) {
+        T* p = buf_.empty() ? 0 : &buf_[0] + top_;
+        top_ += n;
+        return p;
+    }
+    std::size_t mark() const { return top_; }
+    void release(std::size_t mark) { top_ = mark; }
+    std::size_t capacity() const { return buf_.size(); }
+
+private:
+    ScratchArena(const ScratchArena&);
+    ScratchArena& operator=(const ScratchArena&);
+
+    std::vector<T> buf_;
+    std::size_t top_;
+};
+
+#endif // SCRATCHARENA_HPP
@@ -5,10 +5,7 @@
 #include <deque>        // for std::deque
 #include <sstream>      // for std::stringstream
 #include <iomanip>  // for std::setw
-#include <ctime>    // for clock_t, clock(), CLOCKS_PER_SEC
-#ifdef DEBUG
-int num_comparisons = 0;
-#endif
+#include <time.h>   // for clock_gettime
 
 bool parseArgs(int argc, char** argv,
                std::vector<int>& vectorInput,
@@ -45,51 +42,53 @@ void printContainer(const Container& container) {
   std::cout << std::endl;
 }
 
+// clock() は CPU 時間で粒度も粗いので、単調増加クロックで測る
+static double nowMicros() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) * 1e6 + static_cast<double>(ts.tv_nsec) * 1e-3;
+}
+
 template <typename Container>
 double benchSortAndPrint(Container& input, const std::string& label, int countShown) {
   PmergeMe<Container> sorter;
-  clock_t start = clock();
-  Container indices = sorter.mergeInsertionSort(input.begin(), input.end());
-  clock_t end = clock();
-  // ソート結果の検証
+  const double start = nowMicros();
+  typename PmergeMe<Container>::index_container indices =
+      sorter.mergeInsertionSort(input.begin(), input.end());
+  const double end = nowMicros();
+  // ソート結果の検証 (時間には含めない)
+  // 1. インデックスが 0..N-1 を 1 回ずつ含むか (これで要素は元の配列と一致する)
+  if (indices.size() != input.size()) {
+    throw std::runtime_error("Sort error: Result size mismatch");
+  }
+  std::vector<bool> seen(input.size(), false);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const size_t idx = static_cast<size_t>(indices[i]);
+    if (idx >= seen.size() || seen[idx]) {
+      throw std::runtime_error("Sort error: Elements don't match original input");
+    }
+    seen[idx] = true;
+  }
   Container sortedResult;
   for (size_t i = 0; i < indices.size(); ++i) {
     sortedResult.push_back(input[indices[i]]);
   }
-  // 1. サイズチェック
-  if (sortedResult.size() != input.size()) {
-    throw std::runtime_error("Sort error: Result size mismatch");
-  }
   // 2. ソート順序チェック（昇順になっているか）
   for (size_t i = 1; i < sortedResult.size(); ++i) {
     if (sortedResult[i] < sortedResult[i-1]) {
       throw std::runtime_error("Sort error: Result is not in ascending order");
     }
   }
-  // 3. 要素の一致チェック（元の配列と同じ要素が含まれているか）
-  Container originalCopy = input;
-  Container resultCopy = sortedResult;
-  std::sort(originalCopy.begin(), originalCopy.end());
-  std::sort(resultCopy.begin(), resultCopy.end());
-  if (originalCopy.size() != resultCopy.size()) {
-    throw std::runtime_error("Sort error: Element count mismatch");
-  }
-  for (size_t i = 0; i < originalCopy.size(); ++i) {
-    if (originalCopy[i] != resultCopy[i]) {
-      throw std::runtime_error("Sort error: Elements don't match original input");
-    }
-  }
 
   #ifdef DEBUG
-  std::cout << label << ": number of comparisons: " << num_comparisons << "\n";
-  num_comparisons = 0; // Reset for next measurement
+  std::cout << label << ": number of comparisons: " << sorter.comparisons() << "\n";
   #endif
   std::cout << "After (" << label << "); ";
   printContainer(sortedResult);
   // for (size_t i = 0; i < indices.size(); ++i) {
   //   std::cout << input[indices[i]] << (i == indices.size() - 1 ? "\n" : " ");
   // }
-  double us = static_cast<double>(end - start) / CLOCKS_PER_SEC * 1e6;
+  double us = end - start;
   std::cout << "Time to process a range of " << std::setw(4) << countShown
             << " elements with std::" << label << " : " << us << " us" << std::endl;
   return us;
@@ -1,7 +1,24 @@
 #include "../ex00/BitcoinExchange.hpp"
+#include "../ex00/Utils.hpp"
+#include "../ex00/LiveRateTable.hpp"
+#include "../ex00/QueryServer.hpp"
 #include <gtest/gtest.h>
 #include <sstream>
 #include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 TEST(BitcoinExchangeTest, ValidDate) {
     EXPECT_TRUE(BitcoinExchange::isValidDate("2023-01-01"));
@@ -100,3 +117,962 @@ TEST(BitcoinExchangeTest, InputEdgeCases) {
     EXPECT_EQ(out.str(), answer_out);
     EXPECT_EQ(err.str(), answer_err);
 }
+
+TEST(RateTableTest, FlatBackendMatchesMap) {
+    static const char* csv =
+        "date,exchange_rate\n"
+        "2011-01-03,0.3\n"
+        "2011-01-09,0.32\n"
+        "2011-01-09,0.35\n"     // duplicate: last one wins
+        "2012-02-29,1.0\n"
+        "2012-01-11,7.1\n";     // out of order
+    static const char* dates[] = {
+        "2009-01-01", "2011-01-02", "2011-01-03", "2011-01-04",
+        "2011-01-09", "2011-12-31", "2012-01-11", "2012-02-28",
+        "2012-02-29", "2012-03-01", "2099-12-31"
+    };
+    std::istringstream dbMap(csv), dbFlat(csv);
+    RateTable map(RateTable::MAP), flat(RateTable::FLAT);
+    map.load(dbMap);
+    flat.load(dbFlat);
+    EXPECT_EQ(map.size(), flat.size());
+    for (std::size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); ++i) {
+        double a = -1.0, b = -1.0;
+        bool fa = map.getRateForDate(dates[i], a);
+        bool fb = flat.getRateForDate(dates[i], b);
+        EXPECT_EQ(fa, fb) << dates[i];
+        EXPECT_EQ(a, b) << dates[i];
+    }
+}
+
+// btc は FLAT を使う。日付として正しくない行は MAP では文字列キーとして残るが、
+// FLAT/DENSE では捨てられる (その日以降の問い合わせは直前の正しい行のレートになる)
+TEST(RateTableTest, FlatDropsRowsWithInvalidDates) {
+    static const char* csv =
+        "date,exchange_rate\n"
+        "2012-02-28,1.0\n"
+        "2012-02-30,5.0\n"     // 存在しない日
+        "2012-03-02,2.0\n";
+    std::istringstream dbMap(csv), dbFlat(csv), dbDense(csv);
+    RateTable map(RateTable::MAP), flat(RateTable::FLAT), dense(RateTable::DENSE);
+    map.load(dbMap);
+    flat.load(dbFlat);
+    dense.load(dbDense);
+    EXPECT_EQ(3u, map.size());
+    EXPECT_EQ(2u, flat.size());
+    double a = -1.0, b = -1.0, c = -1.0;
+    ASSERT_TRUE(map.getRateForDate("2012-03-01", a));
+    ASSERT_TRUE(flat.getRateForDate("2012-03-01", b));
+    ASSERT_TRUE(dense.getRateForDate("2012-03-01", c));
+    EXPECT_EQ(5.0, a);
+    EXPECT_EQ(1.0, b);
+    EXPECT_EQ(1.0, c);
+}
+
+// snapshot があってもなくても、同じバックエンドなら同じ答えになること
+TEST(RateTableTest, CachedLoadMatchesCsvWithInvalidDates) {
+    static const char* csvPath = "ex00_cached_invalid.csv";
+    static const char* snapPath = "ex00_cached_invalid.csv.snap";
+    {
+        std::ofstream f(csvPath);
+        f << "date,exchange_rate\n2012-02-28,1.0\n2012-02-30,5.0\n2012-03-02,2.0\n";
+    }
+    RateTable src(RateTable::FLAT);
+    src.loadFile(csvPath);
+    src.saveSnapshot(snapPath, csvPath);
+    ASSERT_TRUE(RateTable::isSnapshotFresh(snapPath, csvPath));
+
+    RateTable map(RateTable::MAP);
+    map.loadCached(csvPath); // MAP は snapshot を使わない
+    EXPECT_EQ(3u, map.size());
+    double r = -1.0;
+    ASSERT_TRUE(map.getRateForDate("2012-03-01", r));
+    EXPECT_EQ(5.0, r);
+
+    BitcoinExchange app((std::string(csvPath))); // 既定は FLAT
+    std::istringstream in("date | value\n2012-03-01 | 1\n");
+    std::ostringstream out, err;
+    app.run(in, out, err);
+    EXPECT_EQ("2012-03-01 => 1 = 1\n", out.str());
+    std::remove(csvPath);
+    std::remove(snapPath);
+}
+
+TEST(RateTableTest, FlatBackendEmptyDatabase) {
+    std::istringstream db("date,exchange_rate\nnot-a-date,1.0\n");
+    RateTable flat(RateTable::FLAT);
+    EXPECT_THROW(flat.load(db), std::runtime_error);
+}
+
+TEST(RateTableTest, DenseBackendMatchesMap) {
+    static const char* csv =
+        "date,exchange_rate\n"
+        "2011-01-03,0.3\n"
+        "2011-01-09,0.32\n"
+        "2012-02-29,1.0\n"
+        "2012-01-11,7.1\n";
+    static const char* dates[] = {
+        "2011-01-02", "2011-01-03", "2011-01-04", "2011-01-08",
+        "2011-01-09", "2012-01-10", "2012-01-11", "2012-02-29",
+        "2012-03-01", "9999-12-31"
+    };
+    std::istringstream dbMap(csv), dbDense(csv);
+    RateTable map(RateTable::MAP), dense(RateTable::DENSE);
+    map.load(dbMap);
+    dense.load(dbDense);
+    EXPECT_EQ(map.size(), dense.size());
+    // 2011-01-03 .. 2012-02-29 = 423 days
+    EXPECT_EQ(dense.memoryFootprint(), 423 * sizeof(double));
+    for (std::size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); ++i) {
+        double a = -1.0, b = -1.0;
+        EXPECT_EQ(map.getRateForDate(dates[i], a),
+                  dense.getRateForDate(dates[i], b)) << dates[i];
+        EXPECT_EQ(a, b) << dates[i];
+    }
+}
+
+// 前の日と同じレートの行も DENSE の extend で消えないこと
+TEST(RateTableTest, ExtendKeepsRepeatedRates) {
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        std::istringstream db("date,exchange_rate\n2020-01-10,1\n2020-01-20,1\n");
+        std::istringstream more("2020-01-15,2\n");
+        RateTable table(backends[b]);
+        table.load(db);
+        table.extend(more);
+        EXPECT_EQ(3u, table.size()) << "backend " << b;
+        double r = -1.0;
+        ASSERT_TRUE(table.getRateForDate("2020-01-15", r));
+        EXPECT_EQ(2.0, r) << "backend " << b;
+        ASSERT_TRUE(table.getRateForDate("2020-01-20", r));
+        EXPECT_EQ(1.0, r) << "backend " << b;
+        ASSERT_TRUE(table.getRateForDate("2020-01-25", r));
+        EXPECT_EQ(1.0, r) << "backend " << b;
+    }
+}
+
+// getRatesForDays は昇順・降順・ランダム・重複のどの並びでも getRateForDay と同じ結果
+TEST(RateTableTest, BatchLookupMatchesSingle) {
+    std::string csv = "date,exchange_rate\n";
+    char buf[64];
+    for (int i = 0; i < 400; i += 1 + i % 5) {
+        char date[DATE_TOTAL_LEN];
+        formatDayNumber(daysFromCivil(2011, 1, 3) + i, date);
+        std::sprintf(buf, "%.10s,%d.5\n", date, i);
+        csv += buf;
+    }
+    std::vector<uint32_t> days;
+    const uint32_t first = daysFromCivil(2011, 1, 1);
+    for (uint32_t d = 0; d < 420; ++d) days.push_back(first + d);        // ascending
+    for (uint32_t d = 420; d > 0; --d) days.push_back(first + d - 1);    // descending
+    for (uint32_t d = 0; d < 420; ++d) days.push_back(first + (d * 37) % 420); // scattered
+    for (int k = 0; k < 5; ++k) days.push_back(first + 100);              // repeated
+    days.push_back(0);
+
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        std::istringstream db(csv);
+        RateTable table(backends[b]);
+        table.load(db);
+        std::vector<double> rates(days.size(), -1.0);
+        bool found[2000];
+        std::size_t hits = table.getRatesForDays(&days[0], days.size(), &rates[0], found);
+        std::size_t expectedHits = 0;
+        for (std::size_t i = 0; i < days.size(); ++i) {
+            double r = -1.0;
+            const bool ok = table.getRateForDay(days[i], r);
+            expectedHits += ok;
+            ASSERT_EQ(ok, found[i]) << b << " " << i;
+            if (ok) {
+                EXPECT_EQ(r, rates[i]) << b << " " << i;
+            }
+        }
+        EXPECT_EQ(expectedHits, hits);
+    }
+}
+
+// loadFile (mmap) は load (stream) と同じ行を採用・スキップすること
+TEST(RateTableTest, MmapLoaderMatchesStreamLoader) {
+    static const std::string csv =
+        "  date,exchange_rate\r\n"      // header with spaces and CRLF
+        "2011-01-03,0.3\r\n"
+        "\n"
+        "2011-01-05\n"                  // no comma
+        " 2011-01-07 , 0.31 \n"         // spaces around fields
+        "2011-01-08,\n"                 // empty rate
+        ",1.0\n"                        // empty date
+        "2011-01-09,0.32x\n"            // trailing junk
+        "2011-01-10,abc\n"              // not a number
+        "2011-01-04,0.29\n"             // out of order
+        "2011-01-03,0.28\n"             // duplicate: last one wins
+        "2012-01-11,7.1";               // no trailing newline
+    static const char* path = "ex00_mmap_test.csv";
+    {
+        std::ofstream f(path);
+        f << csv;
+    }
+    static const char* dates[] = {
+        "2011-01-02", "2011-01-03", "2011-01-04", "2011-01-06",
+        "2011-01-07", "2011-01-09", "2011-01-10", "2012-01-11"
+    };
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        std::istringstream db(csv);
+        RateTable stream(backends[b]), mapped(backends[b]);
+        stream.load(db);
+        mapped.loadFile(path);
+        EXPECT_EQ(stream.size(), 4u);
+        EXPECT_EQ(mapped.size(), stream.size());
+        for (std::size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); ++i) {
+            double a = -1.0, c = -1.0;
+            EXPECT_EQ(stream.getRateForDate(dates[i], a),
+                      mapped.getRateForDate(dates[i], c)) << dates[i];
+            EXPECT_EQ(a, c) << dates[i];
+        }
+    }
+    std::remove(path);
+}
+
+TEST(RateTableTest, MmapLoaderMissingFile) {
+    RateTable table(RateTable::FLAT);
+    EXPECT_THROW(table.loadFile("no/such/data.csv"), std::runtime_error);
+}
+
+TEST(RateTableTest, SnapshotRoundTrip) {
+    static const char* csvPath = "ex00_snapshot_test.csv";
+    static const char* snapPath = "ex00_snapshot_test.csv.snap";
+    {
+        std::ofstream f(csvPath);
+        f << "date,exchange_rate\n2011-01-03,0.3\n2011-01-09,0.32\n2012-01-11,7.1\n";
+    }
+    RateTable src(RateTable::FLAT);
+    src.loadFile(csvPath);
+    EXPECT_FALSE(RateTable::isSnapshotFresh(snapPath, csvPath));
+    src.saveSnapshot(snapPath, csvPath);
+    EXPECT_TRUE(RateTable::isSnapshotFresh(snapPath, csvPath));
+
+    static const char* dates[] = {
+        "2011-01-02", "2011-01-03", "2011-01-05", "2011-01-09", "2013-01-01"
+    };
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        RateTable snap(backends[b]);
+        snap.loadSnapshot(snapPath);
+        EXPECT_EQ(snap.size(), src.size());
+        for (std::size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); ++i) {
+            double a = -1.0, c = -1.0;
+            EXPECT_EQ(src.getRateForDate(dates[i], a),
+                      snap.getRateForDate(dates[i], c)) << dates[i];
+            EXPECT_EQ(a, c) << dates[i];
+        }
+    }
+
+    // CSV が変わったら snapshot は使わない
+    {
+        std::ofstream f(csvPath, std::ios::app);
+        f << "2013-01-01,13.0\n";
+    }
+    EXPECT_FALSE(RateTable::isSnapshotFresh(snapPath, csvPath));
+    RateTable cached(RateTable::FLAT);
+    cached.loadCached(csvPath);
+    EXPECT_EQ(cached.size(), 4u);
+    std::remove(csvPath);
+    std::remove(snapPath);
+}
+
+// 同じ秒・同じ長さの書き直しや、rename での置き換えも snapshot を古くする
+TEST(RateTableTest, SnapshotStaleAfterSameSizeRewrite) {
+    static const char* csvPath = "ex00_snapshot_same.csv";
+    static const char* snapPath = "ex00_snapshot_same.csv.snap";
+    static const char* nextPath = "ex00_snapshot_same.csv.next";
+    {
+        std::ofstream f(csvPath);
+        f << "date,exchange_rate\n2011-01-03,0.3\n";
+    }
+    RateTable src(RateTable::FLAT);
+    src.loadFile(csvPath);
+    src.saveSnapshot(snapPath, csvPath);
+    struct stat before;
+    ASSERT_EQ(0, ::stat(csvPath, &before));
+    ASSERT_TRUE(RateTable::isSnapshotFresh(snapPath, csvPath));
+
+    // 同じ長さで書き直し、mtime は同じ秒の中で別のナノ秒にする
+    {
+        std::ofstream f(csvPath);
+        f << "date,exchange_rate\n2011-01-03,0.4\n";
+    }
+    struct timespec times[2];
+    times[0] = before.st_atim;
+    times[1] = before.st_mtim;
+    times[1].tv_nsec = (before.st_mtim.tv_nsec + 1) % 1000000000;
+    ASSERT_EQ(0, ::utimensat(AT_FDCWD, csvPath, times, 0));
+    EXPECT_FALSE(RateTable::isSnapshotFresh(snapPath, csvPath));
+
+    // 長さも mtime も同じだが、rename で別のファイルに置き換えた
+    times[1] = before.st_mtim;
+    ASSERT_EQ(0, ::utimensat(AT_FDCWD, csvPath, times, 0));
+    src.saveSnapshot(snapPath, csvPath);
+    ASSERT_TRUE(RateTable::isSnapshotFresh(snapPath, csvPath));
+    {
+        std::ofstream f(nextPath);
+        f << "date,exchange_rate\n2011-01-03,0.5\n";
+    }
+    ASSERT_EQ(0, ::utimensat(AT_FDCWD, nextPath, times, 0));
+    ASSERT_EQ(0, std::rename(nextPath, csvPath));
+    EXPECT_FALSE(RateTable::isSnapshotFresh(snapPath, csvPath));
+    RateTable cached(RateTable::FLAT);
+    cached.loadCached(csvPath);
+    double r = -1.0;
+    ASSERT_TRUE(cached.getRateForDate("2011-01-03", r));
+    EXPECT_EQ(0.5, r);
+    std::remove(csvPath);
+    std::remove(snapPath);
+}
+
+TEST(RateTableTest, SnapshotRejectsCorruption) {
+    static const char* csvPath = "ex00_corrupt_test.csv";
+    static const char* snapPath = "ex00_corrupt_test.snap";
+    {
+        std::ofstream f(csvPath);
+        f << "date,exchange_rate\n2011-01-03,0.3\n2011-01-09,0.32\n";
+    }
+    RateTable src(RateTable::FLAT);
+    src.loadFile(csvPath);
+    src.saveSnapshot(snapPath, csvPath);
+    {
+        std::fstream f(snapPath, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(-1, std::ios::end);
+        f.put('\x7f'); // flip the last byte of values[]
+    }
+    RateTable snap(RateTable::FLAT);
+    try {
+        snap.loadSnapshot(snapPath);
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(std::string("snapshot checksum mismatch: ") + snapPath, e.what());
+    }
+    std::remove(csvPath);
+    std::remove(snapPath);
+}
+
+// runStream は run と 1 バイトも違わない出力をすること (out/err の順序も含めて)
+TEST(BitcoinExchangeTest, StreamMatchesRun) {
+    static const std::string db =
+        "2012-02-29,1.0\n2011-01-03,0.3\n2011-01-09,0.32\n2012-01-11,7.1\n";
+    static const std::string input =
+        "  date | value \r\n"
+        "2011-01-03 | abc\n"
+        "2011-01-03 |\n"
+        "| 1\n"
+        "2011-01-03\n"
+        "   \n"
+        "\n"
+        "2011-02-29 | 1\n"
+        "2012-02-29 | 1\n"
+        "2011-13-01 | 1\n"
+        "2010-12-31 | 1\n"              // before the first rate
+        "2011-01-03 | 0\n"
+        "2011-01-03 | 1000\n"
+        "2011-01-03 | 1000.01\n"
+        "2011-01-03 | -0.5\n"
+        "2011-01-03 | 1 | 2\n"
+        "2011-01-03|1\n"
+        "2011-01-03 | 1e2\n"
+        "2011-01-03 | 0.123456789\r\n"
+        "2011-01-03 | 999.9999999\n"
+        "2099-01-01 | 3";               // no trailing newline
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        std::istringstream db1(db), db2(db);
+        BitcoinExchange app1(db1, backends[b]);
+        BitcoinExchange app2(db2, backends[b]);
+        std::istringstream in1(input), in2(input);
+        std::ostringstream out1, err1, both1, both2, out2, err2;
+        app1.run(in1, out1, err1);
+        app2.runStream(in2, out2, err2);
+        EXPECT_EQ(out1.str(), out2.str());
+        EXPECT_EQ(err1.str(), err2.str());
+
+        std::istringstream in3(input), in4(input);
+        app1.run(in3, both1, both1);
+        app2.runStream(in4, both2, both2);
+        EXPECT_EQ(both1.str(), both2.str());
+    }
+}
+
+TEST(UtilsTest, FormatDoubleGMatchesPrintf) {
+    static const double fixed[] = {
+        0.0, -0.0, 1.0, 0.3, 0.36, 7.1, 300.0, 1e-5, 1e-4, 0.000123456789,
+        999999.4, 999999.5, 999999.6, 123456.5, 1234567.0, 1e21, 1e22, 2.5e-7,
+        47115.93 * 1000.0, 0.1 + 0.2, 100000.0, 1.0 / 3.0
+    };
+    char a[64], b[64];
+    for (std::size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); ++i) {
+        std::sprintf(a, "%g", fixed[i]);
+        formatDoubleG(fixed[i], b);
+        EXPECT_STREQ(a, b) << fixed[i];
+    }
+    // value * rate の典型的な組み合わせ
+    for (int v = 0; v <= 100000; v += 7) {
+        for (int r = 1; r <= 7000000; r += 99991) {
+            const double x = (v / 100.0) * (r / 100.0);
+            std::sprintf(a, "%g", x);
+            formatDoubleG(x, b);
+            ASSERT_STREQ(a, b) << v << " * " << r;
+        }
+    }
+}
+
+// runParallel はチャンクの切れ目やスレッド数に関係なく run と同じ出力になること
+TEST(BitcoinExchangeTest, ParallelMatchesRun) {
+    static const std::string db =
+        "2012-02-29,1.0\n2011-01-03,0.3\n2011-01-09,0.32\n2012-01-11,7.1\n";
+    std::string input =
+        "\n\n  date | value \r\n"
+        "2011-01-03 | abc\n"
+        "date | value\n";           // header only counts as the first line
+    static const char* lines[] = {
+        "2011-01-03 | 3\n", "2012-02-29 | 1\n", "2011-13-01 | 1\n",
+        "2010-12-31 | 1\n", "2011-01-03 | -0.5\n", "2011-01-03 | 1000.01\n",
+        "\n", "2011-01-03\n", "2011-01-09|0.123456789\r\n", "2099-01-01 | 3\n"
+    };
+    for (int i = 0; i < 500; ++i)
+        input += lines[(i * 7) % 10];
+    input += "2011-01-09 | 2"; // no trailing newline
+
+    const char* path = "ex00_parallel_input.txt";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << input;
+    }
+    std::istringstream dbIn(db);
+    BitcoinExchange app(dbIn, RateTable::FLAT);
+    std::istringstream in(input);
+    std::ostringstream expected;
+    app.run(in, expected, expected);
+
+    const unsigned threads[] = {1, 2, 3, 8};
+    const std::size_t chunks[] = {1, 7, 64, 1u << 20};
+    for (std::size_t t = 0; t < 4; ++t) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            std::ostringstream both;
+            app.runParallel(path, both, both, threads[t], chunks[c]);
+            EXPECT_EQ(expected.str(), both.str()) << threads[t] << " threads, chunk " << chunks[c];
+        }
+    }
+    std::remove(path);
+}
+
+TEST(BitcoinExchangeTest, ParallelMissingFile) {
+    std::istringstream dbIn("2011-01-03,0.3\n");
+    BitcoinExchange app(dbIn);
+    std::ostringstream out, err;
+    EXPECT_THROW(app.runParallel("no_such_input.txt", out, err, 4), std::runtime_error);
+}
+
+// ---- parseDayNumber / parseDecimalFast の fuzz (旧実装と同じ判定・同じ値になること) ----
+
+// 旧 isValidDate (checkYMD + splitYMD + atoi) のコピー
+static bool legacyIsValidDate(const std::string& date, int& y, int& m, int& day) {
+    static const int mdays[12] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    if (date.size() != DATE_TOTAL_LEN) return false;
+    for (std::size_t i = 0; i < date.size(); i++) {
+        if (i == DATE_YEAR_END || i == DATE_MONTH_END) {
+            if (date[i] != '-') return false;
+        } else {
+            if (!std::isdigit(date[i])) return false;
+        }
+    }
+    y = std::atoi(date.substr(0, DATE_YEAR_END).c_str());
+    m = std::atoi(date.substr(DATE_YEAR_END + 1, DATE_MONTH_END - DATE_YEAR_END - 1).c_str());
+    day = std::atoi(date.substr(DATE_MONTH_END + 1, DATE_TOTAL_LEN - DATE_MONTH_END - 1).c_str());
+    if (m < 1 || m > 12) return false;
+    int maxd = mdays[m-1];
+    if (m==2 && isLeapYear(y)) maxd = 29;
+    if (day < 1 || day > maxd) return false;
+    return true;
+}
+
+static uint32_t lcg(uint32_t& s) {
+    s = s * 1103515245u + 12345u;
+    return s >> 8;
+}
+
+TEST(UtilsTest, ParseDayNumberMatchesLegacy) {
+    static const char alphabet[] = "0123456789-/ a\xff:";
+    uint32_t seed = 1;
+    for (int i = 0; i < 500000; ++i) {
+        char buf[DATE_TOTAL_LEN + 2];
+        std::sprintf(buf, "%04u-%02u-%02u", lcg(seed) % 10000, lcg(seed) % 14, lcg(seed) % 33);
+        std::string s(buf);
+        if (lcg(seed) % 2) // 1-2 文字を壊す
+            s[lcg(seed) % s.size()] = alphabet[lcg(seed) % (sizeof(alphabet) - 1)];
+        if (lcg(seed) % 8 == 0)
+            s[lcg(seed) % s.size()] = alphabet[lcg(seed) % (sizeof(alphabet) - 1)];
+        if (lcg(seed) % 16 == 0)
+            s.resize(lcg(seed) % (DATE_TOTAL_LEN + 2), '0');
+        int y, m, d;
+        uint32_t day = 0;
+        const bool legacy = legacyIsValidDate(s, y, m, d);
+        ASSERT_EQ(legacy, parseDayNumber(s.data(), s.size(), day)) << s;
+        ASSERT_EQ(legacy, BitcoinExchange::isValidDate(s)) << s;
+        if (legacy) {
+            ASSERT_EQ(daysFromCivil(y, m, d), day) << s;
+        }
+    }
+}
+
+// 旧 parseDouble と同じく strtod が全体を読めた時だけ受理し、値はビット単位で一致すること
+TEST(UtilsTest, ParseDecimalFastMatchesStrtod) {
+    static const char* fixed[] = {
+        "0", "-0", "+0", "1", "-1", "0.1", ".5", "5.", ".", "-", "+", "", "1e", "1e+",
+        "1e5", "1E-5", "1e22", "1e23", "123456789012345678", "1234567890123456789",
+        "12345678901234567890", "9007199254740993", "0.000000000000000000000001",
+        "000000000000000000000000000001.5", "1.7976931348623157e308", "inf", "nan",
+        "0x10", "1.2.3", "1e5x", " 1", "1 ", "--1", "999.9999999", "1000.0000001"
+    };
+    for (std::size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); ++i) {
+        const char* s = fixed[i];
+        char* endp = 0;
+        const double ref = std::strtod(s, &endp);
+        double v = -1.0;
+        if (parseDecimalFast(s, s + std::strlen(s), v)) {
+            EXPECT_TRUE(endp != s && *endp == '\0') << s;
+            EXPECT_EQ(0, std::memcmp(&ref, &v, sizeof(v))) << s;
+        }
+    }
+    static const char alphabet[] = "0123456789.-+eE ";
+    uint32_t seed = 7;
+    std::size_t fast = 0;
+    for (int i = 0; i < 500000; ++i) {
+        char buf[40];
+        std::size_t len = 0;
+        if (lcg(seed) % 2) { // 数値らしい形
+            len = std::sprintf(buf, "%s%u.%0*u", lcg(seed) % 4 == 0 ? "-" : "",
+                               lcg(seed) % 100000, static_cast<int>(lcg(seed) % 12),
+                               lcg(seed) % 1000000);
+            if (lcg(seed) % 4 == 0)
+                len += std::sprintf(buf + len, "e%d", static_cast<int>(lcg(seed) % 60) - 30);
+        } else {
+            len = lcg(seed) % 24;
+            for (std::size_t k = 0; k < len; ++k)
+                buf[k] = alphabet[lcg(seed) % (sizeof(alphabet) - 1)];
+            buf[len] = '\0';
+        }
+        char* endp = 0;
+        const double ref = std::strtod(buf, &endp);
+        double v = -1.0;
+        if (parseDecimalFast(buf, buf + len, v)) {
+            ++fast;
+            ASSERT_TRUE(endp != buf && *endp == '\0') << buf;
+            ASSERT_EQ(0, std::memcmp(&ref, &v, sizeof(v))) << buf;
+        }
+    }
+    EXPECT_GT(fast, 200000u); // 数値らしい入力はほぼ fast path で読めること
+}
+
+// ---- LiveRateTable ----
+
+static std::string generationCsv(unsigned long g) {
+    std::ostringstream csv;
+    csv << "date,exchange_rate\n";
+    for (int d = 1; d <= 28; ++d)
+        csv << "2011-02-" << (d < 10 ? "0" : "") << d << ',' << g << '\n';
+    return csv.str();
+}
+
+struct LiveReaderArgs {
+    const LiveRateTable* table;
+    const bool* stop;
+    unsigned long lookups;
+    bool ok;
+};
+
+// 読めたレートは公開された世代のどれかで、しかも単調に増えること
+static void* liveReader(void* arg) {
+    LiveReaderArgs* a = static_cast<LiveReaderArgs*>(arg);
+    LiveRateTable::Reader reader(*a->table);
+    double last = 0.0;
+    const uint32_t first = daysFromCivil(2011, 2, 1);
+    // 1 CPU だと writer が先に終わることがあるので、最低 1 周は読む
+    do {
+        for (uint32_t d = 0; d < 40; ++d) {
+            double r = -1.0;
+            if (!reader.getRateForDay(first + d, r) || r < last || r != static_cast<long>(r)) {
+                a->ok = false;
+                return 0;
+            }
+            last = r;
+            ++a->lookups;
+        }
+    } while (!__atomic_load_n(a->stop, __ATOMIC_ACQUIRE));
+    return 0;
+}
+
+TEST(LiveRateTableTest, ConcurrentReadersAndReloader) {
+    LiveRateTable table(RateTable::FLAT);
+    {
+        std::istringstream in(generationCsv(1));
+        table.reload(in);
+    }
+    bool stop = false;
+    LiveReaderArgs args[4];
+    pthread_t tids[4];
+    for (int i = 0; i < 4; ++i) {
+        args[i].table = &table;
+        args[i].stop = &stop;
+        args[i].lookups = 0;
+        args[i].ok = true;
+        ASSERT_EQ(0, pthread_create(&tids[i], 0, liveReader, &args[i]));
+    }
+    for (unsigned long g = 2; g <= 300; ++g) {
+        std::istringstream in(generationCsv(g));
+        if (g % 3 == 0)
+            table.extend(in); // 全部の日付を上書きするので reload と同じ結果
+        else
+            table.reload(in);
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; ++i) {
+        pthread_join(tids[i], 0);
+        EXPECT_TRUE(args[i].ok) << "reader " << i;
+        EXPECT_GT(args[i].lookups, 0u);
+    }
+    EXPECT_EQ(300u, table.generation());
+    LiveRateTable::Reader reader(table);
+    double r = 0.0;
+    EXPECT_TRUE(reader.getRateForDate("2011-03-01", r));
+    EXPECT_EQ(300.0, r);
+}
+
+TEST(LiveRateTableTest, RefreshReadsAppendedLines) {
+    const char* path = "ex00_live_rates.csv";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << "date,exchange_rate\n2011-01-03,0.3\n";
+    }
+    const RateTable::Backend backends[] = {
+        RateTable::MAP, RateTable::FLAT, RateTable::DENSE
+    };
+    for (std::size_t b = 0; b < 3; ++b) {
+        {
+            std::ofstream f(path, std::ios::binary | std::ios::trunc);
+            f << "date,exchange_rate\n2011-01-03,0.3\n";
+        }
+        LiveRateTable table(backends[b]);
+        LiveRateTable::Reader reader(table);
+        double r = 0.0;
+        EXPECT_FALSE(reader.getRateForDate("2011-01-03", r)); // nothing published yet
+        EXPECT_TRUE(table.refresh(path));
+        EXPECT_FALSE(table.refresh(path));
+        {
+            std::ofstream f(path, std::ios::binary | std::ios::app);
+            f << "2011-01-05,0.5\n2011-01-0";  // partial last line
+        }
+        EXPECT_TRUE(table.refresh(path));
+        EXPECT_EQ(2u, reader.size());
+        EXPECT_TRUE(reader.getRateForDate("2011-01-09", r));
+        EXPECT_EQ(0.5, r);
+        {
+            std::ofstream f(path, std::ios::binary | std::ios::app);
+            f << "9,0.9\n2011-01-03,0.4\n";
+        }
+        EXPECT_TRUE(table.refresh(path));
+        EXPECT_TRUE(reader.getRateForDate("2011-01-09", r));
+        EXPECT_EQ(0.9, r);
+        EXPECT_TRUE(reader.getRateForDate("2011-01-04", r));
+        EXPECT_EQ(0.4, r); // later row for the same date wins
+        {
+            std::ofstream f(path, std::ios::binary | std::ios::trunc); // rewritten, smaller
+            f << "2012-01-01,7\n";
+        }
+        EXPECT_TRUE(table.refresh(path));
+        EXPECT_EQ(1u, reader.size());
+        EXPECT_FALSE(reader.getRateForDate("2011-12-31", r));
+        EXPECT_EQ(4u, table.generation());
+    }
+    std::remove(path);
+}
+
+// reload(path) は最後の '\n' までだけ読み、残りは次の refresh に回す
+TEST(LiveRateTableTest, ReloadLeavesPartialLastLine) {
+    const char* path = "ex00_live_partial.csv";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << "date,exchange_rate\n2011-01-03,0.3\n2011-01-0";
+    }
+    LiveRateTable table(RateTable::FLAT);
+    LiveRateTable::Reader reader(table);
+    table.reload(std::string(path));
+    EXPECT_EQ(1u, reader.size());
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::app);
+        f << "5,0.5\n";
+    }
+    EXPECT_TRUE(table.refresh(path));
+    EXPECT_EQ(2u, reader.size());
+    double r = 0.0;
+    EXPECT_TRUE(reader.getRateForDate("2011-01-06", r));
+    EXPECT_EQ(0.5, r);
+    std::remove(path);
+}
+
+// 縮まない書き直しも refresh で読み直すこと
+TEST(LiveRateTableTest, RefreshReloadsReplacedFile) {
+    const char* path = "ex00_live_replaced.csv";
+    const char* nextPath = "ex00_live_replaced.csv.next";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << "date,exchange_rate\n2011-01-03,0.3\n";
+    }
+    LiveRateTable table(RateTable::FLAT);
+    LiveRateTable::Reader reader(table);
+    EXPECT_TRUE(table.refresh(path));
+    struct stat before;
+    ASSERT_EQ(0, ::stat(path, &before));
+
+    // 同じ長さで書き直し、mtime は同じ秒の中で別のナノ秒にする
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << "date,exchange_rate\n2011-01-03,0.4\n";
+    }
+    struct timespec times[2];
+    times[0] = before.st_atim;
+    times[1] = before.st_mtim;
+    times[1].tv_nsec = (before.st_mtim.tv_nsec + 1) % 1000000000;
+    ASSERT_EQ(0, ::utimensat(AT_FDCWD, path, times, 0));
+    EXPECT_TRUE(table.refresh(path));
+    double r = 0.0;
+    EXPECT_TRUE(reader.getRateForDate("2011-01-03", r));
+    EXPECT_EQ(0.4, r);
+    EXPECT_FALSE(table.refresh(path));
+
+    // rename で長い別のファイルに置き換えた (追記に見えても読み直す)
+    {
+        std::ofstream f(nextPath, std::ios::binary);
+        f << "date,exchange_rate\n2012-01-01,7\n2012-01-02,8\n";
+    }
+    ASSERT_EQ(0, std::rename(nextPath, path));
+    EXPECT_TRUE(table.refresh(path));
+    EXPECT_EQ(2u, reader.size());
+    EXPECT_FALSE(reader.getRateForDate("2011-12-31", r));
+    EXPECT_TRUE(reader.getRateForDate("2012-01-02", r));
+    EXPECT_EQ(8.0, r);
+    EXPECT_EQ(3u, table.generation());
+    std::remove(path);
+}
+
+// ---- QueryServer ----
+
+static void* serverThread(void* arg) {
+    static_cast<QueryServer*>(arg)->run();
+    return 0;
+}
+
+static std::string readAll(int fd) {
+    std::string got;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+        got.append(buf, n);
+    return got;
+}
+
+// パイプラインで送った要求への応答は、同じ入力を run に通した out/err と同じ並びになること
+TEST(QueryServerTest, PipelinedAnswersMatchRun) {
+    std::istringstream db("2012-02-29,1.0\n2011-01-03,0.3\n2011-01-09,0.32\n2012-01-11,7.1\n");
+    BitcoinExchange app(db, RateTable::FLAT);
+    std::string input = "date | value\n";
+    static const char* lines[] = {
+        "2011-01-03 | 3\n", "2011-01-03 | abc\n", "2001-42-42\n", "2010-12-31 | 1\n",
+        "2012-01-11 | -1\n", "2012-01-11 | 1001\n", "\n", "2011-01-09|1\r\n"
+    };
+    for (int i = 0; i < 20000; ++i)
+        input += lines[i % 8];
+    input += "2012-02-29 | 2"; // no trailing newline: answered at EOF
+    std::istringstream in(input);
+    std::ostringstream expected;
+    app.run(in, expected, expected);
+
+    const char* path = "ex00_query_server.sock";
+    QueryServer server(app);
+    server.listenUnix(path);
+    pthread_t tid;
+    ASSERT_EQ(0, pthread_create(&tid, 0, serverThread, &server));
+
+    for (int round = 0; round < 2; ++round) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        ASSERT_EQ(0, ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        // 送信側は別スレッドにしないと、応答が溜まった時に双方が write で詰まる
+        struct Sender {
+            static void* run(void* arg) {
+                std::pair<int, const std::string*>* a =
+                    static_cast<std::pair<int, const std::string*>*>(arg);
+                const std::string& s = *a->second;
+                for (std::size_t off = 0; off < s.size(); off += 1000) { // 行の途中で切れる
+                    const std::size_t len = std::min<std::size_t>(1000, s.size() - off);
+                    if (::write(a->first, s.data() + off, len) != static_cast<ssize_t>(len))
+                        break;
+                }
+                ::shutdown(a->first, SHUT_WR);
+                return 0;
+            }
+        };
+        std::pair<int, const std::string*> arg(fd, &input);
+        pthread_t sender;
+        ASSERT_EQ(0, pthread_create(&sender, 0, Sender::run, &arg));
+        const std::string got = readAll(fd);
+        pthread_join(sender, 0);
+        ::close(fd);
+        EXPECT_EQ(expected.str(), got) << "round " << round;
+    }
+    server.stop();
+    pthread_join(tid, 0);
+}
+
+// '\n' の来ない長い行は溜め続けず、エラーを返して閉じる
+TEST(QueryServerTest, RejectsOverlongLine) {
+    std::istringstream db("2011-01-03,0.3\n");
+    BitcoinExchange app(db, RateTable::FLAT);
+    const char* path = "ex00_query_overlong.sock";
+    QueryServer server(app);
+    server.listenUnix(path);
+    pthread_t tid;
+    ASSERT_EQ(0, pthread_create(&tid, 0, serverThread, &server));
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(0, ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+    const std::string input = "2011-01-03 | 3\n" + std::string(1u << 20, 'x');
+    struct Sender {
+        static void* run(void* arg) {
+            std::pair<int, const std::string*>* a =
+                static_cast<std::pair<int, const std::string*>*>(arg);
+            const std::string& s = *a->second;
+            std::size_t off = 0;
+            while (off < s.size()) { // サーバが先に閉じるので MSG_NOSIGNAL
+                const ssize_t n = ::send(a->first, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                off += n;
+            }
+            return 0;
+        }
+    };
+    std::pair<int, const std::string*> arg(fd, &input);
+    pthread_t sender;
+    ASSERT_EQ(0, pthread_create(&sender, 0, Sender::run, &arg));
+    const std::string got = readAll(fd); // EOF when the server closes
+    pthread_join(sender, 0);
+    ::close(fd);
+    EXPECT_EQ("2011-01-03 => 3 = 0.9\nError: bad input => line too long.\n", got);
+    server.stop();
+    pthread_join(tid, 0);
+}
+
+static int connectUnix(const char* path) {
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// fd が尽きて accept が EMFILE になっても、その接続は閉じて次の接続には答えること
+// (待ち行列に残すと epoll が空回りし、クライアントは待たされ続ける)
+TEST(QueryServerTest, DropsConnectionsWhenOutOfFds) {
+    std::istringstream db("2011-01-03,0.3\n");
+    BitcoinExchange app(db, RateTable::FLAT);
+    const char* path = "ex00_query_emfile.sock";
+    QueryServer server(app);
+    server.listenUnix(path);
+    pthread_t tid;
+    ASSERT_EQ(0, pthread_create(&tid, 0, serverThread, &server));
+
+    // run() が動き出したのを 1 往復で確かめる (EOF が返れば、サーバ側の fd も閉じている)
+    int fd = connectUnix(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(2, ::write(fd, "x\n", 2));
+    ::shutdown(fd, SHUT_WR);
+    EXPECT_FALSE(readAll(fd).empty());
+    ::close(fd);
+
+    int dropped = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(dropped, 0);
+    timeval tv = {2, 0};
+    ::setsockopt(dropped, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buf[256];
+    // 上限を下げ、残りの fd を全部埋めてサーバの accept を EMFILE にする
+    rlimit saved;
+    ASSERT_EQ(0, ::getrlimit(RLIMIT_NOFILE, &saved));
+    rlimit low = saved;
+    low.rlim_cur = dropped + 16;
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &low));
+    std::vector<int> fillers;
+    for (int f; (f = ::open("/dev/null", O_RDONLY)) >= 0; )
+        fillers.push_back(f);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    const int connected = ::connect(dropped, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    const ssize_t got = connected == 0 ? ::read(dropped, buf, sizeof(buf)) : -1;
+    for (std::size_t i = 0; i < fillers.size(); ++i)
+        ::close(fillers[i]);
+    ASSERT_EQ(0, ::setrlimit(RLIMIT_NOFILE, &saved));
+    ::close(dropped);
+    EXPECT_EQ(0, connected);
+    EXPECT_EQ(0, got); // EOF: 閉じられた (タイムアウトなら -1)
+
+    fd = connectUnix(path);
+    ASSERT_GE(fd, 0);
+    const std::string req = "2011-01-03 | 3\n";
+    ASSERT_EQ(static_cast<ssize_t>(req.size()), ::write(fd, req.data(), req.size()));
+    ::shutdown(fd, SHUT_WR);
+    EXPECT_EQ("2011-01-03 => 3 = 0.9\n", readAll(fd));
+    ::close(fd);
+    server.stop();
+    pthread_join(tid, 0);
+}
+
+TEST(QueryServerTest, StreamModeMatchesRun) {
+    std::istringstream db("2011-01-03,0.3\n2012-01-11,7.1\n");
+    BitcoinExchange app(db, RateTable::FLAT);
+    const std::string input = "date | value\n2011-01-03 | 3\n2001-42-42\n2012-01-11 | 2";
+    std::istringstream in(input);
+    std::ostringstream expected;
+    app.run(in, expected, expected);
+
+    int req[2], resp[2];
+    ASSERT_EQ(0, ::pipe(req));
+    ASSERT_EQ(0, ::pipe(resp));
+    ASSERT_EQ(static_cast<ssize_t>(input.size()), ::write(req[1], input.data(), input.size()));
+    ::close(req[1]);
+    QueryServer server(app);
+    server.serveStream(req[0], resp[1]);
+    ::close(resp[1]);
+    EXPECT_EQ(expected.str(), readAll(resp[0]));
+    ::close(req[0]);
+    ::close(resp[0]);
+}
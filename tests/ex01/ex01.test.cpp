@@ -1,7 +1,17 @@
 #include "../ex01/RPN.hpp"
+#include "../ex01/RPNProgram.hpp"
+#include "../ex01/RPNDag.hpp"
+#include "../ex01/BigInt.hpp"
+#include "../ex01/RPNStack.hpp"
+#include "../ex01/RPNStream.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>  // remove
+#include <fstream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <vector>
 
 TEST(RPNTest, SimpleAddition) {
     std::string expression = "3 4 +";
@@ -56,3 +66,508 @@ TEST(RPNTest, DivisionOverflow) {
         FAIL() << "Expected std::overflow_error";
     }
 }
+
+TEST(RPNTest, AdditionAndSubtractionOverflow) {
+    // 4 * 8^20 = 2^62。2^62 + 2^62 と -2^62 - 2^62 - 1 はあふれる
+    const std::string p62 = "4 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * * * * * * * * * * *";
+    try {
+        RPN::parseAndPushToken(p62 + " " + p62 + " +");
+        FAIL() << "Expected std::overflow_error";
+    } catch (const std::overflow_error& e) {
+        EXPECT_STREQ("addition overflow", e.what());
+    }
+    try {
+        RPN::parseAndPushToken("0 " + p62 + " - " + p62 + " - 1 -");
+        FAIL() << "Expected std::overflow_error";
+    } catch (const std::overflow_error& e) {
+        EXPECT_STREQ("subtraction overflow", e.what());
+    }
+}
+
+// ---- RPNStack ----
+
+TEST(RPNStackTest, PushPopAcrossSpill) {
+    RPNStack st;
+    EXPECT_TRUE(st.empty());
+    const long long n = 1000;
+    for (long long i = 0; i < n; ++i) {
+        st.push(i);
+        EXPECT_EQ(i, st.top());
+    }
+    EXPECT_TRUE(st.spilled());
+    EXPECT_EQ(static_cast<std::size_t>(n), st.size());
+    RPNStack copy(st);
+    for (long long i = n - 1; i >= 0; --i) {
+        EXPECT_EQ(i, copy.top());
+        copy.pop();
+    }
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(static_cast<std::size_t>(n), st.size()); // コピー元はそのまま
+    RPNStack small;
+    small.push(7);
+    EXPECT_FALSE(small.spilled());
+    small = st;
+    EXPECT_EQ(n - 1, small.top());
+}
+
+TEST(RPNStackTest, ErrorMessages) {
+    RPNStack st;
+    long long a, b;
+    st.push(1);
+    try {
+        st.pop2(a, b);
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("insufficient values in expression.", e.what());
+    }
+    EXPECT_EQ(1, st.result());
+    st.push(2);
+    try {
+        st.result();
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("the input has too many values.", e.what());
+    }
+    st.pop2(a, b);
+    EXPECT_EQ(2, a);
+    EXPECT_EQ(1, b);
+    EXPECT_THROW(st.pop(), std::runtime_error);
+    EXPECT_THROW(st.top(), std::runtime_error);
+}
+
+// ---- RPNStream ----
+
+TEST(RPNStreamTest, OneExpressionPerLine) {
+    std::istringstream in("3 4 +\n\n  8 9 * 9 - 9 - 9 - 4 - 1 +\n1 0 /\n(1 1 +)\n5 +\n1 2\n7 7 * 7 -");
+    std::ostringstream out, err;
+    RPNStream stream(out, err);
+    stream.run(in);
+    EXPECT_EQ("7\n42\n42\n", out.str());
+    EXPECT_EQ("Error: line 4: division by zero.\n"
+              "Error: line 5: invalid token: (1\n"
+              "Error: line 6: insufficient values in expression.\n"
+              "Error: line 7: the input has too many values.\n", err.str());
+    EXPECT_EQ(7ul, stream.stats().lines);
+    EXPECT_EQ(4ul, stream.stats().errors);
+}
+
+// どこでブロックが切れても結果は同じ
+TEST(RPNStreamTest, TokensSpanningFeeds) {
+    const std::string input = "1 2 + 3 *\r\n9 12 +\n4 2 /\n";
+    for (std::size_t step = 1; step <= input.size(); ++step) {
+        std::ostringstream out, err;
+        RPNStream stream(out, err);
+        for (std::size_t i = 0; i < input.size(); i += step)
+            stream.feed(input.data() + i, std::min(step, input.size() - i));
+        stream.finish();
+        EXPECT_EQ("9\n2\n", out.str()) << step;
+        EXPECT_EQ("Error: line 2: invalid token: 12\n", err.str()) << step;
+    }
+}
+
+TEST(RPNStreamTest, HugeSingleExpression) {
+    // 1 + 1 + ... を 1 トークンずつ流す (深さは 2 のまま)
+    std::ostringstream out, err;
+    RPNStream stream(out, err);
+    stream.feed("1", 1);
+    for (int i = 0; i < 100000; ++i)
+        stream.feed(" 1 +", 4);
+    stream.finish();
+    EXPECT_EQ("100001\n", out.str());
+    EXPECT_EQ(200001ull, stream.stats().tokens);
+    EXPECT_FALSE(err.str().size());
+}
+
+// runParallel はチャンクの切れ目やスレッド数に関係なく run と同じ出力・同じ行番号になること
+TEST(RPNStreamTest, ParallelMatchesRun) {
+    static const char* lines[] = {
+        "3 4 +\n", "1 0 /\n", "\n", "8 9 * 9 - 9 - 9 - 4 - 1 +\r\n", "(1 1 +)\n",
+        "1 2\n", "  \n", "9 9 * 9 *\n", "5 +\n", "7 7 * 7 -\n"
+    };
+    std::string input;
+    for (int i = 0; i < 500; ++i)
+        input += lines[(i * 7) % 10];
+    input += "1 1 +"; // no trailing newline
+
+    const char* path = "ex01_parallel_input.txt";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << input;
+    }
+    std::istringstream in(input);
+    std::ostringstream expectedOut, expectedErr;
+    RPNStream stream(expectedOut, expectedErr);
+    stream.run(in);
+
+    const unsigned threads[] = {1, 2, 3, 8};
+    const std::size_t chunks[] = {1, 7, 64, 1u << 20};
+    for (std::size_t t = 0; t < 4; ++t) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            std::ostringstream out, err;
+            RPNStream::Stats stats = RPNStream::runParallel(path, out, err, threads[t], chunks[c]);
+            EXPECT_EQ(expectedOut.str(), out.str()) << threads[t] << " threads, chunk " << chunks[c];
+            EXPECT_EQ(expectedErr.str(), err.str()) << threads[t] << " threads, chunk " << chunks[c];
+            EXPECT_EQ(stream.stats().lines, stats.lines);
+            EXPECT_EQ(stream.stats().errors, stats.errors);
+            EXPECT_EQ(stream.stats().tokens, stats.tokens);
+        }
+    }
+    std::remove(path);
+    std::ostringstream out, err;
+    EXPECT_THROW(RPNStream::runParallel("no_such_input.txt", out, err, 4), std::runtime_error);
+}
+
+// 1 行だけ巨大な式があっても runParallel は run と同じ出力・同じ行番号になること
+TEST(RPNStreamTest, ParallelHugeSingleExpression) {
+    std::string input = "3 4 +\n1 0 /\n1";
+    for (int i = 0; i < 100000; ++i)
+        input += " 1 +";
+    input += "\n5 +\n9 9 *\n";
+    const char* path = "ex01_parallel_huge.txt";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f << input;
+    }
+    std::istringstream in(input);
+    std::ostringstream expectedOut, expectedErr;
+    RPNStream stream(expectedOut, expectedErr);
+    stream.run(in);
+    ASSERT_EQ("7\n100001\n81\n", expectedOut.str());
+
+    const unsigned threads[] = {1, 4};
+    const std::size_t chunks[] = {1, 4096, 1u << 20};
+    for (std::size_t t = 0; t < 2; ++t) {
+        for (std::size_t c = 0; c < 3; ++c) {
+            std::ostringstream out, err;
+            RPNStream::Stats stats = RPNStream::runParallel(path, out, err, threads[t], chunks[c]);
+            EXPECT_EQ(expectedOut.str(), out.str()) << threads[t] << " threads, chunk " << chunks[c];
+            EXPECT_EQ(expectedErr.str(), err.str()) << threads[t] << " threads, chunk " << chunks[c];
+            EXPECT_EQ(stream.stats().lines, stats.lines);
+            EXPECT_EQ(stream.stats().tokens, stats.tokens);
+            EXPECT_EQ(stream.stats().bytes, stats.bytes);
+        }
+    }
+    std::remove(path);
+}
+
+// ---- RPNProgram ----
+
+// 解釈器の出力 (cout) を取り出す
+static std::string interpret(const std::string& expression) {
+    std::ostringstream out;
+    std::streambuf* saved = std::cout.rdbuf(out.rdbuf());
+    try {
+        RPN::parseAndPushToken(expression);
+    } catch (...) {
+        std::cout.rdbuf(saved);
+        throw;
+    }
+    std::cout.rdbuf(saved);
+    return out.str();
+}
+
+TEST(RPNProgramTest, MatchesInterpreter) {
+    static const char* exprs[] = {
+        "3 4 +", "8 9 * 9 - 9 - 9 - 4 - 1 +", "7 7 * 7 -", "1 2 * 2 / 2 * 2 4 - +",
+        "9 0 -", "1 2 -", "9 2 /", "0 9 - 2 /", "5", "  1   2\t+  "
+    };
+    for (std::size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); ++i) {
+        RPNProgram prog = RPNProgram::compile(exprs[i]);
+        std::ostringstream got;
+        got << prog.evaluate() << std::endl;
+        EXPECT_EQ(interpret(exprs[i]), got.str()) << exprs[i];
+        EXPECT_EQ(prog.evaluate(), prog.evaluate()); // 何度でも評価できる
+    }
+}
+
+TEST(RPNProgramTest, CompileTimeErrors) {
+    static const char* exprs[] = {"5 +", "(1 1 +)", "1 2", "", "12 3 +", "1 2 + -"};
+    static const char* msgs[] = {
+        "insufficient values in expression.", "invalid token: (1",
+        "the input has too many values.", "the input has too many values.",
+        "invalid token: 12", "insufficient values in expression."
+    };
+    for (std::size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); ++i) {
+        try {
+            RPNProgram::compile(exprs[i]);
+            ADD_FAILURE() << "Expected std::runtime_error: " << exprs[i];
+        } catch (const std::runtime_error& e) {
+            EXPECT_STREQ(msgs[i], e.what()) << exprs[i];
+        }
+    }
+}
+
+TEST(RPNProgramTest, RuntimeErrorsMatchProcessOperator) {
+    RPNProgram mul = RPNProgram::compile(
+        "8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * * * * * * * * * * *");
+    EXPECT_THROW(mul.evaluate(), std::overflow_error);
+    RPNProgram div = RPNProgram::compile(
+        "0 2 - 4 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * * * * * * * * * * * * 0 1 - /");
+    try {
+        div.evaluate();
+        FAIL() << "Expected std::overflow_error";
+    } catch (const std::overflow_error& e) {
+        EXPECT_STREQ("division overflow: LLONG_MIN / -1", e.what());
+    }
+    RPNProgram zero = RPNProgram::compile("1 0 /");
+    try {
+        zero.evaluate();
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("division by zero.", e.what());
+    }
+}
+
+TEST(RPNProgramTest, DepthIsPrecomputed) {
+    RPNProgram flat = RPNProgram::compile("1 2 + 3 + 4 +");
+    EXPECT_EQ(7u, flat.size());
+    EXPECT_EQ(2u, flat.maxDepth());
+    // 300 段積んでから畳む (インライン領域を超える)
+    std::string deep;
+    for (int i = 0; i < 300; ++i) deep += "1 ";
+    for (int i = 0; i < 299; ++i) deep += "+ ";
+    RPNProgram prog = RPNProgram::compile(deep);
+    EXPECT_EQ(300u, prog.maxDepth());
+    EXPECT_EQ(300, prog.evaluate());
+    EXPECT_EQ("300\n", interpret(deep)); // 解釈器の RPNStack も spill する
+    std::vector<long long> stack(prog.maxDepth());
+    EXPECT_EQ(300, prog.evaluate(&stack[0]));
+}
+
+TEST(RPNProgramTest, Variables) {
+    EXPECT_EQ(0, RPNProgram::variableIndex("x"));
+    EXPECT_EQ(1, RPNProgram::variableIndex("y"));
+    EXPECT_EQ(2, RPNProgram::variableIndex("a0"));
+    EXPECT_EQ(11, RPNProgram::variableIndex("a9"));
+    EXPECT_EQ(-1, RPNProgram::variableIndex("z"));
+    EXPECT_EQ(-1, RPNProgram::variableIndex("a10"));
+
+    RPNProgram prog = RPNProgram::compile("x y * a9 - 2 /");
+    EXPECT_TRUE(prog.usesVariable(0));
+    EXPECT_TRUE(prog.usesVariable(11));
+    EXPECT_FALSE(prog.usesVariable(2));
+    long long vars[RPNProgram::kNumVariables] = {0};
+    vars[0] = 1000000;
+    vars[1] = -3;
+    vars[11] = 4;
+    EXPECT_EQ((1000000LL * -3 - 4) / 2, prog.evaluateWith(vars));
+    try {
+        prog.evaluate();
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("unbound variable.", e.what());
+    }
+    EXPECT_THROW(RPNProgram::compile("x b +"), std::runtime_error);
+}
+
+// 行ごとの evaluateWith と同じ結果・同じエラーになること
+static unsigned char laneErrorOf(const RPNProgram& prog, const long long* vars, long long& out) {
+    try {
+        out = prog.evaluateWith(vars);
+        return RPNProgram::LANE_OK;
+    } catch (const std::exception& e) {
+        out = 0;
+        const std::string msg = e.what();
+        if (msg == "division by zero.") return RPNProgram::LANE_DIV_BY_ZERO;
+        if (msg == "multiplication overflow") return RPNProgram::LANE_MUL_OVERFLOW;
+        if (msg == "addition overflow") return RPNProgram::LANE_ADD_OVERFLOW;
+        if (msg == "subtraction overflow") return RPNProgram::LANE_SUB_OVERFLOW;
+        return RPNProgram::LANE_DIV_OVERFLOW;
+    }
+}
+
+TEST(RPNProgramTest, BatchMatchesScalar) {
+    static const char* exprs[] = {
+        "x y -", "x y - a0 *", "x y /", "x x * x * y /", "x y 1 + /", "a0 a1 a2 + + 3 *",
+        "x y +", "y x -", "9 x -"
+    };
+    const long long kMin = std::numeric_limits<long long>::min();
+    const long long kMax = std::numeric_limits<long long>::max();
+    const std::size_t n = 203; // kLanes の倍数ではない
+    std::vector<std::vector<long long> > cols(RPNProgram::kNumVariables,
+                                              std::vector<long long>(n));
+    unsigned long long seed = 88172645463325252ULL;
+    for (std::size_t v = 0; v < cols.size(); ++v) {
+        for (std::size_t i = 0; i < n; ++i) {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            cols[v][i] = static_cast<long long>(seed % 21) - 10;
+        }
+    }
+    cols[0][5] = kMin; cols[1][5] = -1;      // LLONG_MIN / -1
+    cols[0][6] = kMax; cols[1][6] = 0;       // 0 で割る
+    cols[0][8] = kMax; cols[1][8] = 5;       // x + y があふれる
+    cols[0][7] = 3037000500LL;               // x*x*x があふれる
+    const long long* columns[RPNProgram::kNumVariables];
+    for (std::size_t v = 0; v < cols.size(); ++v) columns[v] = &cols[v][0];
+
+    for (std::size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        RPNProgram prog = RPNProgram::compile(exprs[e]);
+        std::vector<long long> out(n);
+        std::vector<unsigned char> errors(n);
+        prog.evaluateBatch(columns, n, &out[0], &errors[0]);
+        for (std::size_t i = 0; i < n; ++i) {
+            long long vars[RPNProgram::kNumVariables];
+            for (std::size_t v = 0; v < cols.size(); ++v) vars[v] = cols[v][i];
+            long long want;
+            const unsigned char err = laneErrorOf(prog, vars, want);
+            EXPECT_EQ(err, errors[i]) << exprs[e] << " row " << i;
+            EXPECT_EQ(want, out[i]) << exprs[e] << " row " << i;
+        }
+    }
+}
+
+// ---- RPNDag ----
+
+TEST(RPNDagTest, FoldsConstantsAndSharesSubexpressions) {
+    RPNDag folded = RPNDag::optimize("2 3 * 4 + x *");
+    EXPECT_EQ(7u, folded.nodesBefore());
+    EXPECT_EQ(3u, folded.nodesAfter()); // 10, x, *
+    EXPECT_EQ(1u, folded.operations());
+    long long vars[RPNProgram::kNumVariables] = {0};
+    vars[0] = 5;
+    vars[1] = 7;
+    EXPECT_EQ(50, folded.evaluateWith(vars));
+
+    RPNDag shared = RPNDag::optimize("x y + y x + * x y + -");
+    EXPECT_EQ(11u, shared.nodesBefore());
+    EXPECT_EQ(5u, shared.nodesAfter()); // x, y, +, *, -
+    EXPECT_EQ(12 * 12 - 12, shared.evaluateWith(vars));
+
+    RPNDag constant = RPNDag::optimize("9 9 * 9 * 9 - 2 /");
+    EXPECT_EQ(1u, constant.nodesAfter());
+    EXPECT_EQ(0u, constant.operations());
+    EXPECT_EQ((9 * 9 * 9 - 9) / 2, constant.evaluate());
+    EXPECT_THROW(shared.evaluate(), std::runtime_error); // unbound variable
+}
+
+TEST(RPNDagTest, ConstantErrorsAreCompileTime) {
+    try {
+        RPNDag::optimize("x 1 0 / +");
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("division by zero.", e.what());
+    }
+    std::string big = "9";
+    for (int i = 0; i < 25; ++i) big += " 9 *";
+    EXPECT_THROW(RPNDag::optimize(big + " x +"), std::overflow_error);
+    EXPECT_THROW(RPNDag::optimize("x +"), std::runtime_error);
+    EXPECT_THROW(RPNDag::optimize("x y"), std::runtime_error);
+}
+
+// 値か例外メッセージ
+template <typename Evaluator>
+static std::string outcome(const Evaluator& ev, const long long* vars) {
+    try {
+        std::ostringstream out;
+        out << ev.evaluateWith(vars);
+        return out.str();
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
+// 最適化しても RPNProgram と同じ値・同じ例外になること
+TEST(RPNDagTest, MatchesProgram) {
+    static const char* exprs[] = {
+        "x y + x y + *", "x y - y x - /", "x x * x x * * a0 +", "3 4 + x * 3 4 + y * +",
+        "x y / x y / x y / + +", "a0 a1 * a1 a0 * - 2 /", "x 0 1 - /", "1 x /"
+    };
+    const long long kMin = std::numeric_limits<long long>::min();
+    const long long values[] = {0, 1, -1, 2, 7, -9, 3037000500LL, kMin};
+    const std::size_t nv = sizeof(values) / sizeof(values[0]);
+    for (std::size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        RPNProgram prog = RPNProgram::compile(exprs[e]);
+        RPNDag dag = RPNDag::optimize(exprs[e]);
+        EXPECT_LE(dag.nodesAfter(), dag.nodesBefore());
+        for (std::size_t i = 0; i < nv * nv; ++i) {
+            long long vars[RPNProgram::kNumVariables] = {0};
+            vars[0] = values[i % nv];
+            vars[1] = values[i / nv];
+            vars[2] = values[(i + 3) % nv];
+            vars[3] = values[(i / nv + 5) % nv];
+            EXPECT_EQ(outcome(prog, vars), outcome(dag, vars))
+                << exprs[e] << " x=" << vars[0] << " y=" << vars[1];
+        }
+    }
+}
+
+// ---- bigint mode ----
+
+static std::string int128ToString(__int128 v) {
+    if (v == 0) return "0";
+    const bool neg = v < 0;
+    unsigned __int128 m = neg ? -static_cast<unsigned __int128>(v) : v;
+    std::string s;
+    for (; m != 0; m /= 10) s.insert(s.begin(), static_cast<char>('0' + m % 10));
+    return neg ? "-" + s : s;
+}
+
+TEST(BigIntTest, MatchesInt128) {
+    const long long kMin = std::numeric_limits<long long>::min();
+    const long long kMax = std::numeric_limits<long long>::max();
+    std::vector<long long> values;
+    values.push_back(0); values.push_back(1); values.push_back(-1);
+    values.push_back(999999999); values.push_back(1000000000); values.push_back(-1000000001);
+    values.push_back(kMin); values.push_back(kMax); values.push_back(kMin + 1);
+    unsigned long long seed = 88172645463325252ULL;
+    for (int i = 0; i < 40; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        values.push_back(static_cast<long long>(seed) >> (i % 60));
+    }
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        for (std::size_t j = 0; j < values.size(); ++j) {
+            const __int128 a = values[i], b = values[j];
+            const BigInt x(values[i]), y(values[j]);
+            EXPECT_EQ(int128ToString(a + b), (x + y).toString());
+            EXPECT_EQ(int128ToString(a - b), (x - y).toString());
+            EXPECT_EQ(int128ToString(a * b), (x * y).toString());
+            if (b != 0) {
+                EXPECT_EQ(int128ToString(a / b), (x / y).toString());
+                // 多 limb 同士の割り算: (a * b + r) / b == a  (|r| < |b|, r は a * b と同符号)
+                __int128 r = (b > 0 ? b : -b) - 1;
+                if (a != 0 && (a < 0) != (b < 0)) r = -r;
+                const BigInt prod = x * y + BigInt(static_cast<long long>(r));
+                EXPECT_EQ(int128ToString(a), (prod / y).toString()) << values[i] << " " << values[j];
+            }
+            long long back;
+            EXPECT_TRUE(x.toLongLong(back));
+            EXPECT_EQ(values[i], back);
+        }
+    }
+    long long out;
+    EXPECT_FALSE((BigInt(kMax) + BigInt(1)).toLongLong(out));
+    EXPECT_TRUE((BigInt(kMin) - BigInt(0)).toLongLong(out));
+    EXPECT_FALSE((BigInt(kMin) - BigInt(1)).toLongLong(out));
+    EXPECT_THROW(BigInt(1) / BigInt(0), std::runtime_error);
+}
+
+TEST(RPNTest, BigIntMode) {
+    const std::string fact = "1 2 * 3 * 4 * 5 * 6 * 7 * 8 * 9 *"; // 9!
+    const std::string p62 = "4 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 8 * * * * * * * * * * * * * * * * * * * *";
+    std::string pow4 = fact, pow10 = fact;
+    for (int i = 1; i < 4; ++i) pow4 += " " + fact + " *";
+    for (int i = 1; i < 10; ++i) pow10 += " " + fact + " *";
+
+    EXPECT_EQ("42", RPN::evaluateBigInt("8 9 * 9 - 9 - 9 - 4 - 1 +"));
+    EXPECT_EQ("17340121312772751360000", RPN::evaluateBigInt(pow4));
+    EXPECT_EQ("39594086612242519324387557078266845776303882240000000000",
+              RPN::evaluateBigInt(pow10));
+    EXPECT_EQ("18446744073709551616", RPN::evaluateBigInt(p62 + " 4 *"));
+    EXPECT_EQ("-18446744073709551616", RPN::evaluateBigInt("0 " + p62 + " 4 * -"));
+    EXPECT_EQ("4", RPN::evaluateBigInt(p62 + " 4 * " + p62 + " /")); // 戻ってくる
+    EXPECT_EQ("9223372036854775808", RPN::evaluateBigInt("0 2 - 4 8 8 8 8 8 8 8 8 8 8 8 8 8 8"
+              " 8 8 8 8 8 8 * * * * * * * * * * * * * * * * * * * * * 0 1 - /"));
+    EXPECT_EQ("-118370420422995325490293175746560000000",
+              RPN::evaluateBigInt(pow10 + " 0 7 - " + fact + " * " + fact + " * " + fact + " * /"));
+    EXPECT_EQ("0", RPN::evaluateBigInt(pow4 + " " + pow4 + " -"));
+
+    try {
+        RPN::evaluateBigInt(pow4 + " 0 /");
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ("division by zero.", e.what());
+    }
+    EXPECT_THROW(RPN::evaluateBigInt("1 +"), std::runtime_error);
+    EXPECT_THROW(RPN::evaluateBigInt("1 2"), std::runtime_error);
+    EXPECT_THROW(RPN::evaluateBigInt("12 3 +"), std::runtime_error);
+}
@@ -0,0 +1,423 @@
+#include "../ex02/PmergeMe.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+// 再現性のある入力 (rangeMax が小さいと重複が多い)
+std::vector<int> randomInput(int n, unsigned seed, int rangeMax) {
+    std::vector<int> v(n);
+    unsigned long long s = 88172645463325252ULL ^ seed;
+    for (int i = 0; i < n; ++i) {
+        s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+        v[i] = static_cast<int>(s % rangeMax) + 1;
+    }
+    return v;
+}
+
+template <typename Container, typename Indices>
+Container gather(const Container& input, const Indices& indices) {
+    Container out;
+    for (std::size_t i = 0; i < indices.size(); ++i) out.push_back(input[indices[i]]);
+    return out;
+}
+
+// Ford-Johnson の最悪比較回数 F(n) = sum ceil(log2(3k/4))
+int fordJohnsonBound(int n) {
+    int f = 0;
+    for (int k = 1; k <= n; ++k) f += static_cast<int>(std::ceil(std::log2(3.0 * k / 4) - 1e-12));
+    return f;
+}
+}
+
+template <typename Container>
+class PmergeMeTest : public ::testing::Test {};
+typedef ::testing::Types<std::vector<int>, std::deque<int> > ContainerTypes;
+TYPED_TEST_SUITE(PmergeMeTest, ContainerTypes);
+
+TYPED_TEST(PmergeMeTest, SortsAndReturnsPermutation) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    for (int n = 0; n < 130; ++n) {
+        for (unsigned seed = 0; seed < 3; ++seed) {
+            std::vector<int> v = randomInput(n, seed, seed == 0 ? 3 : 100000);
+            TypeParam input(v.begin(), v.end());
+            Indices idx = sorter.mergeInsertionSort(input.begin(), input.end());
+            TypeParam sorted = gather(input, idx);
+            std::vector<int> want = v;
+            std::sort(want.begin(), want.end());
+            EXPECT_TRUE(std::equal(want.begin(), want.end(), sorted.begin())) << n;
+            std::sort(idx.begin(), idx.end());
+            for (int i = 0; i < n; ++i) EXPECT_EQ(i, static_cast<int>(idx[i]));
+        }
+    }
+}
+
+TEST(PmergeMeTest, ComparisonsWithinFordJohnsonBound) {
+    PmergeMe<std::vector<int> > sorter;
+    for (int n = 1; n <= 64; ++n) {
+        for (unsigned seed = 0; seed < 20; ++seed) {
+            std::vector<int> v = randomInput(n, seed, 1000000);
+            sorter.resetCounters();
+            sorter.mergeInsertionSort(v.begin(), v.end());
+            EXPECT_LE(sorter.comparisons(), fordJohnsonBound(n)) << n;
+        }
+    }
+}
+
+// arena 版は結果も比較回数も同じ
+TYPED_TEST(PmergeMeTest, ArenaMatchesPlain) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    const int sizes[] = {0, 1, 2, 3, 4, 5, 21, 100, 1000, 3000};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (unsigned seed = 0; seed < 3; ++seed) {
+            std::vector<int> v = randomInput(sizes[s], seed, seed == 0 ? 5 : 100000);
+            TypeParam input(v.begin(), v.end());
+            sorter.resetCounters();
+            Indices plain = sorter.mergeInsertionSort(input.begin(), input.end());
+            const long plainComparisons = sorter.comparisons();
+            sorter.resetCounters();
+            Indices arena = sorter.mergeInsertionSortArena(input.begin(), input.end());
+            EXPECT_TRUE(plain == arena) << sizes[s];
+            EXPECT_EQ(plainComparisons, sorter.comparisons()) << sizes[s];
+        }
+    }
+}
+
+// BlockedChain に順位で挿入した結果は std::vector::insert と同じ
+TEST(BlockedChainTest, InsertMatchesVector) {
+    std::vector<int> init = randomInput(300, 7, 1000);
+    BlockedChain<int> chain(5000);
+    chain.assign(&init[0], &init[0] + init.size());
+    std::vector<int> want = init;
+    std::vector<int> ranks = randomInput(4700, 8, 1 << 30);
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+        const std::size_t rank = ranks[i] % (want.size() + 1);
+        chain.insert(rank, static_cast<int>(i));
+        want.insert(want.begin() + rank, static_cast<int>(i));
+        if (i % 97 == 0) {
+            for (std::size_t k = 0; k < want.size(); k += 13) ASSERT_EQ(want[k], chain.at(k)) << i;
+        }
+    }
+    std::vector<int> got(chain.size());
+    chain.copyTo(&got[0]);
+    EXPECT_TRUE(want == got);
+}
+
+// blocked 版も結果と比較回数は同じ (kBlockedMinSize 以上の段を含む大きさで)
+TYPED_TEST(PmergeMeTest, BlockedMatchesArena) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    const int sizes[] = {0, 1, 2, 3, 100, PmergeMe<TypeParam>::kBlockedMinSize,
+                         5000, 20001};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (unsigned seed = 0; seed < 2; ++seed) {
+            std::vector<int> v = randomInput(sizes[s], seed, seed == 0 ? 5 : 100000);
+            TypeParam input(v.begin(), v.end());
+            sorter.resetCounters();
+            Indices arena = sorter.mergeInsertionSortArena(input.begin(), input.end());
+            const long arenaComparisons = sorter.comparisons();
+            sorter.resetCounters();
+            Indices blocked = sorter.mergeInsertionSortBlocked(input.begin(), input.end());
+            EXPECT_TRUE(arena == blocked) << sizes[s];
+            EXPECT_EQ(arenaComparisons, sorter.comparisons()) << sizes[s];
+        }
+    }
+}
+
+// 値を直接並べた結果は「インデックス列を返して集める」と同じで、比較回数も同じ
+TYPED_TEST(PmergeMeTest, SortValuesMatchesGather) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    const int sizes[] = {0, 1, 2, 3, 4, 5, 21, 100, 1000, 5000};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (unsigned seed = 0; seed < 2; ++seed) {
+            std::vector<int> v = randomInput(sizes[s], seed, seed == 0 ? 5 : 100000);
+            TypeParam input(v.begin(), v.end());
+            sorter.resetCounters();
+            Indices idx = sorter.mergeInsertionSortArena(input.begin(), input.end());
+            const long indexComparisons = sorter.comparisons();
+            sorter.resetCounters();
+            TypeParam values = input;
+            sorter.sortValues(values.begin(), values.end());
+            EXPECT_TRUE(gather(input, idx) == values) << sizes[s];
+            EXPECT_EQ(indexComparisons, sorter.comparisons()) << sizes[s];
+        }
+    }
+}
+
+// ID は元の位置と同じ順に並ぶ (重複キーでもインデックス版と同じ順番)
+TYPED_TEST(PmergeMeTest, SortWithPayloadCarriesIds) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    const int sizes[] = {0, 1, 2, 7, 100, 5000};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<int> v = randomInput(sizes[s], 3, 50);
+        TypeParam input(v.begin(), v.end());
+        Indices idx = sorter.mergeInsertionSortArena(input.begin(), input.end());
+        std::vector<uint64_t> ids(v.size());
+        for (std::size_t i = 0; i < ids.size(); ++i) ids[i] = (1ULL << 40) + i;
+        TypeParam keys = input;
+        sorter.sortWithPayload(keys.begin(), keys.end(), ids.empty() ? 0 : &ids[0]);
+        EXPECT_TRUE(gather(input, idx) == keys) << sizes[s];
+        for (std::size_t i = 0; i < ids.size(); ++i)
+            ASSERT_EQ((1ULL << 40) + idx[i], ids[i]) << sizes[s];
+    }
+}
+
+// 並列版は正しく並べ、スレッド数によらず同じ結果・同じ比較回数になる
+TYPED_TEST(PmergeMeTest, ParallelSortsDeterministically) {
+    typedef typename PmergeMe<TypeParam>::index_container Indices;
+    PmergeMe<TypeParam> sorter;
+    const int sizes[] = {0, 1, 5, 1000, PmergeMe<TypeParam>::kParallelMinSize, 70001};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (unsigned seed = 0; seed < 2; ++seed) {
+            std::vector<int> v = randomInput(sizes[s], seed, seed == 0 ? 5 : 100000);
+            TypeParam input(v.begin(), v.end());
+            std::vector<int> want = v;
+            std::sort(want.begin(), want.end());
+            Indices first;
+            long firstComparisons = 0;
+            const unsigned threads[] = {1, 3, 8};
+            for (std::size_t t = 0; t < 3; ++t) {
+                sorter.resetCounters();
+                Indices idx = sorter.mergeInsertionSortParallel(input.begin(), input.end(),
+                                                                  threads[t]);
+                TypeParam sorted = gather(input, idx);
+                EXPECT_TRUE(std::equal(want.begin(), want.end(), sorted.begin())) << sizes[s];
+                if (t == 0) {
+                    first = idx;
+                    firstComparisons = sorter.comparisons();
+                    std::sort(idx.begin(), idx.end());
+                    for (int i = 0; i < sizes[s]; ++i) ASSERT_EQ(i, static_cast<int>(idx[i]));
+                } else {
+                    EXPECT_TRUE(first == idx) << sizes[s] << " threads=" << threads[t];
+                    EXPECT_EQ(firstComparisons, sorter.comparisons()) << sizes[s];
+                }
+            }
+        }
+    }
+}
+
+// lowerBoundInt は std::lower_bound と同じ位置を返す (SIMD で数える窓の端も含めて)
+TEST(BranchlessSearchTest, MatchesLowerBound) {
+    for (int m = 0; m < 100; ++m) {
+        std::vector<int> a = randomInput(m, m, 40);
+        std::sort(a.begin(), a.end());
+        for (int val = -1; val <= 42; ++val) {
+            long machine = 0;
+            const int* p = a.empty() ? 0 : &a[0];
+            EXPECT_EQ(std::lower_bound(a.begin(), a.end(), val) - a.begin(),
+                      lowerBoundInt(p, m, val, machine)) << m << " " << val;
+        }
+    }
+}
+
+// 分岐なし探索でも並べ替えは正しく、数える比較回数は Ford-Johnson の上限以内
+TYPED_TEST(PmergeMeTest, BranchlessSortsValues) {
+    PmergeMe<TypeParam> sorter;
+    for (int n = 0; n <= 64; ++n) {
+        for (unsigned seed = 0; seed < 10; ++seed) {
+            std::vector<int> v = randomInput(n, seed, seed % 2 ? 4 : 1000000);
+            TypeParam values(v.begin(), v.end());
+            sorter.resetCounters();
+            sorter.sortValues(values.begin(), values.end(), PmergeMe<TypeParam>::SEARCH_BRANCHLESS);
+            std::sort(v.begin(), v.end());
+            EXPECT_TRUE(std::equal(v.begin(), v.end(), values.begin())) << n;
+            EXPECT_LE(sorter.comparisons(), fordJohnsonBound(n)) << n;
+        }
+    }
+    const int sizes[] = {1000, 5000, 20001};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<int> v = randomInput(sizes[s], 5, s == 0 ? 7 : 1000000);
+        TypeParam values(v.begin(), v.end());
+        sorter.resetCounters();
+        sorter.sortValues(values.begin(), values.end(), PmergeMe<TypeParam>::SEARCH_BRANCHLESS);
+        std::sort(v.begin(), v.end());
+        EXPECT_TRUE(std::equal(v.begin(), v.end(), values.begin())) << sizes[s];
+        EXPECT_GT(sorter.machineComparisons(), 0);
+    }
+}
+
+// 短い列の専用手順: 全ての並び (重複あり) を正しく並べ、比較回数は F(N) 以内
+TYPED_TEST(PmergeMeTest, SmallKernelsAreComparisonOptimal) {
+    PmergeMe<TypeParam> sorter;
+    typename PmergeMe<TypeParam>::Options options;
+    options.smallKernels = true;
+    for (int n = 1; n <= 6; ++n) {
+        std::vector<int> v(n);
+        for (int i = 0; i < n; ++i) v[i] = i / 2 + 1; // 重複を含む
+        do {
+            TypeParam values(v.begin(), v.end());
+            sorter.resetCounters();
+            sorter.sortValues(values.begin(), values.end(), options);
+            std::vector<int> want = v;
+            std::sort(want.begin(), want.end());
+            ASSERT_TRUE(std::equal(want.begin(), want.end(), values.begin())) << n;
+            EXPECT_LE(sorter.comparisons(), fordJohnsonBound(n)) << n;
+        } while (std::next_permutation(v.begin(), v.end()));
+    }
+    for (int n = 7; n <= 64; ++n) {
+        for (unsigned seed = 0; seed < 20; ++seed) {
+            std::vector<int> v = randomInput(n, seed, seed % 2 ? 5 : 1000000);
+            TypeParam values(v.begin(), v.end());
+            sorter.resetCounters();
+            sorter.sortValues(values.begin(), values.end(), options);
+            std::sort(v.begin(), v.end());
+            EXPECT_TRUE(std::equal(v.begin(), v.end(), values.begin())) << n;
+            EXPECT_LE(sorter.comparisons(), fordJohnsonBound(n)) << n;
+        }
+    }
+}
+
+// mergeAbove: 区間を Ford-Johnson で並べてからマージしても正しく並ぶ
+TYPED_TEST(PmergeMeTest, MergeAboveSorts) {
+    PmergeMe<TypeParam> sorter;
+    typename PmergeMe<TypeParam>::Options options;
+    options.smallKernels = true;
+    const int cutoffs[] = {1, 2, 16, 100};
+    const int sizes[] = {0, 1, 17, 1000, 5001};
+    for (std::size_t c = 0; c < 4; ++c) {
+        options.mergeAbove = cutoffs[c];
+        for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            std::vector<int> v = randomInput(sizes[s], static_cast<unsigned>(c), 1000);
+            TypeParam values(v.begin(), v.end());
+            sorter.sortValues(values.begin(), values.end(), options);
+            std::sort(v.begin(), v.end());
+            EXPECT_TRUE(std::equal(v.begin(), v.end(), values.begin()))
+                << sizes[s] << " cutoff " << cutoffs[c];
+        }
+    }
+}
+
+namespace {
+// 呼ばれた回数を自分でも数える比較 (PmergeMe の数え方と突き合わせる)
+struct CallCountingLess {
+    CallCountingLess() : calls(0) {}
+    explicit CallCountingLess(long* c) : calls(c) {}
+    bool operator()(int x, int y) const {
+        ++*calls;
+        return x < y;
+    }
+    long* calls;
+};
+}
+
+// Compare を替えれば逆順にも並ぶ (int でも SIMD の探索は std::less のときだけ)
+TEST(PmergeMeCompareTest, GreaterSortsDescending) {
+    typedef PmergeMe<std::vector<int>, std::greater<int> > Sorter;
+    Sorter sorter;
+    const int sizes[] = {0, 1, 2, 5, 17, 100, 5000, Sorter::kParallelMinSize + 1};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<int> v = randomInput(sizes[s], 11, s % 2 ? 9 : 1000000);
+        std::vector<int> want = v;
+        std::sort(want.begin(), want.end(), std::greater<int>());
+        EXPECT_TRUE(gather(v, sorter.mergeInsertionSortBlocked(v.begin(), v.end())) == want);
+        EXPECT_TRUE(gather(v, sorter.mergeInsertionSortParallel(v.begin(), v.end(), 3)) == want);
+        std::vector<int> values = v;
+        sorter.sortValues(values.begin(), values.end(), Sorter::SEARCH_BRANCHLESS);
+        EXPECT_TRUE(values == want) << sizes[s];
+        Sorter::Options options;
+        options.smallKernels = true;
+        options.mergeAbove = 64;
+        values = v;
+        sorter.sortValues(values.begin(), values.end(), options);
+        EXPECT_TRUE(values == want) << sizes[s];
+    }
+}
+
+// comparisons() は Compare を呼んだ回数そのもの (分岐なし探索を使わない経路)
+TEST(PmergeMeCompareTest, CountsEveryCompareCall) {
+    long calls = 0;
+    typedef PmergeMe<std::vector<int>, CallCountingLess> Sorter;
+    Sorter sorter((CallCountingLess(&calls)));
+    Sorter::Options options;
+    options.smallKernels = true;
+    options.mergeAbove = 100;
+    const int sizes[] = {1, 2, 3, 16, 21, 1000, 5000};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<int> v = randomInput(sizes[s], 2, 50);
+        std::vector<uint64_t> ids(v.size());
+        for (int k = 0; k < 7; ++k) {
+            calls = 0;
+            sorter.resetCounters();
+            std::vector<int> work = v;
+            switch (k) {
+            case 0: sorter.mergeInsertionSort(work.begin(), work.end()); break;
+            case 1: sorter.mergeInsertionSortArena(work.begin(), work.end()); break;
+            case 2: sorter.mergeInsertionSortBlocked(work.begin(), work.end()); break;
+            case 3: sorter.mergeInsertionSortIndirect(work.begin(), work.end()); break;
+            case 4: sorter.sortValues(work.begin(), work.end()); break;
+            case 5: sorter.sortValues(work.begin(), work.end(), options); break;
+            default: sorter.sortWithPayload(work.begin(), work.end(), &ids[0]); break;
+            }
+            EXPECT_EQ(calls, sorter.comparisons()) << sizes[s] << " path " << k;
+        }
+    }
+}
+
+// 数はインスタンスごと。コピーは数も引き継ぎ、resetCounters で 0 に戻る
+TEST(PmergeMeCompareTest, CountersArePerInstance) {
+    PmergeMe<std::vector<int> > a;
+    PmergeMe<std::vector<int> > b;
+    std::vector<int> v = randomInput(1000, 4, 100000);
+    a.sortValues(v.begin(), v.end());
+    EXPECT_GT(a.comparisons(), 0);
+    EXPECT_EQ(0, b.comparisons());
+    PmergeMe<std::vector<int> > c(a);
+    EXPECT_EQ(a.comparisons(), c.comparisons());
+    a.resetCounters();
+    EXPECT_EQ(0, a.comparisons());
+    EXPECT_EQ(0, a.machineComparisons());
+    EXPECT_GT(c.comparisons(), 0);
+}
+
+// 文字列をコピーせずに並べる: blocked 版と同じ結果・同じ比較回数
+TEST(PmergeMeCompareTest, IndirectSortsStrings) {
+    typedef PmergeMe<std::vector<std::string> > Sorter;
+    Sorter sorter;
+    const int sizes[] = {0, 1, 2, 3, 33, 1000, Sorter::kBlockedMinSize + 7};
+    for (std::size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        std::vector<int> keys = randomInput(sizes[s], 6, s % 2 ? 20 : 1000000);
+        std::vector<std::string> v;
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            std::ostringstream os;
+            os << "common/prefix/" << keys[i];
+            v.push_back(os.str());
+        }
+        sorter.resetCounters();
+        Sorter::index_container blocked = sorter.mergeInsertionSortBlocked(v.begin(), v.end());
+        const long blockedComparisons = sorter.comparisons();
+        sorter.resetCounters();
+        Sorter::index_container indirect = sorter.mergeInsertionSortIndirect(v.begin(), v.end());
+        EXPECT_TRUE(blocked == indirect) << sizes[s];
+        EXPECT_EQ(blockedComparisons, sorter.comparisons()) << sizes[s];
+        std::vector<std::string> want = v;
+        std::sort(want.begin(), want.end());
+        EXPECT_TRUE(gather(v, indirect) == want) << sizes[s];
+        std::vector<std::string> values = v;
+        sorter.sortValues(values.begin(), values.end());
+        EXPECT_TRUE(values == want) << sizes[s];
+    }
+}
+
+// インデックスの型は Index で選べる (Container と同じ種類のコンテナで返る)
+TEST(PmergeMeCompareTest, SizeTIndices) {
+    typedef PmergeMe<std::deque<int>, std::less<int>, std::size_t> Wide;
+    std::deque<std::size_t> wide;
+    std::vector<int> v = randomInput(3000, 9, 100);
+    std::deque<int> input(v.begin(), v.end());
+    Wide wideSorter;
+    wide = wideSorter.mergeInsertionSortBlocked(input.begin(), input.end());
+    PmergeMe<std::deque<int> > narrowSorter;
+    std::deque<uint32_t> narrow = narrowSorter.mergeInsertionSortBlocked(input.begin(), input.end());
+    ASSERT_EQ(narrow.size(), wide.size());
+    EXPECT_TRUE(std::equal(narrow.begin(), narrow.end(), wide.begin()));
+    EXPECT_EQ(narrowSorter.comparisons(), wideSorter.comparisons());
+}